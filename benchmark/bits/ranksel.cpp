@@ -6,6 +6,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <sux/bits/EliasFano.hpp>
+#include <sux/bits/Poppy.hpp>
 #include <sux/bits/Rank9Sel.hpp>
 #include <sux/bits/SimpleSelect.hpp>
 #include <sux/bits/SimpleSelectHalf.hpp>
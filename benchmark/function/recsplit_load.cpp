@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <random>
@@ -40,7 +41,7 @@ template <typename T> void benchmark(RecSplit<LEAF, ALLOC_TYPE> &rs, const vecto
 
 int main(int argc, char **argv) {
 	if (argc < 3) {
-		fprintf(stderr, "Usage: %s <keys> <mphf>\n", argv[0]);
+		fprintf(stderr, "Usage: %s <keys> <mphf> [--map]\n", argv[0]);
 		return 1;
 	}
 
@@ -50,13 +51,17 @@ int main(int argc, char **argv) {
 	while (getline(fin, str)) keys.push_back(str);
 	fin.close();
 
-	fstream fs;
 	RecSplit<LEAF, ALLOC_TYPE> rs;
 
-	fs.exceptions(fstream::failbit | fstream::badbit);
-	fs.open(argv[2], std::fstream::in | std::fstream::binary);
-	fs >> rs;
-	fs.close();
+	if (argc >= 4 && strcmp(argv[3], "--map") == 0) {
+		rs.map(argv[2]);
+	} else {
+		fstream fs;
+		fs.exceptions(fstream::failbit | fstream::badbit);
+		fs.open(argv[2], std::fstream::in | std::fstream::binary);
+		fs >> rs;
+		fs.close();
+	}
 
 	benchmark(rs, keys);
 
@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <random>
@@ -36,19 +37,23 @@ void benchmark(RecSplit<LEAF, ALLOC_TYPE> &rs, const uint64_t n) {
 
 int main(int argc, char **argv) {
 	if (argc < 3) {
-		fprintf(stderr, "Usage: %s <n> <mphf>\n", argv[0]);
+		fprintf(stderr, "Usage: %s <n> <mphf> [--map]\n", argv[0]);
 		return 1;
 	}
 
 	const uint64_t n = strtoll(argv[1], NULL, 0);
 
-	fstream fs;
 	RecSplit<LEAF, ALLOC_TYPE> rs;
 
-	fs.exceptions(fstream::failbit | fstream::badbit);
-	fs.open(argv[2], fstream::in | fstream::binary);
-	fs >> rs;
-	fs.close();
+	if (argc >= 4 && strcmp(argv[3], "--map") == 0) {
+		rs.map(argv[2]);
+	} else {
+		fstream fs;
+		fs.exceptions(fstream::failbit | fstream::badbit);
+		fs.open(argv[2], fstream::in | fstream::binary);
+		fs >> rs;
+		fs.close();
+	}
 
 	benchmark(rs, n);
 
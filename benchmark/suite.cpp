@@ -0,0 +1,516 @@
+/*
+ * A unified benchmark suite: one binary, one registered case per
+ * structure/operation pair, warmup and statistical repetition, hardware
+ * performance counters per case and machine-readable output.
+ *
+ * Usage: suite [--filter=SUBSTRING] [--format=table|csv|json]
+ *              [--repeats=N] [--threads=N] [--bits=N] [--values=N] [--keys=N]
+ *
+ * Every case reports the median over the repetitions of nanoseconds,
+ * cycles, instructions, LLC misses and dTLB misses per operation; the
+ * counters are read with perf_event_open(2) and report zero when the
+ * kernel denies access (e.g., under perf_event_paranoid > 2 with no
+ * CAP_PERFMON). Output goes to standard output; `table` is for humans,
+ * `csv` and `json` are for regression gating.
+ *
+ * With --threads=N the read-only cases partition their query stream
+ * across N threads pinned to distinct cores and additionally report
+ * aggregate and per-thread throughput plus the scaling efficiency
+ * against a single-thread baseline; hardware counters are process-wide
+ * and thus only collected when N is 1. Mutating cases always run
+ * single-threaded.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <sux/bits/EliasFano.hpp>
+#include <sux/bits/Poppy.hpp>
+#include <sux/bits/Rank9Sel.hpp>
+#include <sux/bits/Rrr.hpp>
+#include <sux/bits/SimpleSelect.hpp>
+#include <sux/bits/SimpleSelectHalf.hpp>
+#include <sux/bits/StrideDynRankSel.hpp>
+#include <sux/bits/WordDynRankSel.hpp>
+#include <sux/function/RecSplit.hpp>
+#include <sux/util/BufferedPrefixSums.hpp>
+#include <sux/util/FenwickBitF.hpp>
+#include <sux/util/FenwickBitL.hpp>
+#include <sux/util/FenwickByteF.hpp>
+#include <sux/util/FenwickByteL.hpp>
+#include <sux/util/FenwickFixedB.hpp>
+#include <sux/util/FenwickFixedF.hpp>
+#include <sux/util/FenwickFixedL.hpp>
+
+#include "../test/xoroshiro128pp.hpp"
+
+using namespace std;
+using namespace sux;
+
+static volatile uint64_t sink;
+
+/** A group of perf_event_open(2) counters: cycles, instructions, LLC
+ * misses and dTLB misses, read in one go. Counters that the kernel
+ * refuses to open simply report zero. */
+class PerfCounters {
+  public:
+	static constexpr int COUNTERS = 4;
+
+  private:
+	int fd[COUNTERS];
+	uint64_t id[COUNTERS];
+
+	static int openCounter(uint32_t type, uint64_t config, int group) {
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = group == -1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+		return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+	}
+
+  public:
+	PerfCounters() {
+		static const pair<uint32_t, uint64_t> events[COUNTERS] = {
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+			{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+			{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+		};
+		for (int i = 0; i < COUNTERS; i++) {
+			fd[i] = openCounter(events[i].first, events[i].second, i == 0 ? -1 : fd[0]);
+			id[i] = 0;
+			if (fd[i] != -1) ioctl(fd[i], PERF_EVENT_IOC_ID, &id[i]);
+		}
+	}
+
+	~PerfCounters() {
+		for (int i = 0; i < COUNTERS; i++)
+			if (fd[i] != -1) close(fd[i]);
+	}
+
+	void start() {
+		if (fd[0] == -1) return;
+		ioctl(fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+
+	/** Stops the counters and stores their values (zero for counters that could not be opened). */
+	void stop(uint64_t values[COUNTERS]) {
+		for (int i = 0; i < COUNTERS; i++) values[i] = 0;
+		if (fd[0] == -1) return;
+		ioctl(fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+		struct {
+			uint64_t nr;
+			struct {
+				uint64_t value, id;
+			} value[COUNTERS];
+		} data;
+		if (read(fd[0], &data, sizeof(data)) == -1) return;
+		for (uint64_t j = 0; j < data.nr; j++)
+			for (int i = 0; i < COUNTERS; i++)
+				if (fd[i] != -1 && data.value[j].id == id[i]) values[i] = data.value[j].value;
+	}
+};
+
+struct Result {
+	string name;
+	uint64_t operations;
+	double ns, counter[PerfCounters::COUNTERS]; // All per operation
+	size_t threads = 1;
+	double mops = 0, min_thread_mops = 0, max_thread_mops = 0;
+	double efficiency = 1; // Aggregate throughput over threads times the single-thread baseline
+};
+
+class Suite {
+  public:
+	const char *filter = nullptr;
+	size_t repeats = 5;
+	size_t threads = 1;
+	vector<Result> results;
+
+	bool wanted(const char *name) const { return filter == nullptr || strstr(name, filter) != nullptr; }
+
+	/** Runs a case: one unmeasured warmup, then `repeats` measured
+	 * repetitions of `operation()`, which must perform `operations`
+	 * operations; reports per-operation medians. */
+	void run(const string &name, uint64_t operations, const std::function<void()> &operation) {
+		if (!wanted(name.c_str())) return;
+		operation(); // Warmup
+
+		vector<double> ns(repeats);
+		vector<array<uint64_t, PerfCounters::COUNTERS>> counters(repeats);
+		PerfCounters perf;
+		for (size_t r = 0; r < repeats; r++) {
+			perf.start();
+			const auto begin = chrono::high_resolution_clock::now();
+			operation();
+			const auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - begin).count();
+			perf.stop(&counters[r][0]);
+			ns[r] = double(elapsed);
+		}
+
+		Result result;
+		result.name = name;
+		result.operations = operations;
+		result.ns = median(ns) / operations;
+		for (int i = 0; i < PerfCounters::COUNTERS; i++) {
+			vector<double> v(repeats);
+			for (size_t r = 0; r < repeats; r++) v[r] = double(counters[r][i]);
+			result.counter[i] = median(v) / operations;
+		}
+		result.mops = 1e3 / result.ns;
+		result.min_thread_mops = result.max_thread_mops = result.mops;
+		results.push_back(result);
+		fprintf(stderr, "%-40s %8.2f ns/op\n", name.c_str(), result.ns);
+	}
+
+	/** Runs a read-only case whose query stream can be partitioned.
+	 *
+	 * With `threads` above one, the operation range is split across that
+	 * many threads, each pinned to a core; a single-thread pass over the
+	 * whole stream provides the baseline for the scaling efficiency.
+	 * Hardware counters are reported only for single-threaded runs. */
+	void runShared(const string &name, uint64_t operations, const std::function<void(size_t, size_t)> &op) {
+		if (threads <= 1) {
+			run(name, operations, [&]() { op(0, operations); });
+			return;
+		}
+		if (!wanted(name.c_str())) return;
+		op(0, operations); // Warmup
+
+		const auto base_begin = chrono::high_resolution_clock::now();
+		op(0, operations);
+		const double baseline_ns = double(chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - base_begin).count());
+
+		vector<double> wall(repeats);
+		double min_thread_mops = 1e30, max_thread_mops = 0;
+		for (size_t r = 0; r < repeats; r++) {
+			atomic<size_t> ready(0);
+			atomic<bool> go(false);
+			vector<double> thread_ns(threads);
+			vector<thread> pool;
+			for (size_t t = 0; t < threads; t++)
+				pool.emplace_back([&, t]() {
+					pin(t);
+					const size_t begin = t * operations / threads, end = (t + 1) * operations / threads;
+					ready.fetch_add(1);
+					while (!go.load()) __builtin_ia32_pause();
+					const auto b = chrono::high_resolution_clock::now();
+					op(begin, end);
+					thread_ns[t] = double(chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - b).count());
+				});
+			while (ready.load() != threads) __builtin_ia32_pause();
+			const auto b = chrono::high_resolution_clock::now();
+			go.store(true);
+			for (auto &t : pool) t.join();
+			wall[r] = double(chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - b).count());
+			for (size_t t = 0; t < threads; t++) {
+				const double ops = double((t + 1) * operations / threads - t * operations / threads);
+				min_thread_mops = min(min_thread_mops, ops * 1e3 / thread_ns[t]);
+				max_thread_mops = max(max_thread_mops, ops * 1e3 / thread_ns[t]);
+			}
+		}
+
+		Result result;
+		result.name = name;
+		result.operations = operations;
+		result.threads = threads;
+		result.ns = median(wall) / operations;
+		for (int i = 0; i < PerfCounters::COUNTERS; i++) result.counter[i] = 0;
+		result.mops = operations * 1e3 / median(wall);
+		result.min_thread_mops = min_thread_mops;
+		result.max_thread_mops = max_thread_mops;
+		result.efficiency = result.mops / (threads * (operations * 1e3 / baseline_ns));
+		results.push_back(result);
+		fprintf(stderr, "%-40s %8.2f ns/op %8.2f Mops/s (%zu threads, efficiency %.2f)\n", name.c_str(), result.ns, result.mops, threads, result.efficiency);
+	}
+
+  private:
+	static void pin(size_t t) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(t % thread::hardware_concurrency(), &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+
+	static double median(vector<double> v) {
+		sort(v.begin(), v.end());
+		return v.size() % 2 ? v[v.size() / 2] : (v[v.size() / 2 - 1] + v[v.size() / 2]) / 2;
+	}
+};
+
+static void benchRankSel(Suite &suite, const size_t num_bits, const size_t num_queries) {
+	const size_t num_words = num_bits / 64 + 1;
+	uint64_t *const bits = (uint64_t *)calloc(num_words + 16, sizeof *bits);
+	uint64_t num_ones = 0;
+	vector<uint64_t> ones;
+	for (size_t i = 0; i < num_bits; i++)
+		if (next() % 2) {
+			bits[i / 64] |= UINT64_C(1) << i % 64;
+			num_ones++;
+			ones.push_back(i);
+		}
+
+	vector<size_t> position(num_queries);
+	vector<uint64_t> rank(num_queries);
+	for (size_t i = 0; i < num_queries; i++) {
+		position[i] = next() % num_bits;
+		// The data-dependent xor below flips the lowest bit, so stay clear of num_ones.
+		rank[i] = next() % (num_ones - 1);
+	}
+
+	bits::Rank9 rank9(bits, num_bits);
+	suite.runShared("rank9/rank", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += rank9.rank(position[i] ^ (u & 1));
+		sink = u;
+	});
+
+	vector<uint64_t> batch_out(num_queries);
+	suite.runShared("rank9/rank_batch", num_queries, [&](size_t begin, size_t end) {
+		rank9.rank(&position[begin], &batch_out[begin], end - begin);
+		sink = batch_out[end - 1];
+	});
+
+	bits::Rank9Sel rank9sel(bits, num_bits);
+	suite.runShared("rank9sel/rank", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += rank9sel.rank(position[i] ^ (u & 1));
+		sink = u;
+	});
+	suite.runShared("rank9sel/select", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += rank9sel.select(rank[i] ^ (u & 1));
+		sink = u;
+	});
+
+	bits::SimpleSelect simple(bits, num_bits, 3);
+	suite.runShared("simple_select/select", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += simple.select(rank[i] ^ (u & 1));
+		sink = u;
+	});
+
+	bits::SimpleSelectHalf half(bits, num_bits);
+	suite.runShared("simple_select_half/select", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += half.select(rank[i] ^ (u & 1));
+		sink = u;
+	});
+
+	bits::Poppy poppy(bits, num_bits);
+	suite.runShared("poppy/rank", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += poppy.rank(position[i] ^ (u & 1));
+		sink = u;
+	});
+	suite.runShared("poppy/select", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += poppy.select(rank[i] ^ (u & 1));
+		sink = u;
+	});
+
+	bits::Rrr rrr(bits, num_bits);
+	suite.runShared("rrr/rank", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += rrr.rank(position[i] ^ (u & 1));
+		sink = u;
+	});
+	suite.runShared("rrr/select", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += rrr.select(rank[i] ^ (u & 1));
+		sink = u;
+	});
+
+	bits::EliasFano ef(ones, num_bits);
+	suite.runShared("elias_fano/rank", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += ef.rank(position[i] ^ (u & 1));
+		sink = u;
+	});
+	suite.runShared("elias_fano/select", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += ef.select(rank[i] ^ (u & 1));
+		sink = u;
+	});
+
+	free(bits);
+}
+
+template <template <size_t, util::AllocType AT> class SPS, size_t WORDS> static void benchDynRankSel(Suite &suite, const char *name, const size_t num_bits, const size_t num_queries) {
+	const size_t num_words = num_bits / 64 + 1;
+	uint64_t *const bits = (uint64_t *)calloc(num_words + WORDS, sizeof *bits);
+	uint64_t num_ones = 0;
+	for (size_t i = 0; i < num_bits; i++)
+		if (next() % 2) {
+			bits[i / 64] |= UINT64_C(1) << i % 64;
+			num_ones++;
+		}
+
+	vector<size_t> position(num_queries);
+	vector<uint64_t> rank(num_queries), word(num_queries);
+	for (size_t i = 0; i < num_queries; i++) {
+		position[i] = next() % num_bits;
+		rank[i] = next() % (num_ones - 1);
+		word[i] = next();
+	}
+
+	conditional_t<WORDS == 1, bits::WordDynRankSel<SPS>, bits::StrideDynRankSel<SPS, WORDS>> bv(bits, num_bits);
+	string prefix(name);
+	suite.runShared(prefix + "/rank", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += bv.rank(position[i] ^ (u & 1));
+		sink = u;
+	});
+	suite.runShared(prefix + "/select", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += bv.select(rank[i] ^ (u & 1));
+		sink = u;
+	});
+	suite.run(prefix + "/update", num_queries, [&]() {
+		uint64_t u = 0;
+		for (size_t i = 0; i < num_queries; i++) u += bv.update(position[i] / 64, word[i]);
+		sink = u;
+	});
+
+	free(bits);
+}
+
+template <template <size_t, util::AllocType AT> class SPS> static void benchFenwick(Suite &suite, const char *name, const size_t size, const size_t num_queries) {
+	vector<uint64_t> sequence(size);
+	for (size_t i = 0; i < size; i++) sequence[i] = next() % 64;
+
+	vector<size_t> idx(num_queries);
+	vector<uint64_t> bound(num_queries);
+	for (size_t i = 0; i < num_queries; i++) {
+		idx[i] = next() % size + 1;
+		bound[i] = next() % (size * 32);
+	}
+
+	SPS<64, util::MALLOC> tree(&sequence[0], size);
+	string prefix(name);
+	suite.runShared(prefix + "/prefix", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += tree.prefix(idx[i] ^ (u & 1));
+		sink = u;
+	});
+	// Paired increment/decrement of the same element, so values never go
+	// negative and the sequence is unchanged across repetitions.
+	suite.run(prefix + "/add", num_queries, [&]() {
+		for (size_t i = 0; i < num_queries; i++) tree.add(idx[i & ~size_t(1)], i & 1 ? -1 : 1);
+	});
+	suite.runShared(prefix + "/find", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += tree.find(bound[i] ^ (u & 1));
+		sink = u;
+	});
+
+	// Clustered ingest, the workload the buffering decorator is for.
+	util::BufferedPrefixSums<SPS<64, util::MALLOC>> buffered(&sequence[0], size);
+	suite.run(prefix + "/buffered_add", num_queries, [&]() {
+		for (size_t i = 0; i < num_queries; i++) buffered.add((idx[0] + (i >> 1) % 512) % size + 1, i & 1 ? -1 : 1);
+	});
+}
+
+static void benchRecSplit(Suite &suite, const size_t num_keys, const size_t num_queries) {
+	if (!suite.wanted("recsplit8/build") && !suite.wanted("recsplit8/query")) return;
+	vector<string> keys(num_keys);
+	for (size_t i = 0; i < num_keys; i++) keys[i] = to_string(next());
+
+	suite.run("recsplit8/build", num_keys, [&]() {
+		sux::function::RecSplit<8> rs(keys, 100);
+		sink = rs.size();
+	});
+
+	sux::function::RecSplit<8> rs(keys, 100);
+	suite.runShared("recsplit8/query", num_queries, [&](size_t begin, size_t end) {
+		uint64_t u = 0;
+		for (size_t i = begin; i < end; i++) u += rs(keys[(i + u % 2) % num_keys]);
+		sink = u;
+	});
+}
+
+static void report(const vector<Result> &results, const char *format) {
+	static const char *counter_name[PerfCounters::COUNTERS] = {"cycles", "instructions", "llc_misses", "dtlb_misses"};
+	if (strcmp(format, "csv") == 0) {
+		printf("name,operations,ns");
+		for (int i = 0; i < PerfCounters::COUNTERS; i++) printf(",%s", counter_name[i]);
+		printf(",threads,mops,min_thread_mops,max_thread_mops,efficiency\n");
+		for (const Result &r : results) {
+			printf("%s,%llu,%.4f", r.name.c_str(), (unsigned long long)r.operations, r.ns);
+			for (int i = 0; i < PerfCounters::COUNTERS; i++) printf(",%.4f", r.counter[i]);
+			printf(",%zu,%.4f,%.4f,%.4f,%.4f\n", r.threads, r.mops, r.min_thread_mops, r.max_thread_mops, r.efficiency);
+		}
+	} else if (strcmp(format, "json") == 0) {
+		printf("[");
+		for (size_t j = 0; j < results.size(); j++) {
+			const Result &r = results[j];
+			printf("%s\n  {\"name\": \"%s\", \"operations\": %llu, \"ns\": %.4f", j ? "," : "", r.name.c_str(), (unsigned long long)r.operations, r.ns);
+			for (int i = 0; i < PerfCounters::COUNTERS; i++) printf(", \"%s\": %.4f", counter_name[i], r.counter[i]);
+			printf(", \"threads\": %zu, \"mops\": %.4f, \"min_thread_mops\": %.4f, \"max_thread_mops\": %.4f, \"efficiency\": %.4f}", r.threads, r.mops, r.min_thread_mops, r.max_thread_mops, r.efficiency);
+		}
+		printf("\n]\n");
+	} else {
+		printf("%-40s %12s %12s %14s %12s %12s %8s %10s %12s\n", "name", "ns/op", "cycles/op", "instr/op", "llc/op", "dtlb/op", "threads", "Mops/s", "efficiency");
+		for (const Result &r : results)
+			printf("%-40s %12.2f %12.2f %14.2f %12.4f %12.4f %8zu %10.2f %12.2f\n", r.name.c_str(), r.ns, r.counter[0], r.counter[1], r.counter[2], r.counter[3], r.threads, r.mops, r.efficiency);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	Suite suite;
+	const char *format = "table";
+	size_t num_bits = 1 << 26, num_values = 1 << 22, num_keys = 1 << 20, num_queries = 1 << 22;
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--filter=", 9) == 0) suite.filter = argv[i] + 9;
+		else if (strncmp(argv[i], "--format=", 9) == 0) format = argv[i] + 9;
+		else if (strncmp(argv[i], "--repeats=", 10) == 0) suite.repeats = strtoull(argv[i] + 10, NULL, 0);
+		else if (strncmp(argv[i], "--threads=", 10) == 0) suite.threads = max(size_t(1), (size_t)strtoull(argv[i] + 10, NULL, 0));
+		else if (strncmp(argv[i], "--bits=", 7) == 0) num_bits = strtoull(argv[i] + 7, NULL, 0);
+		else if (strncmp(argv[i], "--values=", 9) == 0) num_values = strtoull(argv[i] + 9, NULL, 0);
+		else if (strncmp(argv[i], "--keys=", 7) == 0) num_keys = strtoull(argv[i] + 7, NULL, 0);
+		else if (strncmp(argv[i], "--queries=", 10) == 0) num_queries = strtoull(argv[i] + 10, NULL, 0);
+		else {
+			fprintf(stderr, "Usage: %s [--filter=SUBSTRING] [--format=table|csv|json] [--repeats=N] [--threads=N] [--bits=N] [--values=N] [--keys=N] [--queries=N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	benchRankSel(suite, num_bits, num_queries);
+	benchDynRankSel<util::FenwickFixedF, 1>(suite, "word_dyn<fixedf>", num_bits, num_queries);
+	benchDynRankSel<util::FenwickFixedF, 16>(suite, "stride_dyn<fixedf,16>", num_bits, num_queries);
+	benchDynRankSel<util::FenwickByteL, 16>(suite, "stride_dyn<bytel,16>", num_bits, num_queries);
+	benchFenwick<util::FenwickFixedF>(suite, "fenwick_fixedf", num_values, num_queries);
+	benchFenwick<util::FenwickFixedL>(suite, "fenwick_fixedl", num_values, num_queries);
+	benchFenwick<util::FenwickByteF>(suite, "fenwick_bytef", num_values, num_queries);
+	benchFenwick<util::FenwickByteL>(suite, "fenwick_bytel", num_values, num_queries);
+	benchFenwick<util::FenwickBitF>(suite, "fenwick_bitf", num_values, num_queries);
+	benchFenwick<util::FenwickBitL>(suite, "fenwick_bitl", num_values, num_queries);
+	benchRecSplit(suite, num_keys, num_queries / 4);
+
+	report(suite.results, format);
+	return 0;
+}
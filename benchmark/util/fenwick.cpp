@@ -8,6 +8,7 @@
 #include <sux/util/FenwickBitL.hpp>
 #include <sux/util/FenwickByteF.hpp>
 #include <sux/util/FenwickByteL.hpp>
+#include <sux/util/FenwickFixedB.hpp>
 #include <sux/util/FenwickFixedF.hpp>
 #include <sux/util/FenwickFixedL.hpp>
 
@@ -87,6 +88,7 @@ int main(int argc, char **argv) {
 	runall<FenwickByteL, B, AT>("\nFenwickByteL", size, queries);
 	runall<FenwickBitF, B, AT>("\nFenwickBitF", size, queries);
 	runall<FenwickBitL, B, AT>("\nFenwickBitL", size, queries);
+	runall<FenwickFixedB, B, AT>("\nFenwickFixedB", size, queries);
 
 	return 0;
 }
@@ -0,0 +1,252 @@
+/*
+ * Sux: Succinct data structures
+ *
+ * Copyright (C) 2007-2020 Sebastiano Vigna
+ *
+ *  This library is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as published by the Free
+ *  Software Foundation; either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * Under Section 7 of GPL version 3, you are granted additional permissions
+ * described in the GCC Runtime Library Exception, version 3.1, as published by
+ * the Free Software Foundation.
+ *
+ * You should have received a copy of the GNU General Public License and a copy of
+ * the GCC Runtime Library Exception along with this program; see the files
+ * COPYING3 and COPYING.RUNTIME respectively.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../util/Vector.hpp"
+#include "DynamicBitVector.hpp"
+#include "Rank.hpp"
+#include "Select.hpp"
+#include "SelectZero.hpp"
+#include <memory>
+
+namespace sux::bits {
+
+/** Ranking and selection in a dynamic bit vector with a linear-search stride
+ * that adapts to the observed workload.
+ *
+ * This class behaves like StrideDynRankSel, but the stride is chosen at run
+ * time: cheap counters track the ratio of mutations to queries, and every
+ * 2^16 operations the stride is re-evaluated. An update-heavy workload drives
+ * the stride towards MAX_WORDS (fewer buckets, so a shallower prefix-sum
+ * tree); a query-heavy one drives it towards a single word (no linear scan,
+ * as in WordDynRankSel). When the stride changes, the prefix sums are rebuilt
+ * in one pass over the bit vector; since this happens at most once per epoch,
+ * the re-bucketing cost is amortized over the operations of the epoch. The
+ * counters are halved at each epoch, so the estimate follows workload shifts
+ * with an exponentially decaying memory.
+ *
+ * **Warning**: if you plan an calling rank(size_t) with
+ * argument size(), you must have at least one additional
+ * free bit at the end of the provided bit vector.
+ *
+ * @tparam SPS underlying sux::util::SearchablePrefixSums implementation.
+ * @tparam MAX_WORDS maximum length (in words, a power of two) of the linear search stride.
+ * @tparam AT a type of memory allocation for the underlying structure.
+ */
+template <template <size_t, util::AllocType AT> class SPS, size_t MAX_WORDS, util::AllocType AT = util::AllocType::MALLOC>
+class AdaptiveDynRankSel : public DynamicBitVector, public Rank, public Select, public SelectZero {
+  private:
+	static_assert(MAX_WORDS != 0 && (MAX_WORDS & (MAX_WORDS - 1)) == 0, "MAX_WORDS must be a power of two");
+	static constexpr size_t BOUND = 64 * MAX_WORDS;
+	static constexpr uint64_t ops_per_epoch = 1 << 16;
+
+	uint64_t *const Vector;
+	size_t Size;
+	size_t Words; // The current stride (in words)
+	SPS<BOUND, AT> SrcPrefSum;
+	uint64_t queries = 0, updates = 0, epoch_ops = 0;
+
+  public:
+	/** Creates a new instance using a given bit vector.
+	 *
+	 * Thus constructor only store a reference
+	 * to the provided bit vector. The content of the bit vector
+	 * should be changed only through the mutation methods of
+	 * this class, or the results will be unpredictable.
+	 *
+	 * **Warning**: if you plan an calling rank(size_t) with
+	 * argument size(), you must have at least one additional
+	 * free bit at the end of the provided bit vector.
+	 *
+	 * @param bitvector a bit vector of 64-bit words.
+	 * @param size the length (in bits) of the bit vector.
+	 * @param words the initial stride (in words, a power of two at most MAX_WORDS).
+	 */
+	AdaptiveDynRankSel(uint64_t bitvector[], size_t size, size_t words = 1) : Vector(bitvector), Size(size), Words(words), SrcPrefSum(buildSrcPrefSum(bitvector, divRoundup(size, 64), words)) {
+		assert(words != 0 && (words & (words - 1)) == 0 && words <= MAX_WORDS);
+	}
+
+	uint64_t *bitvector() const { return Vector; }
+
+	/** Returns the current stride (in words). */
+	size_t stride() const { return Words; }
+
+	using Rank::rank;
+	using Rank::rankZero;
+
+	virtual uint64_t rank(size_t pos) {
+		account(false);
+		size_t idx = pos / (64 * Words);
+		uint64_t value = SrcPrefSum.prefix(idx);
+
+		for (size_t i = idx * Words; i < pos / 64; i++) value += nu(Vector[i]);
+
+		return value + nu(Vector[pos / 64] & ((1ULL << (pos % 64)) - 1));
+	}
+
+	virtual uint64_t rank(size_t from, size_t to) { return rank(to) - rank(from); }
+
+	virtual size_t select(uint64_t rank) {
+		account(false);
+		size_t idx = SrcPrefSum.find(&rank);
+
+		for (size_t i = idx * Words; i < idx * Words + Words; i++) {
+			uint64_t rank_chunk = nu(Vector[i]);
+			if (rank < rank_chunk)
+				return i * 64 + select64(Vector[i], rank);
+			else
+				rank -= rank_chunk;
+		}
+
+		return SIZE_MAX;
+	}
+
+	virtual size_t selectZero(uint64_t rank) {
+		account(false);
+		// SrcPrefSum.compFind() assumes buckets of BOUND bits, so with a narrower
+		// runtime stride we binary search the complemented prefix sums instead.
+		const size_t buckets = divRoundup(divRoundup(Size, 64), Words);
+		size_t lo = 0, hi = buckets - 1;
+		while (lo < hi) {
+			const size_t mid = (lo + hi + 1) / 2;
+			if (mid * Words * 64 - SrcPrefSum.prefix(mid) <= rank) lo = mid;
+			else hi = mid - 1;
+		}
+		const size_t idx = lo;
+		rank -= idx * Words * 64 - SrcPrefSum.prefix(idx);
+
+		for (size_t i = idx * Words; i < idx * Words + Words; i++) {
+			uint64_t rank_chunk = nu(~Vector[i]);
+			if (rank < rank_chunk)
+				return i * 64 + select64(~Vector[i], rank);
+			else
+				rank -= rank_chunk;
+		}
+
+		return SIZE_MAX;
+	}
+
+	virtual uint64_t update(size_t index, uint64_t word) {
+		account(true);
+		uint64_t old = Vector[index];
+		Vector[index] = word;
+		SrcPrefSum.add(index / Words + 1, nu(word) - nu(old));
+
+		return old;
+	}
+
+	virtual bool set(size_t index) {
+		account(true);
+		uint64_t old = Vector[index / 64];
+		Vector[index / 64] |= uint64_t(1) << (index % 64);
+
+		if (Vector[index / 64] != old) {
+			SrcPrefSum.add(index / (Words * 64) + 1, 1);
+			return false;
+		}
+
+		return true;
+	}
+
+	virtual bool clear(size_t index) {
+		account(true);
+		uint64_t old = Vector[index / 64];
+		Vector[index / 64] &= ~(uint64_t(1) << (index % 64));
+
+		if (Vector[index / 64] != old) {
+			SrcPrefSum.add(index / (Words * 64) + 1, -1);
+			return true;
+		}
+
+		return false;
+	}
+
+	virtual bool toggle(size_t index) {
+		account(true);
+		uint64_t old = Vector[index / 64];
+		Vector[index / 64] ^= uint64_t(1) << (index % 64);
+		bool was_set = Vector[index / 64] < old;
+		SrcPrefSum.add(index / (Words * 64) + 1, was_set ? -1 : 1);
+
+		return was_set;
+	}
+
+	virtual size_t size() const { return Size; }
+
+	virtual size_t bitCount() const { return SrcPrefSum.bitCount() - sizeof(SrcPrefSum) * 8 + sizeof(*this) * 8 + ((Size + 63) & ~63); }
+
+  private:
+	/** Counts an operation and re-evaluates the stride at epoch boundaries. */
+	void account(const bool update) {
+		update ? updates++ : queries++;
+		if (++epoch_ops < ops_per_epoch) return;
+		epoch_ops = 0;
+
+		// The target grows from one word to MAX_WORDS with the fraction of updates.
+		const int log_max = lambda(MAX_WORDS);
+		const int target_log = (updates * log_max + (updates + queries) / 2) / (updates + queries);
+		const size_t target = size_t(1) << target_log;
+		queries /= 2, updates /= 2;
+		if (target != Words) migrate(target);
+	}
+
+	/** Rebuilds the prefix sums with a new stride, in one pass over the bit vector. */
+	void migrate(const size_t words) {
+		SrcPrefSum = buildSrcPrefSum(Vector, divRoundup(Size, 64), words);
+		Words = words;
+	}
+
+	static size_t divRoundup(size_t x, size_t y) {
+		if (y > x) return 1;
+		return (x / y) + ((x % y != 0) ? 1 : 0);
+	}
+
+	static SPS<BOUND, AT> buildSrcPrefSum(const uint64_t bitvector[], size_t size, size_t words) {
+		unique_ptr<uint64_t[]> sequence = make_unique<uint64_t[]>(divRoundup(size, words));
+		for (size_t i = 0; i < size; i++) sequence[i / words] += nu(bitvector[i]);
+		return SPS<BOUND, AT>(sequence.get(), divRoundup(size, words));
+	}
+
+	friend std::ostream &operator<<(std::ostream &os, const AdaptiveDynRankSel<SPS, MAX_WORDS, AT> &bv) {
+		os.write((char *)&bv.Size, sizeof(uint64_t));
+		const uint64_t words = bv.Words;
+		os.write((char *)&words, sizeof(uint64_t));
+		return os << bv.SrcPrefSum;
+	}
+
+	friend std::istream &operator>>(std::istream &is, AdaptiveDynRankSel<SPS, MAX_WORDS, AT> &bv) {
+		is.read((char *)&bv.Size, sizeof(uint64_t));
+		uint64_t words;
+		is.read((char *)&words, sizeof(uint64_t));
+		bv.Words = words;
+		return is >> bv.SrcPrefSum;
+	}
+};
+
+} // namespace sux::bits
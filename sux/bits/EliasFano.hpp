@@ -31,6 +31,7 @@
 #include "Rank.hpp"
 #include "SimpleSelectHalf.hpp"
 #include "SimpleSelectZeroHalf.hpp"
+#include <cassert>
 #include <cstdint>
 #include <vector>
 
@@ -44,7 +45,8 @@ using namespace sux;
  *
  * Instances of this class can be built using a bit vector or an explicit list of
  * positions for the ones in a vector. In every case, the bit vector or the list
- * are not necessary after construction.
+ * are not necessary after construction. Alternatively, a Builder can be used to
+ * push the positions of the ones one at a time, without materializing a list.
  *
  * @tparam AT a type of memory allocation out of sux::util::AllocType.
  */
@@ -91,7 +93,107 @@ template <util::AllocType AT = util::AllocType::MALLOC> class EliasFano : public
 		}
 	}
 
+	void init_block_params() {
+		block_size = 0;
+		do
+			++block_size;
+		while (block_size * l + block_size <= 64 && block_size <= l);
+		block_size--;
+
+#ifdef DEBUG
+		printf("Block size: %d\n", block_size);
+#endif
+		block_size_mask = (1ULL << block_size) - 1;
+		block_length = block_size * l;
+
+#ifdef PARSEARCH
+		ones_step_l = 0;
+		for (int i = 0; i < block_size; i++) ones_step_l |= 1ULL << i * l;
+		msbs_step_l = ones_step_l << (l - 1);
+
+		compressor = 0;
+		for (int i = 0; i < block_size; i++) compressor |= 1ULL << ((l - 1) * i + block_size);
+#endif
+
+		lower_l_bits_mask = (1ULL << l) - 1;
+	}
+
+	void init_support() {
+		select_upper = SimpleSelectHalf(&upper_bits, num_ones + (num_bits >> l));
+		selectz_upper = SimpleSelectZeroHalf(&upper_bits, num_ones + (num_bits >> l));
+		init_block_params();
+	}
+
+	EliasFano(util::Vector<uint64_t, AT> lower_bits, util::Vector<uint64_t, AT> upper_bits, const uint64_t num_bits, const uint64_t num_ones, const int l) {
+		this->lower_bits = std::move(lower_bits);
+		this->upper_bits = std::move(upper_bits);
+		this->num_bits = num_bits;
+		this->num_ones = num_ones;
+		this->l = l;
+		init_support();
+	}
+
   public:
+	EliasFano() {}
+
+	/** A builder class that constructs an EliasFano instance incrementally.
+	 *
+	 * The positions of the ones must be pushed in nondecreasing order, and
+	 * their number and the length of the bit vector must be known in advance,
+	 * but no intermediate list is materialized: each position is compressed as
+	 * it is pushed, so a sequence can be streamed (e.g., from a decompressor)
+	 * using constant additional memory.
+	 */
+	class Builder {
+		static constexpr size_t LOWER_BUF = 256;
+		util::Vector<uint64_t, AT> lower_bits, upper_bits;
+		uint64_t num_bits, num_ones;
+		uint64_t pushed = 0;
+		int l;
+		uint64_t lower_bits_mask;
+		// Lower bits are buffered and scattered in bulk (see bitwrite_bulk()),
+		// so most pushes touch the compressed array one full word at a time.
+		uint64_t lower_buf[LOWER_BUF];
+		size_t in_buf = 0;
+
+	  public:
+		/** Creates a builder for a sequence of given length and number of ones.
+		 *
+		 * @param num_ones the number of positions that will be pushed.
+		 * @param num_bits the length (in bits) of the bit vector.
+		 */
+		Builder(const uint64_t num_ones, const uint64_t num_bits) : num_bits(num_bits), num_ones(num_ones) {
+			l = num_ones == 0 ? 0 : max(0, lambda_safe(num_bits / num_ones));
+			lower_bits_mask = (1ULL << l) - 1;
+			lower_bits.size((num_ones * l + 63) / 64 + 2 * (l == 0));
+			upper_bits.size(((num_ones + (num_bits >> l) + 1) + 63) / 64);
+		}
+
+		/** Pushes the position of the next one; positions must be nondecreasing. */
+		void push(const uint64_t pos) {
+			assert(pushed < num_ones);
+			if (l != 0) {
+				lower_buf[in_buf++] = pos & lower_bits_mask;
+				if (in_buf == LOWER_BUF) {
+					bitwrite_bulk(&lower_bits, (pushed + 1 - in_buf) * l, l, lower_buf, in_buf);
+					in_buf = 0;
+				}
+			}
+			set(upper_bits, (pos >> l) + pushed);
+			pushed++;
+		}
+
+		/** Returns an EliasFano instance for the pushed sequence, invalidating this builder. */
+		EliasFano<AT> build() {
+			assert(pushed == num_ones);
+			if (in_buf != 0) {
+				bitwrite_bulk(&lower_bits, (pushed - in_buf) * l, l, lower_buf, in_buf);
+				in_buf = 0;
+			}
+			return EliasFano<AT>(std::move(lower_bits), std::move(upper_bits), num_bits, num_ones, l);
+		}
+	};
+
 	/** Creates a new instance using a given bit vector.
 	 *
 	 * Note that the bit vector is read only at construction time.
@@ -134,32 +236,7 @@ template <util::AllocType AT = util::AllocType::MALLOC> class EliasFano : public
 		//       upper_bits[2], upper_bits[3]);
 #endif
 
-		select_upper = SimpleSelectHalf(&upper_bits, num_ones + (num_bits >> l));
-		selectz_upper = SimpleSelectZeroHalf(&upper_bits, num_ones + (num_bits >> l));
-
-		block_size = 0;
-		do
-			++block_size;
-		while (block_size * l + block_size <= 64 && block_size <= l);
-		block_size--;
-
-#ifdef DEBUG
-		printf("Block size: %d\n", block_size);
-#endif
-
-		block_size_mask = (1ULL << block_size) - 1;
-		block_length = block_size * l;
-
-#ifdef PARSEARCH
-		ones_step_l = 0;
-		for (int i = 0; i < block_size; i++) ones_step_l |= 1ULL << i * l;
-		msbs_step_l = ones_step_l << (l - 1);
-
-		compressor = 0;
-		for (int i = 0; i < block_size; i++) compressor |= 1ULL << ((l - 1) * i + block_size);
-#endif
-
-		lower_l_bits_mask = (1ULL << l) - 1;
+		init_support();
 	}
 
 	/** Creates a new instance using an
@@ -175,7 +252,7 @@ template <util::AllocType AT = util::AllocType::MALLOC> class EliasFano : public
 	 * @param ones a list of positions of the ones in a bit vector.
 	 * @param num_bits the length (in bits) of the bit vector.
 	 */
-	EliasFano(const std::vector<uint64_t> ones, const uint64_t num_bits) {
+	EliasFano(const std::vector<uint64_t> &ones, const uint64_t num_bits) {
 		num_ones = ones.size();
 		this->num_bits = num_bits;
 		l = num_ones == 0 ? 0 : max(0, lambda_safe(num_bits / num_ones));
@@ -191,41 +268,25 @@ template <util::AllocType AT = util::AllocType::MALLOC> class EliasFano : public
 		lower_bits.size((num_ones * l + 63) / 64 + 2 * (l == 0));
 		upper_bits.size(((num_ones + (num_bits >> l) + 1) + 63) / 64);
 
-		for (uint64_t i = 0; i < num_ones; i++) {
-			if (l != 0) set_bits(lower_bits, i * l, l, ones[i] & lower_bits_mask);
-			set(upper_bits, (ones[i] >> l) + i);
+		if (l != 0) {
+			// Scatter the lower bits in bulk (see bitwrite_bulk()), one chunk
+			// of masked values at a time.
+			constexpr size_t CHUNK = 1024;
+			uint64_t buf[CHUNK];
+			for (uint64_t i = 0; i < num_ones; i += CHUNK) {
+				const size_t chunk = min(uint64_t(CHUNK), num_ones - i);
+				for (size_t j = 0; j < chunk; j++) buf[j] = ones[i + j] & lower_bits_mask;
+				bitwrite_bulk(&lower_bits, i * l, l, buf, chunk);
+			}
 		}
+		for (uint64_t i = 0; i < num_ones; i++) set(upper_bits, (ones[i] >> l) + i);
 
 #ifdef DEBUG
 		printf("First lower: %016llx %016llx %016llx %016llx\n", lower_bits[0], lower_bits[1], lower_bits[2], lower_bits[3]);
 		printf("First upper: %016llx %016llx %016llx %016llx\n", upper_bits[0], upper_bits[1], upper_bits[2], upper_bits[3]);
 #endif
 
-		select_upper = SimpleSelectHalf(&upper_bits, num_ones + (num_bits >> l));
-		selectz_upper = SimpleSelectZeroHalf(&upper_bits, num_ones + (num_bits >> l));
-
-		block_size = 0;
-		do
-			++block_size;
-		while (block_size * l + block_size <= 64 && block_size <= l);
-		block_size--;
-
-#ifdef DEBUG
-		printf("Block size: %d\n", block_size);
-#endif
-		block_size_mask = (1ULL << block_size) - 1;
-		block_length = block_size * l;
-
-#ifdef PARSEARCH
-		ones_step_l = 0;
-		for (int i = 0; i < block_size; i++) ones_step_l |= 1ULL << i * l;
-		msbs_step_l = ones_step_l << (l - 1);
-
-		compressor = 0;
-		for (int i = 0; i < block_size; i++) compressor |= 1ULL << ((l - 1) * i + block_size);
-#endif
-
-		lower_l_bits_mask = (1ULL << l) - 1;
+		init_support();
 	}
 
 	uint64_t rank(const size_t k) {
@@ -331,6 +392,117 @@ template <util::AllocType AT = util::AllocType::MALLOC> class EliasFano : public
 		return (select_upper.select(rank) - rank) << l | get_bits(lower_bits, rank * l, l);
 	}
 
+#if defined(__cpp_impl_coroutine)
+	/** Returns select() as a suspendable Lookup (see sux::Lookup).
+	 *
+	 * The lookup prefetches the upper-bits inventory entry and the
+	 * lower-bits word before its single suspension; the upper-bits word
+	 * reached through the inventory may still miss.
+	 */
+	Lookup<size_t> selectLookup(const uint64_t rank) {
+		__builtin_prefetch(&lower_bits + rank * l / 64);
+		select_upper.prefetch(rank);
+		co_await std::suspend_always{};
+		co_return (select_upper.select(rank) - rank) << l | get_bits(lower_bits, rank * l, l);
+	}
+#endif
+
+	/** Returns the position of the first one at or after a given position ("successor").
+	 *
+	 * The upper-bits bucket of the bound is located with a single selectZero()
+	 * and the answer is resolved with one forward scan, so the query costs
+	 * about half as much as the equivalent select(rank(pos)).
+	 *
+	 * @param pos a position in the bit vector.
+	 * @param rank if not `nullptr`, the rank of the returned position is stored here
+	 * (the number of ones, if there is no successor).
+	 * @return the position of the first one at or after `pos`, or size() if there is none.
+	 */
+	uint64_t successor(const uint64_t pos, uint64_t *const rank = nullptr) {
+		if (num_ones == 0 || pos >= num_bits) {
+			if (rank) *rank = num_ones;
+			return num_bits;
+		}
+		const uint64_t hi = pos >> l;
+		const uint64_t pos_lower = pos & lower_l_bits_mask;
+
+		uint64_t p = 0, index = 0;
+		if (hi != 0) {
+			p = selectz_upper.selectZero(hi - 1) + 1;
+			index = p - hi;
+		}
+
+		uint64_t word_index = p / 64;
+		uint64_t window = upper_bits[word_index] & -1ULL << p % 64;
+		while (index < num_ones) {
+			while (window == 0) window = upper_bits[++word_index];
+			const uint64_t upper = word_index * 64 + rho(window) - index;
+			const uint64_t lower = get_bits(lower_bits, index * l, l);
+			if (upper > hi || lower >= pos_lower) {
+				if (rank) *rank = index;
+				return upper << l | lower;
+			}
+			window &= window - 1;
+			index++;
+		}
+
+		if (rank) *rank = num_ones;
+		return num_bits;
+	}
+
+	/** Returns the position of the last one at or before a given position ("predecessor").
+	 *
+	 * The upper-bits bucket of the bound is located with a single selectZero()
+	 * and the answer is resolved with one scan; within a bucket the lower bits
+	 * are nondecreasing, so the scan stops at the first element beyond the bound.
+	 *
+	 * @param pos a position in the bit vector.
+	 * @param rank if not `nullptr` and a predecessor exists, its rank is stored here.
+	 * @return the position of the last one at or before `pos`, or `UINT64_MAX` if there is none.
+	 */
+	uint64_t predecessor(uint64_t pos, uint64_t *const rank = nullptr) {
+		if (num_ones == 0) return UINT64_MAX;
+		if (pos >= num_bits) pos = num_bits - 1;
+		const uint64_t hi = pos >> l;
+		const uint64_t pos_lower = pos & lower_l_bits_mask;
+
+		uint64_t p = 0, start_index = 0;
+		if (hi != 0) {
+			p = selectz_upper.selectZero(hi - 1) + 1;
+			start_index = p - hi;
+		}
+
+		// Forward over the bucket of pos, remembering the last element within the bound.
+		uint64_t best = UINT64_MAX, best_index = 0, index = start_index;
+		uint64_t word_index = p / 64;
+		uint64_t window = upper_bits[word_index] & -1ULL << p % 64;
+		while (index < num_ones) {
+			while (window == 0) window = upper_bits[++word_index];
+			if (word_index * 64 + rho(window) - index != hi) break;
+			const uint64_t lower = get_bits(lower_bits, index * l, l);
+			if (lower > pos_lower) break;
+			best = hi << l | lower;
+			best_index = index;
+			window &= window - 1;
+			index++;
+		}
+		if (best != UINT64_MAX) {
+			if (rank) *rank = best_index;
+			return best;
+		}
+
+		// The bucket holds nothing within the bound: the predecessor is the
+		// one preceding the zero that terminates the previous bucket.
+		if (start_index == 0) return UINT64_MAX;
+		const uint64_t prev_index = start_index - 1;
+		uint64_t wi = (p - 1) / 64;
+		uint64_t w = upper_bits[wi] & ((1ULL << (p - 1) % 64) - 1);
+		while (w == 0) w = upper_bits[--wi];
+		const uint64_t upper = wi * 64 + lambda(w) - prev_index;
+		if (rank) *rank = prev_index;
+		return upper << l | get_bits(lower_bits, prev_index * l, l);
+	}
+
 	uint64_t select(const uint64_t rank, uint64_t *const next) {
 		uint64_t s, t;
 		s = select_upper.select(rank, &t) - rank;
@@ -341,6 +513,137 @@ template <util::AllocType AT = util::AllocType::MALLOC> class EliasFano : public
 		return s << l | get_bits(lower_bits, position, l);
 	}
 
+	/** A stateful cursor over the sequence of the positions of the ones.
+	 *
+	 * The cursor keeps its position in the upper and lower bits, so a full
+	 * scan costs a handful of operations per element instead of one inventory
+	 * walk per select() call, and skipTo() can jump ahead using the zero
+	 * inventory of the upper bits, which makes list intersection fast.
+	 */
+	class Iterator {
+		static constexpr uint64_t LOWER_BUF = 64;
+		EliasFano<AT> *ef;
+		uint64_t index = 0;	   // The rank of the next element.
+		uint64_t word_index = 0; // The current word in the upper bits.
+		uint64_t window;	   // The unread part of the current word.
+		uint64_t curr = 0;	   // The last element returned.
+		// Lower bits are decoded ahead in bulk (see bitread_bulk()); the
+		// buffer holds the lower bits of the elements of rank [buf_start, buf_end).
+		uint64_t lower_buf[LOWER_BUF];
+		uint64_t buf_start = 0, buf_end = 0;
+
+		friend class EliasFano<AT>;
+		Iterator(EliasFano<AT> *ef) : ef(ef) { window = ef->upper_bits[0]; }
+
+	  public:
+		/** Returns the rank of the element that next() would return. */
+		uint64_t rank() const { return index; }
+
+		/** Returns true if there are more elements to scan. */
+		bool hasNext() const { return index < ef->num_ones; }
+
+		/** Returns the next element of the sequence; hasNext() must be true. */
+		uint64_t next() {
+			assert(index < ef->num_ones);
+			while (window == 0) window = ef->upper_bits[++word_index];
+			const uint64_t upper = word_index * 64 + rho(window) - index;
+			window &= window - 1;
+			uint64_t lower = 0;
+			if (ef->l != 0) {
+				if (index >= buf_end) {
+					buf_start = index;
+					buf_end = index + min(LOWER_BUF, ef->num_ones - index);
+					bitread_bulk(&ef->lower_bits, index * ef->l, ef->l, lower_buf, buf_end - buf_start);
+				}
+				lower = lower_buf[index - buf_start];
+			}
+			index++;
+			return curr = upper << ef->l | lower;
+		}
+
+		/** Advances to the first element greater than or equal to a given bound.
+		 *
+		 * The cursor never moves backwards: if the last returned element
+		 * already satisfies the bound, it is returned again.
+		 *
+		 * @param bound a lower bound on the returned element.
+		 * @return the first element greater than or equal to `bound` at or
+		 * after the current position, or `size()` if no such element exists.
+		 */
+		uint64_t skipTo(const uint64_t bound) {
+			if (index != 0 && curr >= bound) return curr;
+			if (bound >= ef->num_bits) {
+				index = ef->num_ones;
+				return ef->num_bits;
+			}
+			const uint64_t hi = bound >> ef->l;
+			if (hi != 0) {
+				// The first element whose upper bits are at least hi follows
+				// the zero of index hi - 1 in the upper-bits array.
+				const uint64_t zero_pos = ef->selectz_upper.selectZero(hi - 1);
+				const uint64_t skip_index = zero_pos - (hi - 1);
+				if (skip_index > index) {
+					index = skip_index;
+					word_index = (zero_pos + 1) / 64;
+					window = ef->upper_bits[word_index] & -1ULL << (zero_pos + 1) % 64;
+				}
+			}
+			uint64_t v;
+			do {
+				if (index >= ef->num_ones) return ef->num_bits;
+				v = next();
+			} while (v < bound);
+			return v;
+		}
+	};
+
+	/** Returns a new Iterator positioned at the first element. */
+	Iterator iterator() { return Iterator(this); }
+
+	/** Maps this structure over a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator, must be 64-bit
+	 * aligned, and must stay alive as long as this instance is in use.
+	 *
+	 * @param p a pointer inside a memory-mapped serialized image.
+	 * @return the pointer advanced past the data of this structure.
+	 */
+	void *map(void *p) {
+		uint64_t *q = static_cast<uint64_t *>(p);
+		num_bits = *q++;
+		num_ones = *q++;
+		l = *q++;
+		p = lower_bits.map(q);
+		p = upper_bits.map(p);
+		p = select_upper.map(p, &upper_bits);
+		p = selectz_upper.map(p, &upper_bits);
+		init_block_params();
+		return p;
+	}
+
+	friend std::ostream &operator<<(std::ostream &os, const EliasFano<AT> &ef) {
+		const uint64_t nbits = ef.num_bits, nones = ef.num_ones, l = ef.l;
+		os.write((char *)&nbits, sizeof(uint64_t));
+		os.write((char *)&nones, sizeof(uint64_t));
+		os.write((char *)&l, sizeof(uint64_t));
+		return os << ef.lower_bits << ef.upper_bits << ef.select_upper << ef.selectz_upper;
+	}
+
+	friend std::istream &operator>>(std::istream &is, EliasFano<AT> &ef) {
+		uint64_t nbits, nones, l;
+		is.read((char *)&nbits, sizeof(uint64_t));
+		is.read((char *)&nones, sizeof(uint64_t));
+		is.read((char *)&l, sizeof(uint64_t));
+		ef.num_bits = nbits;
+		ef.num_ones = nones;
+		ef.l = l;
+		is >> ef.lower_bits >> ef.upper_bits >> ef.select_upper >> ef.selectz_upper;
+		ef.select_upper.setBits(&ef.upper_bits);
+		ef.selectz_upper.setBits(&ef.upper_bits);
+		ef.init_block_params();
+		return is;
+	}
+
 	/** Returns the size in bits of the underlying bit vector. */
 	size_t size() const { return num_bits; }
 
@@ -349,6 +652,25 @@ template <util::AllocType AT = util::AllocType::MALLOC> class EliasFano : public
 		return upper_bits.bitCount() - sizeof(upper_bits) * 8 + lower_bits.bitCount() - sizeof(lower_bits) * 8 + select_upper.bitCount() - sizeof(select_upper) * 8 + selectz_upper.bitCount() -
 			   sizeof(selectz_upper) * 8 + sizeof(*this) * 8;
 	}
+
+	/** Returns a structured report of the space used by this structure. */
+	util::SpaceReport spaceReport() const {
+		util::SpaceReport select = select_upper.spaceReport(), selectz = selectz_upper.spaceReport();
+		select.name = "select_upper";
+		selectz.name = "selectz_upper";
+		return {"elias_fano", sizeof(*this) * 8 - sizeof(select_upper) * 8 - sizeof(selectz_upper) * 8, AT,
+				{util::spaceReport("lower_bits", lower_bits), util::spaceReport("upper_bits", upper_bits), std::move(select), std::move(selectz)}};
+	}
+
+	/** Prefaults the bit arrays and the select inventories in layout order,
+	 * so that the first queries after loading or mapping do not pay soft
+	 * page faults. */
+	void warmup() const {
+		lower_bits.prefault();
+		upper_bits.prefault();
+		select_upper.warmup();
+		selectz_upper.warmup();
+	}
 };
 
 } // namespace sux::bits
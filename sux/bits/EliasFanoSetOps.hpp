@@ -0,0 +1,202 @@
+/*
+ * Sux: Succinct data structures
+ *
+ * Copyright (C) 2007-2020 Sebastiano Vigna
+ *
+ *  This library is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as published by the Free
+ *  Software Foundation; either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * Under Section 7 of GPL version 3, you are granted additional permissions
+ * described in the GCC Runtime Library Exception, version 3.1, as published by
+ * the Free Software Foundation.
+ *
+ * You should have received a copy of the GNU General Public License and a copy of
+ * the GCC Runtime Library Exception along with this program; see the files
+ * COPYING3 and COPYING.RUNTIME respectively.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "EliasFano.hpp"
+#include <vector>
+
+namespace sux::bits {
+
+/** Set operations on the sorted sequences represented by EliasFano instances.
+ *
+ * The algorithms below walk the upper-bits arrays of the operands directly
+ * through EliasFano::Iterator: sequential advancement decodes one element per
+ * loop iteration, whereas skips locate the target upper-bits bucket with a
+ * single selectZero() and read lower bits only for candidate matches. As a
+ * consequence, intersection and difference skip over runs of nonmatching
+ * elements at the cost of a constant number of memory accesses per candidate,
+ * instead of one rank()/select() pair per probe.
+ *
+ * Each algorithm invokes a visitor with each element of the result, in
+ * increasing order, and returns the size of the result; the overloads without
+ * a visitor just count. Since `union` is a keyword, the union is called
+ * setUnion().
+ */
+
+/** Visits the intersection of two EliasFano lists.
+ *
+ * The two lists leapfrog each other: each candidate element of one list is
+ * located in the other with a skip, so runs of nonmatching elements in
+ * either list are stepped over without decoding them.
+ *
+ * @param a, b the operands.
+ * @param visitor a function accepting a `uint64_t`, invoked with each common element.
+ * @return the number of common elements.
+ */
+template <util::AllocType AT1, util::AllocType AT2, class Visitor> uint64_t intersect(EliasFano<AT1> &a, EliasFano<AT2> &b, Visitor visitor) {
+	auto ita = a.iterator(), itb = b.iterator();
+	if (!ita.hasNext() || !itb.hasNext()) return 0;
+	uint64_t count = 0;
+	uint64_t x = ita.next();
+	for (;;) {
+		const uint64_t y = itb.skipTo(x);
+		if (y >= b.size()) break;
+		if (y == x) {
+			visitor(x);
+			count++;
+			if (!ita.hasNext()) break;
+			x = ita.next();
+		} else {
+			x = ita.skipTo(y);
+			if (x >= a.size()) break;
+		}
+	}
+	return count;
+}
+
+/** Returns the number of common elements of two EliasFano lists. */
+template <util::AllocType AT1, util::AllocType AT2> uint64_t intersect(EliasFano<AT1> &a, EliasFano<AT2> &b) {
+	return intersect(a, b, [](uint64_t) {});
+}
+
+/** Visits the intersection of k EliasFano lists.
+ *
+ * The lists leapfrog one another in round-robin order: each candidate is the
+ * largest element seen so far, and every list skips to it in turn; a
+ * candidate confirmed by all lists is part of the intersection.
+ *
+ * @param lists the operands.
+ * @param visitor a function accepting a `uint64_t`, invoked with each common element.
+ * @return the number of common elements.
+ */
+template <util::AllocType AT, class Visitor> uint64_t intersect(std::vector<EliasFano<AT> *> &lists, Visitor visitor) {
+	const size_t k = lists.size();
+	if (k == 0) return 0;
+	std::vector<typename EliasFano<AT>::Iterator> its;
+	its.reserve(k);
+	for (auto *l : lists) its.push_back(l->iterator());
+
+	uint64_t count = 0, x = 0;
+	size_t agree = 0;
+	for (size_t i = 0;; i = (i + 1) % k) {
+		const uint64_t y = its[i].skipTo(x);
+		if (y >= lists[i]->size()) break;
+		if (y == x) {
+			if (++agree == k) {
+				visitor(x);
+				count++;
+				x++;
+				agree = 0;
+			}
+		} else {
+			x = y;
+			agree = 1;
+		}
+	}
+	return count;
+}
+
+/** Returns the number of common elements of k EliasFano lists. */
+template <util::AllocType AT> uint64_t intersect(std::vector<EliasFano<AT> *> &lists) {
+	return intersect(lists, [](uint64_t) {});
+}
+
+/** Visits the union of two EliasFano lists (each common element once).
+ *
+ * @param a, b the operands.
+ * @param visitor a function accepting a `uint64_t`, invoked with each element of the union.
+ * @return the number of distinct elements.
+ */
+template <util::AllocType AT1, util::AllocType AT2, class Visitor> uint64_t setUnion(EliasFano<AT1> &a, EliasFano<AT2> &b, Visitor visitor) {
+	auto ita = a.iterator(), itb = b.iterator();
+	uint64_t count = 0;
+	bool ha = ita.hasNext(), hb = itb.hasNext();
+	uint64_t x = ha ? ita.next() : 0, y = hb ? itb.next() : 0;
+	while (ha && hb) {
+		const uint64_t m = min(x, y);
+		visitor(m);
+		count++;
+		if (x == m) {
+			ha = ita.hasNext();
+			if (ha) x = ita.next();
+		}
+		if (y == m) {
+			hb = itb.hasNext();
+			if (hb) y = itb.next();
+		}
+	}
+	while (ha) {
+		visitor(x);
+		count++;
+		ha = ita.hasNext();
+		if (ha) x = ita.next();
+	}
+	while (hb) {
+		visitor(y);
+		count++;
+		hb = itb.hasNext();
+		if (hb) y = itb.next();
+	}
+	return count;
+}
+
+/** Returns the number of distinct elements of two EliasFano lists. */
+template <util::AllocType AT1, util::AllocType AT2> uint64_t setUnion(EliasFano<AT1> &a, EliasFano<AT2> &b) {
+	return setUnion(a, b, [](uint64_t) {});
+}
+
+/** Visits the difference of two EliasFano lists (the elements of the first
+ * that do not appear in the second).
+ *
+ * The first list is scanned sequentially; each element is located in the
+ * second with a skip.
+ *
+ * @param a, b the operands.
+ * @param visitor a function accepting a `uint64_t`, invoked with each element of the difference.
+ * @return the number of elements of `a` not in `b`.
+ */
+template <util::AllocType AT1, util::AllocType AT2, class Visitor> uint64_t difference(EliasFano<AT1> &a, EliasFano<AT2> &b, Visitor visitor) {
+	auto ita = a.iterator(), itb = b.iterator();
+	uint64_t count = 0;
+	while (ita.hasNext()) {
+		const uint64_t x = ita.next();
+		if (itb.skipTo(x) != x) {
+			visitor(x);
+			count++;
+		}
+	}
+	return count;
+}
+
+/** Returns the number of elements of the first EliasFano list not in the second. */
+template <util::AllocType AT1, util::AllocType AT2> uint64_t difference(EliasFano<AT1> &a, EliasFano<AT2> &b) {
+	return difference(a, b, [](uint64_t) {});
+}
+
+} // namespace sux::bits
@@ -0,0 +1,188 @@
+/*
+ * Sux: Succinct data structures
+ *
+ * Copyright (C) 2007-2020 Sebastiano Vigna
+ *
+ *  This library is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as published by the Free
+ *  Software Foundation; either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * Under Section 7 of GPL version 3, you are granted additional permissions
+ * described in the GCC Runtime Library Exception, version 3.1, as published by
+ * the Free Software Foundation.
+ *
+ * You should have received a copy of the GNU General Public License and a copy of
+ * the GCC Runtime Library Exception along with this program; see the files
+ * COPYING3 and COPYING.RUNTIME respectively.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../support/common.hpp"
+#include "../util/Vector.hpp"
+#include "Rank.hpp"
+#include "Select.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace sux::bits {
+
+using namespace sux;
+
+/** A class implementing combined ranking and selection in the style of
+ * cs-poppy, using ≈3.2% additional space.
+ *
+ * The bit vector is divided into blocks of 2048 bits, and each block is
+ * described by a single 64-bit word packing a 32-bit cumulative count and the
+ * counts of three of its four 512-bit basic blocks, so one rank touches one
+ * index word and one cache line of the bit vector; 64-bit cumulative counts
+ * every 2³² bits remove the 32-bit limit. Selection is implemented by
+ * sampling the block of every 8192th one and completing with a binary search
+ * on the block counts, which makes it slower than Rank9Sel, but an order of
+ * magnitude smaller.
+ *
+ * The constructors of this class only store a reference
+ * to a provided bit vector. Should the content of the
+ * bit vector change, the results will be unpredictable.
+ *
+ * **Warning**: if you plan an calling rank(size_t) with
+ * argument size(), you must have at least one additional
+ * free bit at the end of the provided bit vector.
+ *
+ * @tparam AT a type of memory allocation out of sux::util::AllocType.
+ */
+
+template <util::AllocType AT = util::AllocType::MALLOC> class Poppy : public Rank, public Select {
+  protected:
+	static const int log2_bits_per_block = 11;
+	static const uint64_t bits_per_block = 1 << log2_bits_per_block;
+	static const int log2_ones_per_sample = 13;
+
+	const size_t num_bits;
+	size_t num_ones;
+	const uint64_t *bits;
+	util::Vector<uint64_t, AT> upper_counts, counts, sample;
+	uint64_t num_blocks;
+
+	/** Returns the number of ones preceding a given block. */
+	uint64_t block_rank(const uint64_t block) const { return upper_counts[block >> (32 - log2_bits_per_block)] + (counts[block] & 0xFFFFFFFF); }
+
+  public:
+	/** Creates a new instance using a given bit vector.
+	 *
+	 *  Note that this constructor only stores a reference
+	 *  to the provided bit vector. Should the content of the
+	 *  bit vector change, the results will be unpredictable.
+	 *
+	 *  **Warning**: if you plan an calling rank(size_t) with
+	 *  argument size(), you must have at least one additional
+	 *  free bit at the end of the provided bit vector.
+	 *
+	 * @param bits a bit vector of 64-bit words.
+	 * @param num_bits the length (in bits) of the bit vector.
+	 */
+	Poppy(const uint64_t *const bits, const uint64_t num_bits) : num_bits(num_bits), bits(bits) {
+		const uint64_t num_words = (num_bits + 63) / 64;
+		num_blocks = (num_bits + bits_per_block - 1) / bits_per_block;
+
+		upper_counts.size((num_blocks >> (32 - log2_bits_per_block)) + 1);
+		counts.size(num_blocks + 1);
+
+		num_ones = 0;
+		uint64_t upper_ones = 0;
+		for (uint64_t block = 0; block < num_blocks; block++) {
+			if ((block & ((1 << (32 - log2_bits_per_block)) - 1)) == 0) {
+				upper_counts[block >> (32 - log2_bits_per_block)] = num_ones;
+				upper_ones = num_ones;
+			}
+			uint64_t entry = num_ones - upper_ones;
+			for (int sub = 0; sub < 4; sub++) {
+				uint64_t in_basic_block = 0;
+				for (uint64_t w = block * (bits_per_block / 64) + sub * 8; w < std::min(num_words, block * (bits_per_block / 64) + (sub + 1) * 8); w++) in_basic_block += __builtin_popcountll(bits[w]);
+				if (sub < 3) entry |= in_basic_block << (32 + 10 * sub);
+				num_ones += in_basic_block;
+			}
+			counts[block] = entry;
+		}
+		// The sentinel entry makes rank(size()) work when num_bits is a multiple of the block size.
+		if ((num_blocks & ((1 << (32 - log2_bits_per_block)) - 1)) == 0) upper_counts[num_blocks >> (32 - log2_bits_per_block)] = num_ones;
+		counts[num_blocks] = num_ones - upper_counts[num_blocks >> (32 - log2_bits_per_block)];
+
+		assert(num_ones <= num_bits);
+
+		const uint64_t sample_size = (num_ones + (1 << log2_ones_per_sample) - 1) >> log2_ones_per_sample;
+		sample.size(sample_size + 1);
+
+		uint64_t d = 0;
+		for (uint64_t block = 0; block < num_blocks; block++) {
+			const uint64_t next_rank = block + 1 < num_blocks ? block_rank(block + 1) : num_ones;
+			while (d < next_rank) {
+				if ((d & ((1 << log2_ones_per_sample) - 1)) == 0) sample[d >> log2_ones_per_sample] = block;
+				d = (d | ((1 << log2_ones_per_sample) - 1)) + 1;
+			}
+			d = next_rank;
+		}
+		sample[sample_size] = num_blocks == 0 ? 0 : num_blocks - 1;
+	}
+
+	uint64_t rank(const size_t k) {
+		const uint64_t word = k / 64;
+		const uint64_t block = k >> log2_bits_per_block;
+		const uint64_t entry = counts[block];
+		const int sub = k >> 9 & 3;
+
+		uint64_t result = upper_counts[k >> 32] + (entry & 0xFFFFFFFF);
+		for (int i = 0; i < sub; i++) result += entry >> (32 + 10 * i) & 0x3FF;
+		for (uint64_t w = (k >> 9) * 8; w < word; w++) result += __builtin_popcountll(bits[w]);
+		return result + __builtin_popcountll(bits[word] & ((1ULL << k % 64) - 1));
+	}
+
+	size_t select(const uint64_t rank) {
+		uint64_t block = sample[rank >> log2_ones_per_sample];
+		uint64_t hi = sample[(rank >> log2_ones_per_sample) + 1];
+
+		while (block < hi) {
+			const uint64_t mid = (block + hi + 1) / 2;
+			if (block_rank(mid) <= rank) block = mid;
+			else hi = mid - 1;
+		}
+
+		uint64_t rank_in_block = rank - block_rank(block);
+		const uint64_t entry = counts[block];
+		int sub = 0;
+		for (; sub < 3; sub++) {
+			const uint64_t c = entry >> (32 + 10 * sub) & 0x3FF;
+			if (rank_in_block < c) break;
+			rank_in_block -= c;
+		}
+
+		uint64_t word = block * (bits_per_block / 64) + sub * 8;
+		for (;; word++) {
+			const int c = __builtin_popcountll(bits[word]);
+			if (rank_in_block < uint64_t(c)) break;
+			rank_in_block -= c;
+		}
+		return word * 64 + select64(bits[word], rank_in_block);
+	}
+
+	/** Returns an estimate of the size in bits of this structure. */
+	size_t bitCount() const {
+		return upper_counts.bitCount() - sizeof(upper_counts) * 8 + counts.bitCount() - sizeof(counts) * 8 + sample.bitCount() - sizeof(sample) * 8 + sizeof(*this) * 8;
+	}
+
+	/** Returns the size in bits of the underlying bit vector. */
+	size_t size() const { return num_bits; }
+};
+
+} // namespace sux::bits
@@ -62,6 +62,21 @@ class Rank {
 	 */
 	uint64_t rank(std::size_t from, std::size_t to) { return rank(to) - rank(from); }
 
+	/** Ranks a batch of positions.
+	 *
+	 * The default implementation simply loops over rank(std::size_t), but
+	 * implementations can overlap the memory accesses of several queries,
+	 * which on large structures is significantly faster than repeated
+	 * single-position calls.
+	 *
+	 * @param pos an array of positions from 0 to size() (included).
+	 * @param out an array of `n` elements receiving the ranks of the positions.
+	 * @param n the number of positions.
+	 */
+	virtual void rank(const std::size_t *pos, uint64_t *out, std::size_t n) {
+		for (std::size_t i = 0; i < n; i++) out[i] = rank(pos[i]);
+	}
+
 	/** Returns the number of zeros before the given posistion.
 	 *
 	 * @param pos A position from 0 to size() (included).
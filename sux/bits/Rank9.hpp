@@ -29,10 +29,20 @@
 #pragma once
 
 #include "../support/common.hpp"
+#include "../util/SpaceReport.hpp"
 #include "../util/Vector.hpp"
 #include "Rank.hpp"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
 
 namespace sux::bits {
 
@@ -41,6 +51,13 @@ using namespace sux;
 /** A class implementing Rank9, a ranking structure using
  * 25% additional space and providing very fast ranking.
  *
+ * Each 512-bit block of the bit vector has a counter holding the rank of its
+ * first bit, followed by the packed 9-bit ranks of the remaining basic blocks.
+ * By default the counter is a 64-bit word; instantiating the class with
+ * `COUNT` equal to `uint32_t` stores 32-bit counters instead, reducing the
+ * additional space to 18.75% on bit vectors shorter than 2³² bits (the only
+ * ones the compact variant supports).
+ *
  * The constructors of this class only store a reference
  * to a provided bit vector. Should the content of the
  * bit vector change, the results will be unpredictable.
@@ -50,16 +67,154 @@ using namespace sux;
  * free bit at the end of the provided bit vector.
  *
  * @tparam AT a type of memory allocation out of sux::util::AllocType.
+ * @tparam COUNT the type of the block counters, either `uint64_t` or `uint32_t`.
  */
 
-template <util::AllocType AT = util::AllocType::MALLOC> class Rank9 : public Rank {
+template <util::AllocType AT = util::AllocType::MALLOC, typename COUNT = uint64_t> class Rank9 : public Rank {
+	static_assert(std::is_same<COUNT, uint64_t>::value || std::is_same<COUNT, uint32_t>::value, "COUNT must be uint64_t or uint32_t");
+
   protected:
-	const size_t num_bits;
-	size_t num_ones;
-	const uint64_t *bits;
-	util::Vector<uint64_t, AT> counts;
+	/** The number of counter words per 512-bit block: the absolute counter,
+	 * followed by the packed in-block ranks (one 64-bit word, stored as two
+	 * words in the compact variant). */
+	static constexpr uint64_t COUNTS_PER_BLOCK = sizeof(COUNT) == 8 ? 2 : 3;
+
+	size_t num_bits = 0;
+	size_t num_ones = 0;
+	const uint64_t *bits = nullptr;
+	util::Vector<COUNT, AT> counts;
+
+	/** Reads the packed in-block ranks stored at a given address (a single
+	 * word, or two words of the compact variant). */
+	static uint64_t subcounts(const COUNT *const p) {
+		if constexpr (sizeof(COUNT) == 8) return *p;
+		else {
+			uint64_t v;
+			memcpy(&v, p, sizeof v);
+			return v;
+		}
+	}
+
+	/** Ors a value into the packed in-block ranks stored at a given address. */
+	static void orSubcounts(COUNT *const p, const uint64_t v) {
+		if constexpr (sizeof(COUNT) == 8) *p |= v;
+		else {
+			uint64_t w;
+			memcpy(&w, p, sizeof w);
+			w |= v;
+			memcpy(p, &w, sizeof w);
+		}
+	}
+
+  private:
+	/** Builds the counts of a range of 8-word blocks, with basic-block ranks
+	 * relative to the start of the range, and returns the number of ones in the range. */
+	uint64_t buildCountsScalar(const uint64_t block_start, const uint64_t block_end, const uint64_t num_words) {
+		uint64_t ones = 0;
+		for (uint64_t b = block_start; b < block_end; b++) {
+			const uint64_t i = b * 8, pos = b * COUNTS_PER_BLOCK;
+			const uint64_t base = ones;
+			counts[pos] = COUNT(base);
+			ones += __builtin_popcountll(bits[i]);
+			uint64_t sub = 0;
+			for (int j = 1; j < 8; j++) {
+				sub |= (ones - base) << 9 * (j - 1);
+				if (i + j < num_words) ones += __builtin_popcountll(bits[i + j]);
+			}
+			orSubcounts(&counts[pos + 1], sub);
+		}
+		return ones;
+	}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+	/** As buildCountsScalar(), but popcounting a whole block per instruction
+	 * with VPOPCNTQ; must run only on CPUs supporting AVX512VPOPCNTDQ. */
+	__attribute__((target("avx512f,avx512vpopcntdq"))) uint64_t buildCountsVpopcnt(const uint64_t block_start, const uint64_t block_end, const uint64_t num_words) {
+		uint64_t ones = 0;
+		uint64_t b = block_start;
+		for (; b < block_end && (b + 1) * 8 <= num_words; b++) {
+			uint64_t pc[8];
+			_mm512_storeu_si512(pc, _mm512_popcnt_epi64(_mm512_loadu_si512(bits + b * 8)));
+			counts[b * COUNTS_PER_BLOCK] = COUNT(ones);
+			uint64_t in_block = 0, sub = 0;
+			for (int j = 1; j < 8; j++) {
+				in_block += pc[j - 1];
+				sub |= in_block << 9 * (j - 1);
+			}
+			orSubcounts(&counts[b * COUNTS_PER_BLOCK + 1], sub);
+			ones += in_block + pc[7];
+		}
+		// A final partial block, if any.
+		for (; b < block_end; b++) {
+			const uint64_t i = b * 8, pos = b * COUNTS_PER_BLOCK;
+			const uint64_t base = ones;
+			counts[pos] = COUNT(base);
+			ones += __builtin_popcountll(bits[i]);
+			uint64_t sub = 0;
+			for (int j = 1; j < 8; j++) {
+				sub |= (ones - base) << 9 * (j - 1);
+				if (i + j < num_words) ones += __builtin_popcountll(bits[i + j]);
+			}
+			orSubcounts(&counts[pos + 1], sub);
+		}
+		return ones;
+	}
+#endif
+
+	/** The number of batched rank queries whose memory is prefetched together. */
+	static constexpr size_t RANK_WINDOW = 16;
+
+#if defined(__x86_64__) && defined(__GNUC__)
+	/** As the batched rank(), but gathering counter and bit words and
+	 * popcounting eight queries per instruction; must run only on CPUs
+	 * supporting AVX512VPOPCNTDQ, and only with 64-bit counters (the
+	 * compact variant falls back to the prefetched scalar loop). */
+	__attribute__((target("avx512f,avx512vpopcntdq"))) void rankVpopcnt(const size_t *pos, uint64_t *out, size_t n) {
+		const uint64_t *const c = &counts;
+		const __m512i ones = _mm512_set1_epi64(1), sevens = _mm512_set1_epi64(7);
+		for (size_t i = 0; i < n; i += RANK_WINDOW) {
+			const size_t end = std::min(n, i + RANK_WINDOW);
+			for (size_t j = i; j < end; j++) {
+				const uint64_t word = pos[j] / 64;
+				__builtin_prefetch(c + (word / 4 & ~UINT64_C(1)));
+				__builtin_prefetch(bits + word);
+			}
+			size_t j = i;
+			for (; j + 8 <= end; j += 8) {
+				const __m512i p = _mm512_loadu_si512(pos + j);
+				const __m512i word = _mm512_srli_epi64(p, 6);
+				const __m512i block = _mm512_andnot_si512(ones, _mm512_srli_epi64(word, 2));
+				// The shift extracting the in-block rank: 9 * (word % 8 - 1), or 63
+				// for the first word of a block, whose in-block rank is zero.
+				const __m512i t = _mm512_and_si512(word, sevens);
+				const __m512i tm1 = _mm512_sub_epi64(t, ones);
+				__m512i shift = _mm512_add_epi64(_mm512_slli_epi64(tm1, 3), tm1);
+				shift = _mm512_mask_mov_epi64(shift, _mm512_cmpeq_epi64_mask(t, _mm512_setzero_si512()), _mm512_set1_epi64(63));
+				const __m512i base = _mm512_i64gather_epi64(block, c, 8);
+				const __m512i sub = _mm512_i64gather_epi64(_mm512_add_epi64(block, ones), c, 8);
+				const __m512i mid = _mm512_and_si512(_mm512_srlv_epi64(sub, shift), _mm512_set1_epi64(0x1FF));
+				const __m512i mask = _mm512_sub_epi64(_mm512_sllv_epi64(ones, _mm512_and_si512(p, _mm512_set1_epi64(63))), ones);
+				const __m512i in_word = _mm512_popcnt_epi64(_mm512_and_si512(_mm512_i64gather_epi64(word, bits, 8), mask));
+				_mm512_storeu_si512(out + j, _mm512_add_epi64(_mm512_add_epi64(base, mid), in_word));
+			}
+			for (; j < end; j++) out[j] = rank(pos[j]);
+		}
+	}
+#endif
+
+	uint64_t buildCounts(const uint64_t block_start, const uint64_t block_end, const uint64_t num_words) {
+#if defined(__x86_64__) && defined(__GNUC__)
+		if (__builtin_cpu_supports("avx512vpopcntdq")) return buildCountsVpopcnt(block_start, block_end, num_words);
+#endif
+		return buildCountsScalar(block_start, block_end, num_words);
+	}
+
+	/** Builds an instance from parts computed by a Builder. */
+	Rank9(const uint64_t *const bits, const uint64_t num_bits, const uint64_t num_ones, util::Vector<COUNT, AT> &&counts) : num_bits(num_bits), num_ones(num_ones), bits(bits), counts(std::move(counts)) {}
 
   public:
+	Rank9() {}
+
 	/** Creates a new instance using a given bit vector.
 	 *
 	 *  Note that this constructor only stores a reference
@@ -72,41 +227,201 @@ template <util::AllocType AT = util::AllocType::MALLOC> class Rank9 : public Ran
 	 *
 	 * @param bits a bit vector of 64-bit words.
 	 * @param num_bits the length (in bits) of the bit vector.
+	 * @param num_threads the number of threads used to build the counts.
 	 */
 
-	Rank9(const uint64_t *const bits, const uint64_t num_bits) : num_bits(num_bits), bits(bits) {
+	Rank9(const uint64_t *const bits, const uint64_t num_bits, const size_t num_threads = 1) : num_bits(num_bits), bits(bits) {
+		assert(sizeof(COUNT) == 8 || num_bits < UINT64_C(1) << 32);
 		const uint64_t num_words = (num_bits + 63) / 64;
-		const uint64_t num_counts = ((num_bits + 64 * 8 - 1) / (64 * 8)) * 2;
+		const uint64_t num_blocks = (num_bits + 64 * 8 - 1) / (64 * 8);
+		const uint64_t num_counts = num_blocks * COUNTS_PER_BLOCK;
 
-		// Init rank structure
-		counts.size(num_counts + 2);
+		// Init rank structure; the rounding keeps serialized images 64-bit aligned.
+		counts.size((num_counts + COUNTS_PER_BLOCK + 1) & ~UINT64_C(1));
 
-		num_ones = 0;
-		uint64_t pos = 0;
-		for (uint64_t i = 0; i < num_words; i += 8, pos += 2) {
-			counts[pos] = num_ones;
-			num_ones += __builtin_popcountll(bits[i]);
-			for (int j = 1; j < 8; j++) {
-				counts[pos + 1] |= (num_ones - counts[pos]) << 9 * (j - 1);
-				if (i + j < num_words) num_ones += __builtin_popcountll(bits[i + j]);
+		if (num_threads > 1 && num_blocks >= num_threads) {
+			// Each thread counts a range of blocks with ranks relative to the
+			// start of its range; a second pass adds the range bases.
+			const uint64_t blocks_per_thread = (num_blocks + num_threads - 1) / num_threads;
+			std::vector<uint64_t> base(num_threads);
+			std::vector<std::thread> threads;
+			for (size_t t = 0; t < num_threads; t++)
+				threads.emplace_back([this, t, blocks_per_thread, num_blocks, num_words, &base]() {
+					const uint64_t block_start = std::min(t * blocks_per_thread, num_blocks);
+					const uint64_t block_end = std::min(block_start + blocks_per_thread, num_blocks);
+					base[t] = buildCounts(block_start, block_end, num_words);
+				});
+			for (auto &t : threads) t.join();
+			threads.clear();
+
+			num_ones = 0;
+			for (size_t t = 0; t < num_threads; t++) {
+				const uint64_t b = base[t];
+				base[t] = num_ones;
+				num_ones += b;
 			}
-		}
 
-		counts[num_counts] = num_ones;
+			for (size_t t = 0; t < num_threads; t++)
+				threads.emplace_back([this, t, blocks_per_thread, num_blocks, &base]() {
+					const uint64_t block_start = std::min(t * blocks_per_thread, num_blocks);
+					const uint64_t block_end = std::min(block_start + blocks_per_thread, num_blocks);
+					for (uint64_t b = block_start; b < block_end; b++) counts[b * COUNTS_PER_BLOCK] += base[t];
+				});
+			for (auto &t : threads) t.join();
+		} else
+			num_ones = buildCounts(0, num_blocks, num_words);
+
+		counts[num_counts] = COUNT(num_ones);
 
 		assert(num_ones <= num_bits);
 	}
 
+	/** A streaming builder, computing the counts incrementally while the bit
+	 * vector is read in chunks (say, from disk), so that construction can
+	 * overlap the I/O and the bit vector is never scanned a second time.
+	 *
+	 * Words are fed in order with appendWords(); once all words have been
+	 * appended, build() returns the completed structure. The bit vector itself
+	 * is not stored by the builder: as with the constructors, the caller
+	 * provides in build() the address of the complete vector, which must stay
+	 * alive as long as the returned instance is in use.
+	 */
+	class Builder {
+	  protected:
+		util::Vector<COUNT, AT> counts;
+		uint64_t num_bits, num_words, num_counts;
+		uint64_t word_pos = 0, ones = 0;
+
+		/** Completes the counts; all words must have been appended. Idempotent,
+		 * so subclasses may call it before adding their own final touches. */
+		void finishCounts() {
+			assert(word_pos == num_words);
+			if (num_words % 8 != 0) {
+				const uint64_t pos = num_words / 8 * COUNTS_PER_BLOCK;
+				for (int j = num_words % 8; j < 8; j++) orSubcounts(&counts[pos + 1], (ones - counts[pos]) << 9 * (j - 1));
+			}
+			counts[num_counts] = COUNT(ones);
+		}
+
+	  public:
+		/** Creates a builder for a bit vector of a given length.
+		 *
+		 * @param num_bits the length (in bits) of the bit vector.
+		 */
+		Builder(const uint64_t num_bits) : num_bits(num_bits), num_words((num_bits + 63) / 64), num_counts(((num_bits + 64 * 8 - 1) / (64 * 8)) * COUNTS_PER_BLOCK) {
+			assert(sizeof(COUNT) == 8 || num_bits < UINT64_C(1) << 32);
+			// The rounding keeps serialized images 64-bit aligned.
+			counts.size((num_counts + COUNTS_PER_BLOCK + 1) & ~UINT64_C(1));
+		}
+
+		/** Appends the next chunk of words of the bit vector.
+		 *
+		 * @param words the next chunk of the bit vector.
+		 * @param n the number of words in the chunk.
+		 */
+		void appendWords(const uint64_t *const words, const size_t n) {
+			assert(word_pos + n <= num_words);
+			for (size_t i = 0; i < n; i++) {
+				const uint64_t pos = word_pos / 8 * COUNTS_PER_BLOCK;
+				const int j = word_pos % 8;
+				if (j == 0) counts[pos] = COUNT(ones);
+				else orSubcounts(&counts[pos + 1], (ones - counts[pos]) << 9 * (j - 1));
+				ones += __builtin_popcountll(words[i]);
+				word_pos++;
+			}
+		}
+
+		/** Returns the completed structure; all words must have been appended.
+		 *
+		 * @param bits the address of the complete bit vector, which must stay
+		 * alive as long as the returned instance is in use.
+		 */
+		Rank9<AT, COUNT> build(const uint64_t *const bits) {
+			finishCounts();
+			return Rank9<AT, COUNT>(bits, num_bits, ones, std::move(counts));
+		}
+	};
+
+	using Rank::rank;
+
 	uint64_t rank(const size_t k) {
 		const uint64_t word = k / 64;
-		const uint64_t block = word / 4 & ~1;
+		const uint64_t block = word / 8 * COUNTS_PER_BLOCK;
 		const int offset = word % 8 - 1;
-		return counts[block] + (counts[block + 1] >> (offset + (offset >> (sizeof offset * 8 - 4) & 0x8)) * 9 & 0x1FF) + __builtin_popcountll(bits[word] & ((1ULL << k % 64) - 1));
+		return counts[block] + (subcounts(&counts[block + 1]) >> (offset + (offset >> (sizeof offset * 8 - 4) & 0x8)) * 9 & 0x1FF) + __builtin_popcountll(bits[word] & ((1ULL << k % 64) - 1));
+	}
+
+	/** Ranks a batch of positions.
+	 *
+	 * The positions are processed in small windows whose counter and bit
+	 * words are prefetched before any query in the window is resolved, so
+	 * several cache misses are kept in flight; on CPUs supporting
+	 * AVX512VPOPCNTDQ the counter lookups are gathered and the popcounts
+	 * vectorized eight queries at a time.
+	 *
+	 * @param pos an array of positions from 0 to size() (included).
+	 * @param out an array of `n` elements receiving the ranks of the positions.
+	 * @param n the number of positions.
+	 */
+	virtual void rank(const size_t *pos, uint64_t *out, size_t n) {
+#if defined(__x86_64__) && defined(__GNUC__)
+		if constexpr (sizeof(COUNT) == 8) {
+			if (__builtin_cpu_supports("avx512vpopcntdq")) {
+				rankVpopcnt(pos, out, n);
+				return;
+			}
+		}
+#endif
+		for (size_t i = 0; i < n; i += RANK_WINDOW) {
+			const size_t end = std::min(n, i + RANK_WINDOW);
+			for (size_t j = i; j < end; j++) {
+				const uint64_t word = pos[j] / 64;
+				__builtin_prefetch(&counts + word / 8 * COUNTS_PER_BLOCK);
+				__builtin_prefetch(bits + word);
+			}
+			for (size_t j = i; j < end; j++) out[j] = rank(pos[j]);
+		}
+	}
+
+	/** Maps this structure over a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator, must be 64-bit
+	 * aligned, and must stay alive as long as this instance is in use. Since
+	 * this structure does not own its bit vector, the latter must be
+	 * provided again by the caller.
+	 *
+	 * @param p a pointer inside a memory-mapped serialized image.
+	 * @param bits the bit vector this structure refers to.
+	 * @return the pointer advanced past the data of this structure.
+	 */
+	void *map(void *p, const uint64_t *const bits) {
+		uint64_t *q = static_cast<uint64_t *>(p);
+		num_bits = *q++;
+		num_ones = *q++;
+		this->bits = bits;
+		return counts.map(q);
+	}
+
+	friend std::ostream &operator<<(std::ostream &os, const Rank9<AT, COUNT> &rank9) {
+		const uint64_t nbits = rank9.num_bits, nones = rank9.num_ones;
+		os.write((char *)&nbits, sizeof(uint64_t));
+		os.write((char *)&nones, sizeof(uint64_t));
+		return os << rank9.counts;
 	}
 
 	/** Returns an estimate of the size in bits of this structure. */
 	size_t bitCount() const { return counts.bitCount() - sizeof(counts) * 8 + sizeof(*this) * 8; }
 
+	/** Returns a structured report of the space used by this structure (excluding the bit vector). */
+	util::SpaceReport spaceReport() const { return {"rank9", sizeof(*this) * 8, AT, {util::spaceReport("counts", counts)}}; }
+
+	/** Prefaults the counters and the bit vector in layout order, so that
+	 * the first queries after loading or mapping do not pay soft page faults. */
+	void warmup() const {
+		counts.prefault();
+		util::prefault(bits, (num_bits + 63) / 64 * sizeof(uint64_t));
+	}
+
 	/** Returns the size in bits of the underlying bit vector. */
 	size_t size() const { return num_bits; }
 };
@@ -32,6 +32,7 @@
 #include "Rank9.hpp"
 #include "Select.hpp"
 #include <cstdint>
+#include <type_traits>
 
 namespace sux::bits {
 
@@ -39,6 +40,13 @@ namespace sux::bits {
  * Select9 uses 25%-37.5% additional space (beside the 25% due to Rank9), depending on density,
  * and provides constant-time selection.
  *
+ * The counts are shared with Rank9 and are read by the selection broadword
+ * code as packed 64-bit words, so they keep their layout; the primary
+ * inventory, however, stores one absolute bit position every 512 ones, and
+ * instantiating the class with `INV` equal to `uint32_t` stores it in 32-bit
+ * entries, which suffice for bit vectors shorter than 2³² − 256 bits (the
+ * only ones the compact variant supports).
+ *
  * The constructors of this class only store a reference
  * to a provided bit vector. Should the content of the
  * bit vector change, the results will be unpredictable.
@@ -46,17 +54,139 @@ namespace sux::bits {
  * **Warning**: if you plan an calling rank(size_t) with
  * argument size(), you must have at least one additional
  * free bit at the end of the provided bit vector.
+ *
+ * @tparam AT a type of memory allocation out of sux::util::AllocType.
+ * @tparam INV the type of the inventory entries, either `uint64_t` or `uint32_t`.
  */
-template <util::AllocType AT = util::AllocType::MALLOC> class Rank9Sel : public Rank9<AT>, public Select {
+template <util::AllocType AT = util::AllocType::MALLOC, typename INV = uint64_t> class Rank9Sel : public Rank9<AT>, public Select {
+	static_assert(std::is_same<INV, uint64_t>::value || std::is_same<INV, uint32_t>::value, "INV must be uint64_t or uint32_t");
+
   private:
 	static const int log2_ones_per_inventory = 9;
 	static const int ones_per_inventory = 1 << log2_ones_per_inventory;
 	static const uint64_t inventory_mask = ones_per_inventory - 1;
 
-	util::Vector<uint64_t, AT> inventory, subinventory;
+	util::Vector<INV, AT> inventory;
+	util::Vector<uint64_t, AT> subinventory;
 	uint64_t inventory_size;
 
+	/** Fills the inventory entries falling in a range of words; the range
+	 * must start at a counts-block (8-word) boundary, so that the rank of its
+	 * first bit can be read off the counts. */
+	void fillInventory(const uint64_t word_start, const uint64_t word_end) {
+		uint64_t d = this->counts[word_start / 8 * 2];
+		for (uint64_t i = word_start; i < word_end; i++)
+			for (int j = 0; j < 64; j++)
+				if (this->bits[i] & 1ULL << j) {
+					if ((d & inventory_mask) == 0) {
+						inventory[d >> log2_ones_per_inventory] = INV(i * 64 + j);
+						assert(this->counts[(i / 8) * 2] <= d);
+						assert(this->counts[(i / 8) * 2 + 2] > d);
+					}
+
+					d++;
+				}
+	}
+
+	/** Writes the counts-derived part of the subinventory entry starting at a
+	 * given bit, and returns how the entry stores its positions: 0 for 64-bit
+	 * absolute, 1 for 32-bit relative, 2 for 16-bit relative, -1 for none
+	 * (short spans are resolved through the counts alone). */
+	static int writeSubinventoryHeader(uint64_t *const s, const uint64_t first_bit, const uint64_t next_bit, const util::Vector<uint64_t, AT> &counts) {
+		const uint64_t span = (next_bit / 64) / 4 - (first_bit / 64) / 4;
+		const uint64_t counts_at_start = counts[((first_bit / 64) / 8) * 2];
+		const uint64_t block_span = (next_bit / 64) / 8 - (first_bit / 64) / 8;
+		const uint64_t block_left = (first_bit / 64) / 8;
+
+		if (span >= 512) return 0;
+		if (span >= 256) return 1;
+		if (span >= 128) return 2;
+		if (span >= 16) {
+			assert(((block_span + 8) & -8LL) + 8 <= span * 4);
+
+			uint64_t k;
+			for (k = 0; k < block_span; k++) {
+				assert(((uint16_t *)s)[k + 8] == 0);
+				((uint16_t *)s)[k + 8] = counts[(block_left + k + 1) * 2] - counts_at_start;
+			}
+
+			for (; k < ((block_span + 8) & -8LL); k++) {
+				assert(((uint16_t *)s)[k + 8] == 0);
+				((uint16_t *)s)[k + 8] = 0xFFFFU;
+			}
+
+			assert(block_span / 8 <= 8);
+
+			for (k = 0; k < block_span / 8; k++) {
+				assert(((uint16_t *)s)[k] == 0);
+				((uint16_t *)s)[k] = counts[(block_left + (k + 1) * 8) * 2] - counts_at_start;
+			}
+
+			for (; k < 8; k++) {
+				assert(((uint16_t *)s)[k] == 0);
+				((uint16_t *)s)[k] = 0xFFFFU;
+			}
+		} else if (span >= 2) {
+			assert(((block_span + 8) & -8LL) <= span * 4);
+
+			uint64_t k;
+			for (k = 0; k < block_span; k++) {
+				assert(((uint16_t *)s)[k] == 0);
+				((uint16_t *)s)[k] = counts[(block_left + k + 1) * 2] - counts_at_start;
+			}
+
+			for (; k < ((block_span + 8) & -8LL); k++) {
+				assert(((uint16_t *)s)[k] == 0);
+				((uint16_t *)s)[k] = 0xFFFFU;
+			}
+		}
+
+		return -1;
+	}
+
+	/** Builds the subinventory of a single inventory entry. Entries write to
+	 * disjoint regions of the subinventory, so they can be built in parallel. */
+	void buildSubinventoryItem(const uint64_t index, const uint64_t num_words) {
+		uint64_t d = index << log2_ones_per_inventory;
+		const uint64_t end_d = std::min(uint64_t(this->num_ones), d + ones_per_inventory);
+		const uint64_t first_bit = inventory[index];
+
+		uint64_t *const s = &subinventory[(first_bit / 64) / 4];
+		const int state = writeSubinventoryHeader(s, first_bit, inventory[index + 1], this->counts);
+
+		if (state == -1) return;
+
+		for (uint64_t i = first_bit / 64; i < num_words && d < end_d; i++)
+			for (int j = i == first_bit / 64 ? first_bit % 64 : 0; j < 64 && d < end_d; j++)
+				if (this->bits[i] & 1ULL << j) {
+					switch (state) {
+					case 0:
+						assert(s[d & inventory_mask] == 0);
+						s[d & inventory_mask] = i * 64 + j;
+						break;
+					case 1:
+						assert(((uint32_t *)s)[d & inventory_mask] == 0);
+						assert(i * 64 + j - first_bit < (1ULL << 32));
+						((uint32_t *)s)[d & inventory_mask] = i * 64 + j - first_bit;
+						break;
+					case 2:
+						assert(((uint16_t *)s)[d & inventory_mask] == 0);
+						assert(i * 64 + j - first_bit < (1 << 16));
+						((uint16_t *)s)[d & inventory_mask] = i * 64 + j - first_bit;
+						break;
+					}
+
+					d++;
+				}
+	}
+
+	/** Builds an instance from parts computed by a Builder. */
+	Rank9Sel(Rank9<AT> &&rank9, util::Vector<INV, AT> &&inventory, util::Vector<uint64_t, AT> &&subinventory, const uint64_t inventory_size)
+		: Rank9<AT>(std::move(rank9)), inventory(std::move(inventory)), subinventory(std::move(subinventory)), inventory_size(inventory_size) {}
+
   public:
+	Rank9Sel() {}
+
 	/** Creates a new instance using a given bit vector.
 	 *
 	 * Note that this constructor only stores a reference
@@ -69,9 +199,12 @@ template <util::AllocType AT = util::AllocType::MALLOC> class Rank9Sel : public
 	 *
 	 * @param bits a bit vector of 64-bit words.
 	 * @param num_bits the length (in bits) of the bit vector.
+	 * @param num_threads the number of threads used to build the counts and the inventories.
 	 */
 
-	Rank9Sel(const uint64_t *const bits, const uint64_t num_bits) : Rank9<AT>(bits, num_bits) {
+	Rank9Sel(const uint64_t *const bits, const uint64_t num_bits, const size_t num_threads = 1) : Rank9<AT>(bits, num_bits, num_threads) {
+		// The sentinel entry is the length rounded up to a multiple of 256 bits.
+		assert(sizeof(INV) == 8 || num_bits <= (UINT64_C(1) << 32) - 256);
 		const uint64_t num_words = (num_bits + 63) / 64;
 		inventory_size = (this->num_ones + ones_per_inventory - 1) / ones_per_inventory;
 
@@ -80,118 +213,148 @@ template <util::AllocType AT = util::AllocType::MALLOC> class Rank9Sel : public
 #endif
 		assert(ones_per_inventory <= 8 * 64);
 
-		inventory.size(inventory_size + 1);
+		// One sentinel entry, rounded up to a multiple of 64 bits so that
+		// serialized images keep the subinventory aligned.
+		inventory.size((inventory_size + 8 / sizeof(INV)) & ~uint64_t(8 / sizeof(INV) - 1));
 		subinventory.size((num_words + 3) / 4);
 
-		uint64_t d = 0;
-		for (uint64_t i = 0; i < num_words; i++)
-			for (int j = 0; j < 64; j++)
-				if (bits[i] & 1ULL << j) {
-					if ((d & inventory_mask) == 0) {
-						inventory[d >> log2_ones_per_inventory] = i * 64 + j;
-						assert(this->counts[(i / 8) * 2] <= d);
-						assert(this->counts[(i / 8) * 2 + 2] > d);
-					}
-
-					d++;
-				}
-
-		assert(this->num_ones == d);
-		inventory[inventory_size] = ((num_words + 3) & ~3ULL) * 64;
+		const uint64_t num_blocks = (num_words + 7) / 8;
+		if (num_threads > 1 && num_blocks >= num_threads) {
+			// Distinct word ranges fill distinct inventory entries, as long as
+			// each range starts at a counts-block boundary.
+			const uint64_t blocks_per_thread = (num_blocks + num_threads - 1) / num_threads;
+			std::vector<std::thread> threads;
+			for (size_t t = 0; t < num_threads; t++)
+				threads.emplace_back([this, t, blocks_per_thread, num_blocks, num_words]() {
+					const uint64_t word_start = std::min(t * blocks_per_thread, num_blocks) * 8;
+					const uint64_t word_end = std::min((t + 1) * blocks_per_thread, num_blocks) * 8;
+					fillInventory(word_start, std::min(word_end, num_words));
+				});
+			for (auto &t : threads) t.join();
+			threads.clear();
+
+			inventory[inventory_size] = INV(((num_words + 3) & ~3ULL) * 64);
+
+			const uint64_t items_per_thread = (inventory_size + num_threads - 1) / num_threads;
+			for (size_t t = 0; t < num_threads; t++)
+				threads.emplace_back([this, t, items_per_thread, num_words]() {
+					const uint64_t item_start = std::min(t * items_per_thread, inventory_size);
+					const uint64_t item_end = std::min(item_start + items_per_thread, inventory_size);
+					for (uint64_t index = item_start; index < item_end; index++) buildSubinventoryItem(index, num_words);
+				});
+			for (auto &t : threads) t.join();
+		} else {
+			fillInventory(0, num_words);
+			inventory[inventory_size] = INV(((num_words + 3) & ~3ULL) * 64);
+			for (uint64_t index = 0; index < inventory_size; index++) buildSubinventoryItem(index, num_words);
+		}
 
 #ifdef DEBUG
 		printf("Inventory size: %" PRId64 "\n", inventory_size);
-		printf("Inventory entries filled: %" PRId64 "\n", d / ones_per_inventory + 1);
-		// printf("First inventories: %" PRId64 " %" PRId64 " %" PRId64 " %" PRId64 "\n", inventory[0],
-		// inventory[1], inventory[2],
-		//       inventory[3]);
+		printf("Inventory entries filled: %" PRId64 "\n", this->num_ones / ones_per_inventory + 1);
 #endif
+	}
 
-		d = 0;
-		int state;
-		uint64_t *s, first_bit, index, span, block_span, block_left, counts_at_start;
+	/** A streaming builder, computing the counts and the selection inventories
+	 * incrementally while the bit vector is read in chunks (say, from disk),
+	 * so that construction can overlap the I/O and the bit vector is never
+	 * scanned a second time.
+	 *
+	 * The positions of the ones of the inventory entry under construction are
+	 * buffered (at most 4KiB), and the entry is completed as soon as the next
+	 * entry opens. Words are fed in order with appendWords(); once all words
+	 * have been appended, build() returns the completed structure. The bit
+	 * vector itself is not stored by the builder: as with the constructors,
+	 * the caller provides in build() the address of the complete vector, which
+	 * must stay alive as long as the returned instance is in use.
+	 */
+	class Builder : public Rank9<AT>::Builder {
+		util::Vector<INV, AT> inventory;
+		util::Vector<uint64_t, AT> subinventory;
+		uint64_t entry_positions[ones_per_inventory];
+		uint64_t d = 0, entry_fill = 0;
+
+		/** Completes the subinventory entry of an inventory index whose
+		 * successor has just been written, using the buffered positions. */
+		void flushEntry(const uint64_t index) {
+			const uint64_t first_bit = inventory[index];
+			uint64_t *const s = &subinventory[(first_bit / 64) / 4];
+			const int state = Rank9Sel::writeSubinventoryHeader(s, first_bit, inventory[index + 1], this->counts);
+
+			if (state == -1) return;
+
+			for (uint64_t k = 0; k < entry_fill; k++) {
+				switch (state) {
+				case 0:
+					assert(s[k] == 0);
+					s[k] = entry_positions[k];
+					break;
+				case 1:
+					assert(((uint32_t *)s)[k] == 0);
+					assert(entry_positions[k] - first_bit < (1ULL << 32));
+					((uint32_t *)s)[k] = entry_positions[k] - first_bit;
+					break;
+				case 2:
+					assert(((uint16_t *)s)[k] == 0);
+					assert(entry_positions[k] - first_bit < (1 << 16));
+					((uint16_t *)s)[k] = entry_positions[k] - first_bit;
+					break;
+				}
+			}
+		}
 
-		for (uint64_t i = 0; i < num_words; i++)
-			for (int j = 0; j < 64; j++)
-				if (bits[i] & 1ULL << j) {
-					if ((d & inventory_mask) == 0) {
-						first_bit = i * 64 + j;
-						index = d >> log2_ones_per_inventory;
-						assert(inventory[index] == first_bit);
-						s = &subinventory[(inventory[index] / 64) / 4];
-						span = (inventory[index + 1] / 64) / 4 - (inventory[index] / 64) / 4;
-						state = -1;
-						counts_at_start = this->counts[((inventory[index] / 64) / 8) * 2];
-						block_span = (inventory[index + 1] / 64) / 8 - (inventory[index] / 64) / 8;
-						block_left = (inventory[index] / 64) / 8;
-
-						if (span >= 512)
-							state = 0;
-						else if (span >= 256)
-							state = 1;
-						else if (span >= 128)
-							state = 2;
-						else if (span >= 16) {
-							assert(((block_span + 8) & -8LL) + 8 <= span * 4);
-
-							uint64_t k;
-							for (k = 0; k < block_span; k++) {
-								assert(((uint16_t *)s)[k + 8] == 0);
-								((uint16_t *)s)[k + 8] = this->counts[(block_left + k + 1) * 2] - counts_at_start;
-							}
-
-							for (; k < ((block_span + 8) & -8LL); k++) {
-								assert(((uint16_t *)s)[k + 8] == 0);
-								((uint16_t *)s)[k + 8] = 0xFFFFU;
-							}
-
-							assert(block_span / 8 <= 8);
-
-							for (k = 0; k < block_span / 8; k++) {
-								assert(((uint16_t *)s)[k] == 0);
-								((uint16_t *)s)[k] = this->counts[(block_left + (k + 1) * 8) * 2] - counts_at_start;
-							}
-
-							for (; k < 8; k++) {
-								assert(((uint16_t *)s)[k] == 0);
-								((uint16_t *)s)[k] = 0xFFFFU;
-							}
-						} else if (span >= 2) {
-							assert(((block_span + 8) & -8LL) <= span * 4);
-
-							uint64_t k;
-							for (k = 0; k < block_span; k++) {
-								assert(((uint16_t *)s)[k] == 0);
-								((uint16_t *)s)[k] = this->counts[(block_left + k + 1) * 2] - counts_at_start;
-							}
-
-							for (; k < ((block_span + 8) & -8LL); k++) {
-								assert(((uint16_t *)s)[k] == 0);
-								((uint16_t *)s)[k] = 0xFFFFU;
-							}
-						}
-					}
+	  public:
+		/** Creates a builder for a bit vector of a given length.
+		 *
+		 * @param num_bits the length (in bits) of the bit vector.
+		 */
+		Builder(const uint64_t num_bits) : Rank9<AT>::Builder(num_bits) {
+			// The sentinel entry is the length rounded up to a multiple of 256 bits.
+			assert(sizeof(INV) == 8 || num_bits <= (UINT64_C(1) << 32) - 256);
+			inventory.size((num_bits + ones_per_inventory - 1) / ones_per_inventory + 1); // Worst case: all ones
+			subinventory.size((this->num_words + 3) / 4);
+		}
 
-					switch (state) {
-					case 0:
-						assert(s[d & inventory_mask] == 0);
-						s[d & inventory_mask] = i * 64 + j;
-						break;
-					case 1:
-						assert(((uint32_t *)s)[d & inventory_mask] == 0);
-						assert(i * 64 + j - first_bit < (1ULL << 32));
-						((uint32_t *)s)[d & inventory_mask] = i * 64 + j - first_bit;
-						break;
-					case 2:
-						assert(((uint16_t *)s)[d & inventory_mask] == 0);
-						assert(i * 64 + j - first_bit < (1 << 16));
-						((uint16_t *)s)[d & inventory_mask] = i * 64 + j - first_bit;
-						break;
+		/** Appends the next chunk of words of the bit vector.
+		 *
+		 * @param words the next chunk of the bit vector.
+		 * @param n the number of words in the chunk.
+		 */
+		void appendWords(const uint64_t *const words, const size_t n) {
+			for (size_t i = 0; i < n; i++) {
+				const uint64_t w = this->word_pos;
+				Rank9<AT>::Builder::appendWords(words + i, 1);
+				for (uint64_t word = words[i]; word != 0; word &= word - 1) {
+					const uint64_t p = w * 64 + rho(word);
+					if ((d & inventory_mask) == 0) {
+						const uint64_t index = d >> log2_ones_per_inventory;
+						inventory[index] = INV(p);
+						if (index != 0) flushEntry(index - 1);
+						entry_fill = 0;
 					}
-
+					entry_positions[entry_fill++] = p;
 					d++;
 				}
-	}
+			}
+		}
+
+		/** Returns the completed structure; all words must have been appended.
+		 *
+		 * @param bits the address of the complete bit vector, which must stay
+		 * alive as long as the returned instance is in use.
+		 */
+		Rank9Sel<AT, INV> build(const uint64_t *const bits) {
+			this->finishCounts(); // The last subinventory entry may read the final counts
+			const uint64_t inventory_size = (d + ones_per_inventory - 1) / ones_per_inventory;
+			// One sentinel entry, rounded up to a multiple of 64 bits so that
+			// serialized images keep the subinventory aligned.
+			inventory.size((inventory_size + 8 / sizeof(INV)) & ~uint64_t(8 / sizeof(INV) - 1));
+			inventory.trimToFit();
+			inventory[inventory_size] = INV(((this->num_words + 3) & ~3ULL) * 64);
+			if (d != 0) flushEntry(inventory_size - 1);
+			return Rank9Sel<AT, INV>(Rank9<AT>::Builder::build(bits), std::move(inventory), std::move(subinventory), inventory_size);
+		}
+	};
 
 	size_t select(const uint64_t rank) {
 		const uint64_t inventory_index_left = rank >> log2_ones_per_inventory;
@@ -290,9 +453,48 @@ template <util::AllocType AT = util::AllocType::MALLOC> class Rank9Sel : public
 		return word * UINT64_C(64) + select64(this->bits[word], rank_in_word);
 	}
 
+	/** Maps this structure over a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator, must be 64-bit
+	 * aligned, and must stay alive as long as this instance is in use. Since
+	 * this structure does not own its bit vector, the latter must be
+	 * provided again by the caller.
+	 *
+	 * @param p a pointer inside a memory-mapped serialized image.
+	 * @param bits the bit vector this structure refers to.
+	 * @return the pointer advanced past the data of this structure.
+	 */
+	void *map(void *p, const uint64_t *const bits) {
+		p = Rank9<AT>::map(p, bits);
+		uint64_t *q = static_cast<uint64_t *>(p);
+		inventory_size = *q++;
+		p = inventory.map(q);
+		return subinventory.map(p);
+	}
+
+	friend std::ostream &operator<<(std::ostream &os, const Rank9Sel<AT, INV> &rank9sel) {
+		os << static_cast<const Rank9<AT> &>(rank9sel);
+		os.write((char *)&rank9sel.inventory_size, sizeof(uint64_t));
+		return os << rank9sel.inventory << rank9sel.subinventory;
+	}
+
 	size_t bitCount() const {
 		return this->counts.bitCount() - sizeof(this->counts) * 8 + inventory.bitCount() - sizeof(inventory) * 8 + subinventory.bitCount() - sizeof(subinventory) * 8 + sizeof(*this) * 8;
 	}
+
+	/** Returns a structured report of the space used by this structure (excluding the bit vector). */
+	util::SpaceReport spaceReport() const {
+		return {"rank9sel", sizeof(*this) * 8, AT, {util::spaceReport("counts", this->counts), util::spaceReport("inventory", inventory), util::spaceReport("subinventory", subinventory)}};
+	}
+
+	/** Prefaults the counters, the inventories and the bit vector in layout
+	 * order, so that the first queries after loading or mapping do not pay
+	 * soft page faults. */
+	void warmup() const {
+		Rank9<AT>::warmup();
+		inventory.prefault();
+		subinventory.prefault();
+	}
 };
 
 } // namespace sux::bits
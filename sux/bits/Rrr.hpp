@@ -0,0 +1,266 @@
+/*
+ * Sux: Succinct data structures
+ *
+ * Copyright (C) 2007-2020 Sebastiano Vigna
+ *
+ *  This library is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as published by the Free
+ *  Software Foundation; either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * Under Section 7 of GPL version 3, you are granted additional permissions
+ * described in the GCC Runtime Library Exception, version 3.1, as published by
+ * the Free Software Foundation.
+ *
+ * You should have received a copy of the GNU General Public License and a copy of
+ * the GCC Runtime Library Exception along with this program; see the files
+ * COPYING3 and COPYING.RUNTIME respectively.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../support/common.hpp"
+#include "../util/Vector.hpp"
+#include "Rank.hpp"
+#include "Select.hpp"
+#include <array>
+#include <cstdint>
+
+namespace sux::bits {
+
+using namespace sux;
+
+/** An entropy-compressed bit vector with ranking and selection, in the style of
+ * Raman, Raman and Rao.
+ *
+ * The bit vector is split into blocks of 63 bits; each block is stored as its
+ * class (the number of ones, 6 bits) and its lexicographic offset within the
+ * class (&lceil;log binom(63, class)&rceil; bits). Every 32 blocks a superblock
+ * records the cumulative rank and the position in the offset stream. The space
+ * approaches the zeroth-order entropy of the vector, which for sparse or
+ * strongly clustered vectors is a small fraction of the plain representation;
+ * in exchange, queries decode up to a superblock of classes and walk one block
+ * combinatorially, so they are a few times slower than Rank9.
+ *
+ * Contrarily to Rank9 and friends, this class stores (a compressed copy of)
+ * the bit vector, so the vector provided at construction time need not be
+ * kept alive.
+ *
+ * @tparam AT a type of memory allocation out of sux::util::AllocType.
+ */
+
+template <util::AllocType AT = util::AllocType::MALLOC> class Rrr : public Rank, public Select {
+  private:
+	static constexpr int block_bits = 63;
+	static constexpr int class_bits = 6;
+	static constexpr int blocks_per_superblock = 32;
+
+	static constexpr array<array<uint64_t, 64>, 64> fill_binomial() {
+		array<array<uint64_t, 64>, 64> b{};
+		for (int n = 0; n < 64; n++) {
+			b[n][0] = 1;
+			for (int k = 1; k <= n; k++) b[n][k] = b[n - 1][k - 1] + b[n - 1][k];
+		}
+		return b;
+	}
+
+	/** binomial[n][k] is binom(n, k), zero for k > n. */
+	static constexpr array<array<uint64_t, 64>, 64> binomial = fill_binomial();
+
+	static constexpr array<uint8_t, 64> fill_offset_bits() {
+		array<uint8_t, 64> w{};
+		for (int c = 0; c <= block_bits; c++) {
+			int v = 0;
+			while ((uint64_t(1) << v) < binomial[block_bits][c]) v++;
+			w[c] = v;
+		}
+		return w;
+	}
+
+	/** offset_bits[c] is the width of the offset of a block of class c (at most 60). */
+	static constexpr array<uint8_t, 64> offset_bits = fill_offset_bits();
+
+	size_t num_bits = 0;
+	uint64_t num_ones = 0;
+	uint64_t num_blocks = 0;
+	util::Vector<uint64_t, AT> classes;  // 6-bit block classes
+	util::Vector<uint64_t, AT> offsets;  // Variable-width block offsets
+	util::Vector<uint64_t, AT> counts;   // Per superblock, cumulative rank and offset-stream position
+
+	static uint64_t readBits(const uint64_t *const p, const uint64_t start, const int width) {
+		const int l = start % 64;
+		uint64_t w = p[start / 64] >> l;
+		if (l + width > 64) w |= p[start / 64 + 1] << (64 - l);
+		return w & ((UINT64_C(1) << width) - 1);
+	}
+
+	static void writeBits(uint64_t *const p, const uint64_t start, const int width, const uint64_t value) {
+		const int l = start % 64;
+		p[start / 64] |= value << l;
+		if (l + width > 64) p[start / 64 + 1] |= value >> (64 - l);
+	}
+
+	uint64_t getClass(const uint64_t block) const { return readBits(&classes, block * class_bits, class_bits); }
+
+	/** Returns the lexicographic offset of a block among those of its class. */
+	static uint64_t encodeBlock(const uint64_t word, int ones) {
+		uint64_t o = 0;
+		for (int i = 0; ones != 0; i++) {
+			if (word & UINT64_C(1) << i) {
+				o += binomial[block_bits - 1 - i][ones];
+				ones--;
+			}
+		}
+		return o;
+	}
+
+	/** Returns the number of ones among the first end bits of a block. */
+	static int blockRank(const uint64_t c, uint64_t o, const int end) {
+		int ones = 0, r = c;
+		for (int i = 0; i < end && r != 0; i++) {
+			const uint64_t b = binomial[block_bits - 1 - i][r];
+			if (o >= b) {
+				o -= b;
+				r--;
+				ones++;
+			}
+		}
+		return ones;
+	}
+
+	/** Returns the position within a block of the one of given local rank. */
+	static int blockSelect(const uint64_t c, uint64_t o, int rank) {
+		int r = c;
+		for (int i = 0;; i++) {
+			const uint64_t b = binomial[block_bits - 1 - i][r];
+			if (o >= b) {
+				if (rank-- == 0) return i;
+				o -= b;
+				r--;
+			}
+		}
+	}
+
+  public:
+	Rrr() {}
+
+	/** Creates a new instance, compressing a given bit vector.
+	 *
+	 * The bit vector is copied in compressed form: contrarily to Rank9 and
+	 * friends, it need not be kept alive by the caller.
+	 *
+	 * @param bits a bit vector of 64-bit words.
+	 * @param num_bits the length (in bits) of the bit vector.
+	 */
+	Rrr(const uint64_t *const bits, const uint64_t num_bits) : num_bits(num_bits), num_blocks((num_bits + block_bits - 1) / block_bits) {
+		classes.size((num_blocks * class_bits + 63) / 64 + 1);
+		counts.size(((num_blocks + blocks_per_superblock - 1) / blocks_per_superblock) * 2 + 2);
+
+		// First pass: compute the length of the offset stream.
+		uint64_t offset_length = 0;
+		for (uint64_t i = 0; i < num_blocks; i++) {
+			const int width = i == num_blocks - 1 && num_bits % block_bits != 0 ? num_bits % block_bits : block_bits;
+			offset_length += offset_bits[__builtin_popcountll(readBits(bits, i * block_bits, width))];
+		}
+		offsets.size((offset_length + 63) / 64 + 1);
+
+		// Second pass: fill classes, offsets and superblock counts.
+		uint64_t pos = 0;
+		for (uint64_t i = 0; i < num_blocks; i++) {
+			if (i % blocks_per_superblock == 0) {
+				counts[i / blocks_per_superblock * 2] = num_ones;
+				counts[i / blocks_per_superblock * 2 + 1] = pos;
+			}
+			const int width = i == num_blocks - 1 && num_bits % block_bits != 0 ? num_bits % block_bits : block_bits;
+			const uint64_t word = readBits(bits, i * block_bits, width);
+			const int c = __builtin_popcountll(word);
+			writeBits(&classes, i * class_bits, class_bits, c);
+			writeBits(&offsets, pos, offset_bits[c], encodeBlock(word, c));
+			pos += offset_bits[c];
+			num_ones += c;
+		}
+		counts[(num_blocks + blocks_per_superblock - 1) / blocks_per_superblock * 2] = num_ones;
+	}
+
+	uint64_t rank(const size_t k) {
+		if (k >= num_bits) return num_ones;
+		const uint64_t block = k / block_bits;
+		const uint64_t superblock = block / blocks_per_superblock;
+		uint64_t ones = counts[superblock * 2], pos = counts[superblock * 2 + 1];
+		for (uint64_t j = superblock * blocks_per_superblock; j < block; j++) {
+			const uint64_t c = getClass(j);
+			ones += c;
+			pos += offset_bits[c];
+		}
+		const int t = k % block_bits;
+		if (t != 0) {
+			const uint64_t c = getClass(block);
+			ones += blockRank(c, readBits(&offsets, pos, offset_bits[c]), t);
+		}
+		return ones;
+	}
+
+	size_t select(const uint64_t rank) {
+		assert(rank < num_ones);
+		// Find the last superblock whose cumulative rank is at most rank.
+		size_t lo = 0, hi = (num_blocks + blocks_per_superblock - 1) / blocks_per_superblock - 1;
+		while (lo < hi) {
+			const size_t mid = (lo + hi + 1) / 2;
+			if (counts[mid * 2] <= rank) lo = mid;
+			else hi = mid - 1;
+		}
+		uint64_t ones = counts[lo * 2], pos = counts[lo * 2 + 1];
+		uint64_t j = lo * blocks_per_superblock;
+		for (uint64_t c; (c = getClass(j)) + ones <= rank; j++) {
+			ones += c;
+			pos += offset_bits[c];
+		}
+		const uint64_t c = getClass(j);
+		return j * block_bits + blockSelect(c, readBits(&offsets, pos, offset_bits[c]), rank - ones);
+	}
+
+	/** Maps this structure over a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator, must be 64-bit
+	 * aligned, and must stay alive as long as this instance is in use.
+	 *
+	 * @param p a pointer inside a memory-mapped serialized image.
+	 * @return the pointer advanced past the data of this structure.
+	 */
+	void *map(void *p) {
+		uint64_t *q = static_cast<uint64_t *>(p);
+		num_bits = *q++;
+		num_ones = *q++;
+		num_blocks = *q++;
+		p = classes.map(q);
+		p = offsets.map(p);
+		return counts.map(p);
+	}
+
+	friend std::ostream &operator<<(std::ostream &os, const Rrr<AT> &rrr) {
+		const uint64_t nbits = rrr.num_bits, nones = rrr.num_ones, nblocks = rrr.num_blocks;
+		os.write((char *)&nbits, sizeof(uint64_t));
+		os.write((char *)&nones, sizeof(uint64_t));
+		os.write((char *)&nblocks, sizeof(uint64_t));
+		return os << rrr.classes << rrr.offsets << rrr.counts;
+	}
+
+	/** Returns an estimate of the size in bits of this structure. */
+	size_t bitCount() const {
+		return classes.bitCount() - sizeof(classes) * 8 + offsets.bitCount() - sizeof(offsets) * 8 + counts.bitCount() - sizeof(counts) * 8 + sizeof(*this) * 8;
+	}
+
+	/** Returns the size in bits of the underlying bit vector. */
+	size_t size() const { return num_bits; }
+};
+
+} // namespace sux::bits
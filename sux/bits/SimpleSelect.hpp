@@ -29,9 +29,12 @@
 #pragma once
 
 #include "../support/common.hpp"
+#include "../util/SpaceReport.hpp"
 #include "../util/Vector.hpp"
 #include "Select.hpp"
 #include <cstdint>
+#include <type_traits>
+#include <vector>
 
 namespace sux::bits {
 
@@ -43,44 +46,95 @@ using namespace std;
  * under the same conditions, provide very fast selects. For very unevenly distributed arrays
  * the space occupancy will grow significantly, and access time might vary wildly.
  *
+ * By default the inventory and the spill list store 64-bit entries;
+ * instantiating the class with `INV` equal to `int32_t` stores 32-bit entries
+ * instead, halving the additional space on bit vectors shorter than 2³¹ bits
+ * (the only ones the compact variant supports). Since a subinventory word
+ * then holds two 16-bit subentries rather than four, a given number of words
+ * per subinventory yields subentries that are twice as coarse.
+ *
  * The constructors of this class only store a reference
  * to a provided bit vector. Should the content of the
  * bit vector change, the results will be unpredictable.
  *
  * @tparam AT a type of memory allocation out of sux::util::AllocType.
+ * @tparam INV the type of the inventory entries, either `int64_t` or `int32_t`.
  */
 
-template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelect : public Select {
+template <util::AllocType AT = util::AllocType::MALLOC, typename INV = int64_t> class SimpleSelect : public Select {
+	static_assert(std::is_same<INV, int64_t>::value || std::is_same<INV, int32_t>::value, "INV must be int64_t or int32_t");
+
   private:
+	using UINV = std::make_unsigned_t<INV>;
 	static const int max_ones_per_inventory = 8192;
+	/** The number of 16-bit subentries fitting in an inventory word. */
+	static const int sub16s_per_word = sizeof(INV) / 2;
+	/** The sign bit, marking an inventory entry whose positions are spilled. */
+	static const UINV spill_flag = UINV(1) << (sizeof(INV) * 8 - 1);
 
 	const uint64_t *bits;
-	util::Vector<int64_t, AT> inventory;
-	util::Vector<uint64_t, AT> exact_spill;
+	util::Vector<INV, AT> inventory;
+	util::Vector<UINV, AT> exact_spill;
 	int log2_ones_per_inventory, log2_ones_per_sub16, log2_ones_per_sub64, log2_longwords_per_subinventory, ones_per_inventory, ones_per_sub16, ones_per_sub64, longwords_per_subinventory,
 		longwords_per_inventory, ones_per_inventory_mask, ones_per_sub16_mask, ones_per_sub64_mask;
 
 	uint64_t num_words, inventory_size, exact_spill_size, num_ones;
 
-  public:
-	SimpleSelect() {}
-
-	/** Creates a new instance using a given bit vector.
+	/** Chooses the subinventory size from the distribution of the ones.
 	 *
-	 * @param bits a bit vector of 64-bit words.
-	 * @param num_bits the length (in bits) of the bit vector.
-	 * @param max_log2_longwords_per_subinventory the number of words per subinventory:
-	 * a larger value yields a faster map that uses more space; typical values are between 0 and 3.
+	 * The spans of the inventories that will be resolved by 16-bit subentries
+	 * (those shorter than 2^16 bits; longer ones are stored exactly and need
+	 * no scan) are measured, and the smallest subinventory is chosen whose
+	 * 16-bit subentries leave, on the mean span, a sequential scan of about
+	 * four words of the bit vector. On evenly distributed vectors this picks
+	 * the largest (fastest) subinventory; on clustered vectors, where spans
+	 * are short or spilled, it picks a smaller one at no cost in scan length.
 	 */
-	SimpleSelect(const uint64_t *const bits, const uint64_t num_bits, const int max_log2_longwords_per_subinventory) : bits(bits) {
-		num_words = (num_bits + 63) / 64;
-
-		// Init rank/select structure
+	static int tuneLongwords(const uint64_t *const bits, const uint64_t num_bits) {
+		const uint64_t num_words = (num_bits + 63) / 64;
 		uint64_t c = 0;
-		for (uint64_t i = 0; i < num_words; i++) c += __builtin_popcountll(bits[i]);
-		num_ones = c;
+		for (uint64_t i = 0; i < num_words; i++) c += nu(bits[i]);
+
+		int ones_per_inventory = num_bits == 0 ? 0 : (c * max_ones_per_inventory + num_bits - 1) / num_bits;
+		const int log2_ones_per_inventory = max(0, lambda_safe(ones_per_inventory));
+		const uint64_t mask = (1ULL << log2_ones_per_inventory) - 1;
+
+		uint64_t d = 0, prev = 0, spans = 0, count = 0;
+		for (uint64_t i = 0; i < num_words; i++) {
+			uint64_t word = bits[i];
+			if (i == num_words - 1 && (num_bits & 63)) word &= (1ULL << (num_bits & 63)) - 1;
+			while (word != 0) {
+				if ((d++ & mask) == 0) {
+					const uint64_t pos = i * 64 + rho(word);
+					if (d > 1 && pos - prev < (1 << 16)) {
+						spans += pos - prev;
+						count++;
+					}
+					prev = pos;
+				}
+				word &= word - 1;
+			}
+		}
+		if (c != 0 && num_bits - prev < (1 << 16)) {
+			spans += num_bits - prev;
+			count++;
+		}
 
-		assert(c <= num_bits);
+		if (count == 0) return 0;
+		const uint64_t mean = spans / count;
+
+		int log2 = 0;
+		while (log2 < 3 && mean > (1024ULL << log2)) log2++;
+		return log2;
+	}
+
+	/** Computes the inventory layout for a given length and number of ones. */
+	void layout(const uint64_t num_bits, const uint64_t c, const int max_log2_longwords_per_subinventory) {
+		// The sign bit of the entries is a flag, so positions must fit in the rest.
+		assert(sizeof(INV) == 8 || num_bits < UINT64_C(1) << 31);
+		num_words = (num_bits + 63) / 64;
+		num_ones = c;
+		exact_spill_size = 0;
 
 		ones_per_inventory = num_bits == 0 ? 0 : (c * max_ones_per_inventory + num_bits - 1) / num_bits;
 		// Make ones_per_inventory into a power of 2
@@ -97,7 +151,7 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelect : pub
 		longwords_per_subinventory = 1 << log2_longwords_per_subinventory;
 		longwords_per_inventory = longwords_per_subinventory + 1;
 		log2_ones_per_sub64 = max(0, log2_ones_per_inventory - log2_longwords_per_subinventory);
-		log2_ones_per_sub16 = max(0, log2_ones_per_sub64 - 2);
+		log2_ones_per_sub16 = max(0, log2_ones_per_sub64 - (sub16s_per_word == 4 ? 2 : 1));
 		ones_per_sub64 = 1ULL << log2_ones_per_sub64;
 		ones_per_sub16 = 1ULL << log2_ones_per_sub16;
 		ones_per_sub64_mask = ones_per_sub64 - 1;
@@ -106,9 +160,41 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelect : pub
 #ifdef DEBUG
 		printf("Longwords per subinventory: %d Ones per sub 64: %d sub 16: %d\n", longwords_per_subinventory, ones_per_sub64, ones_per_sub16);
 #endif
+	}
+
+  public:
+	SimpleSelect() {}
+
+	/** Creates a new instance using a given bit vector, tuning the subinventory size automatically.
+	 *
+	 * The bit vector is scanned once beforehand and the number of longwords
+	 * per subinventory is chosen from the measured distribution of the ones
+	 * (see tuneLongwords()). The choice can be inspected afterwards with
+	 * longwordsPerSubinventory() and spillSize().
+	 *
+	 * @param bits a bit vector of 64-bit words.
+	 * @param num_bits the length (in bits) of the bit vector.
+	 */
+	SimpleSelect(const uint64_t *const bits, const uint64_t num_bits) : SimpleSelect(bits, num_bits, tuneLongwords(bits, num_bits)) {}
+
+	/** Creates a new instance using a given bit vector.
+	 *
+	 * @param bits a bit vector of 64-bit words.
+	 * @param num_bits the length (in bits) of the bit vector.
+	 * @param max_log2_longwords_per_subinventory the number of words per subinventory:
+	 * a larger value yields a faster map that uses more space; typical values are between 0 and 3.
+	 */
+	SimpleSelect(const uint64_t *const bits, const uint64_t num_bits, const int max_log2_longwords_per_subinventory) : bits(bits) {
+		// Init rank/select structure
+		uint64_t c = 0;
+		for (uint64_t i = 0; i < (num_bits + 63) / 64; i++) c += __builtin_popcountll(bits[i]);
+
+		assert(c <= num_bits);
+
+		layout(num_bits, c, max_log2_longwords_per_subinventory);
 
 		inventory.size(inventory_size * longwords_per_inventory + 1);
-		const int64_t *end_of_inventory = &inventory + inventory_size * longwords_per_inventory + 1;
+		const INV *end_of_inventory = &inventory + inventory_size * longwords_per_inventory + 1;
 
 		uint64_t d = 0;
 
@@ -117,13 +203,13 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelect : pub
 			for (int j = 0; j < 64; j++) {
 				if (i * 64 + j >= num_bits) break;
 				if (bits[i] & 1ULL << j) {
-					if ((d & ones_per_inventory_mask) == 0) inventory[(d >> log2_ones_per_inventory) * longwords_per_inventory] = i * 64 + j;
+					if ((d & ones_per_inventory_mask) == 0) inventory[(d >> log2_ones_per_inventory) * longwords_per_inventory] = INV(i * 64 + j);
 					d++;
 				}
 			}
 
 		assert(c == d);
-		inventory[inventory_size * longwords_per_inventory] = num_bits;
+		inventory[inventory_size * longwords_per_inventory] = INV(num_bits);
 
 #ifdef DEBUG
 		printf("Inventory entries filled: %" PRId64 "\n", inventory_size + 1);
@@ -165,7 +251,7 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelect : pub
 			exact_spill.size(exact_spill_size);
 
 			uint16_t *p16;
-			int64_t *p64;
+			INV *p64;
 			int offset;
 			spilled = 0;
 			d = 0;
@@ -186,22 +272,22 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelect : pub
 						if (span < (1 << 16)) {
 							assert(i * 64 + j - start <= (1 << 16));
 							if ((d & ones_per_sub16_mask) == 0) {
-								assert(offset < longwords_per_subinventory * 4);
+								assert(offset < longwords_per_subinventory * sub16s_per_word);
 								assert(p16 + offset < (uint16_t *)end_of_inventory);
 								p16[offset++] = i * 64 + j - start;
 							}
 						} else {
 							if (ones_per_sub64 == 1) {
 								assert(p64 + offset < end_of_inventory);
-								p64[offset++] = i * 64 + j;
+								p64[offset++] = INV(i * 64 + j);
 							} else {
 								assert(p64 < end_of_inventory);
 								if ((d & ones_per_inventory_mask) == 0) {
-									inventory[inventory_index * longwords_per_inventory] |= 1ULL << 63;
-									p64[0] = spilled;
+									inventory[inventory_index * longwords_per_inventory] |= spill_flag;
+									p64[0] = INV(spilled);
 								}
 								assert(spilled < exact_spill_size);
-								exact_spill[spilled++] = i * 64 + j;
+								exact_spill[spilled++] = UINV(i * 64 + j);
 							}
 						}
 
@@ -223,16 +309,18 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelect : pub
 #endif
 	}
 
+	class Builder;
+
 	size_t select(const uint64_t rank) {
 #ifdef DEBUG
 		printf("Selecting %" PRId64 "\n...", rank);
 #endif
 
 		const uint64_t inventory_index = rank >> log2_ones_per_inventory;
-		const int64_t *inventory_start = &inventory + (inventory_index << log2_longwords_per_subinventory) + inventory_index;
+		const INV *inventory_start = &inventory + (inventory_index << log2_longwords_per_subinventory) + inventory_index;
 		assert(inventory_index <= inventory_size);
 
-		const int64_t inventory_rank = *inventory_start;
+		const INV inventory_rank = *inventory_start;
 		const int subrank = rank & ones_per_inventory_mask;
 #ifdef DEBUG
 		printf("Rank: %" PRId64 " inventory index: %" PRId64 " inventory rank: %" PRId64 " subrank: %d\n", rank, inventory_index, inventory_rank, subrank);
@@ -241,7 +329,7 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelect : pub
 #ifdef DEBUG
 		if (subrank == 0) puts("Exact hit (no subrank); returning inventory");
 #endif
-		if (subrank == 0) return inventory_rank & ~(1ULL << 63);
+		if (subrank == 0) return UINV(inventory_rank) & ~spill_flag;
 
 		uint64_t start;
 		int residual;
@@ -275,8 +363,127 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelect : pub
 		return word_index * 64 + select64(word, residual);
 	}
 
+	/** Returns the number of 64-bit words allocated to each subinventory (chosen at construction). */
+	int longwordsPerSubinventory() const { return longwords_per_subinventory; }
+
+	/** Returns the number of positions stored in the exact spill list. */
+	uint64_t spillSize() const { return exact_spill_size; }
+
 	/** Returns an estimate of the size (in bits) of this structure. */
 	size_t bitCount() const { return inventory.bitCount() - sizeof(inventory) * 8 + exact_spill.bitCount() - sizeof(exact_spill) * 8 + sizeof(*this) * 8; }
+
+	/** Returns a structured report of the space used by this structure (excluding the bit vector). */
+	util::SpaceReport spaceReport() const { return {"simple_select", sizeof(*this) * 8, AT, {util::spaceReport("inventory", inventory), util::spaceReport("exact_spill", exact_spill)}}; }
+
+	/** Prefaults the inventories in layout order (the bit vector is not
+	 * owned by this structure, and is left to the caller). */
+	void warmup() const {
+		inventory.prefault();
+		exact_spill.prefault();
+	}
+};
+
+/** A streaming builder, computing the inventories incrementally while the bit
+ * vector is read in chunks (say, from disk), so that construction can overlap
+ * the I/O and the bit vector is never scanned a second time.
+ *
+ * Since the inventory layout depends on the density, the number of ones must
+ * be known in advance (it usually is, from the metadata of the file being
+ * read). The positions of the ones of the inventory entry under construction
+ * are buffered (at most 64KiB), and the entry is completed as soon as the next
+ * entry opens. Words are fed in order with appendWords(); once all words have
+ * been appended, build() returns the completed structure. The bit vector
+ * itself is not stored by the builder: as with the constructors, the caller
+ * provides in build() the address of the complete vector, which must stay
+ * alive as long as the returned instance is in use.
+ */
+template <util::AllocType AT, typename INV> class SimpleSelect<AT, INV>::Builder {
+	SimpleSelect<AT, INV> sel;
+	uint64_t num_bits, word_pos = 0, d = 0, spilled = 0, entry_fill = 0;
+	std::vector<uint64_t> entry_positions;
+
+	/** Completes the inventory entry whose successor has just been written,
+	 * using the buffered positions. */
+	void flushEntry(const uint64_t index) {
+		if (sel.ones_per_inventory == 1) return;
+		const uint64_t start = sel.inventory[index * sel.longwords_per_inventory];
+		const uint64_t span = sel.inventory[(index + 1) * sel.longwords_per_inventory] - start;
+		INV *const p64 = &sel.inventory[index * sel.longwords_per_inventory + 1];
+		uint16_t *const p16 = (uint16_t *)p64;
+		int offset = 0;
+
+		if (span < (1 << 16)) {
+			for (uint64_t k = 0; k < entry_fill; k++)
+				if ((k & sel.ones_per_sub16_mask) == 0) {
+					assert(offset < sel.longwords_per_subinventory * sub16s_per_word);
+					assert(entry_positions[k] - start <= (1 << 16));
+					p16[offset++] = entry_positions[k] - start;
+				}
+		} else if (sel.ones_per_sub64 == 1) {
+			for (uint64_t k = 0; k < entry_fill; k++) p64[offset++] = INV(entry_positions[k]);
+		} else {
+			sel.inventory[index * sel.longwords_per_inventory] |= spill_flag;
+			p64[0] = INV(spilled);
+			for (uint64_t k = 0; k < entry_fill; k++) sel.exact_spill.pushBack(UINV(entry_positions[k]));
+			spilled += entry_fill;
+		}
+	}
+
+  public:
+	/** Creates a builder for a bit vector of a given length and number of ones.
+	 *
+	 * @param num_bits the length (in bits) of the bit vector.
+	 * @param num_ones the number of ones in the bit vector.
+	 * @param max_log2_longwords_per_subinventory the number of words per subinventory:
+	 * a larger value yields a faster map that uses more space; typical values are between 0 and 3.
+	 */
+	Builder(const uint64_t num_bits, const uint64_t num_ones, const int max_log2_longwords_per_subinventory = 3) : num_bits(num_bits) {
+		assert(num_ones <= num_bits);
+		sel.layout(num_bits, num_ones, max_log2_longwords_per_subinventory);
+		sel.inventory.size(sel.inventory_size * sel.longwords_per_inventory + 1);
+		entry_positions.resize(sel.ones_per_inventory);
+	}
+
+	/** Appends the next chunk of words of the bit vector.
+	 *
+	 * @param words the next chunk of the bit vector.
+	 * @param n the number of words in the chunk.
+	 */
+	void appendWords(const uint64_t *const words, const size_t n) {
+		assert(word_pos + n <= sel.num_words);
+		for (size_t i = 0; i < n; i++, word_pos++) {
+			uint64_t word = words[i];
+			if (word_pos == sel.num_words - 1 && num_bits % 64 != 0) word &= (1ULL << num_bits % 64) - 1;
+			while (word != 0) {
+				const uint64_t p = word_pos * 64 + rho(word);
+				if ((d & sel.ones_per_inventory_mask) == 0) {
+					const uint64_t index = d >> sel.log2_ones_per_inventory;
+					sel.inventory[index * sel.longwords_per_inventory] = INV(p);
+					if (index != 0) flushEntry(index - 1);
+					entry_fill = 0;
+				}
+				entry_positions[entry_fill++] = p;
+				d++;
+				word &= word - 1;
+			}
+		}
+	}
+
+	/** Returns the completed structure; all words must have been appended.
+	 *
+	 * @param bits the address of the complete bit vector, which must stay
+	 * alive as long as the returned instance is in use.
+	 */
+	SimpleSelect<AT, INV> build(const uint64_t *const bits) {
+		assert(word_pos == sel.num_words);
+		assert(d == sel.num_ones);
+		sel.inventory[sel.inventory_size * sel.longwords_per_inventory] = INV(num_bits);
+		if (d != 0) flushEntry((d - 1) >> sel.log2_ones_per_inventory);
+		sel.exact_spill.trimToFit();
+		sel.exact_spill_size = spilled;
+		sel.bits = bits;
+		return std::move(sel);
+	}
 };
 
 } // namespace sux::bits
@@ -29,9 +29,13 @@
 #pragma once
 
 #include "../support/common.hpp"
+#include "../util/SpaceReport.hpp"
 #include "../util/Vector.hpp"
 #include "Select.hpp"
 #include <cstdint>
+#if defined(__cpp_impl_coroutine)
+#include "../support/Lookup.hpp"
+#endif
 
 namespace sux::bits {
 
@@ -214,6 +218,56 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelectHalf {
 		return word_index * 64 + select64(word, residual);
 	}
 
+	/** Prefetches the inventory entry used by select() for a given rank. */
+	void prefetch(const uint64_t rank) const {
+		const uint64_t inventory_index = rank >> log2_ones_per_inventory;
+		__builtin_prefetch(&inventory + (inventory_index << log2_longwords_per_subinventory) + inventory_index);
+	}
+
+#if defined(__cpp_impl_coroutine)
+	/** Returns select() as a suspendable Lookup (see sux::Lookup).
+	 *
+	 * The lookup suspends after prefetching the inventory entry and again,
+	 * if a scan is needed, after prefetching its starting word, so a driver
+	 * such as sux::interleave() can overlap the misses of many selections.
+	 */
+	Lookup<uint64_t> selectLookup(const uint64_t rank) {
+		assert(rank < num_ones);
+		const uint64_t inventory_index = rank >> log2_ones_per_inventory;
+		const int64_t *inventory_start = &inventory + (inventory_index << log2_longwords_per_subinventory) + inventory_index;
+		co_await prefetched(inventory_start);
+
+		const int64_t inventory_rank = *inventory_start;
+		const int subrank = rank & ones_per_inventory_mask;
+
+		uint64_t start;
+		int residual;
+
+		if (inventory_rank >= 0) {
+			start = inventory_rank + ((uint16_t *)(inventory_start + 1))[subrank >> log2_ones_per_sub16];
+			residual = subrank & ones_per_sub16_mask;
+		} else {
+			start = -inventory_rank - 1 + *(inventory_start + 1 + (subrank >> log2_ones_per_sub64));
+			residual = subrank & ones_per_sub64_mask;
+		}
+
+		if (residual == 0) co_return start;
+
+		uint64_t word_index = start / 64;
+		co_await prefetched(bits + word_index);
+		uint64_t word = bits[word_index] & -1ULL << start % 64;
+
+		for (;;) {
+			const int bit_count = __builtin_popcountll(word);
+			if (residual < bit_count) break;
+			word = bits[++word_index];
+			residual -= bit_count;
+		}
+
+		co_return word_index * 64 + select64(word, residual);
+	}
+#endif
+
 	uint64_t select(const uint64_t rank, uint64_t *const next) {
 		const uint64_t s = select(rank);
 		int curr = s / 64;
@@ -227,8 +281,57 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelectHalf {
 		return s;
 	}
 
+	/** Re-binds this structure to a bit vector (e.g., after deserialization).
+	 *
+	 * The bit vector must have the same content as the one this
+	 * structure was built on.
+	 *
+	 * @param bits a bit vector of 64-bit words.
+	 */
+	void setBits(const uint64_t *const bits) { this->bits = bits; }
+
+	/** Maps this structure over a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator and must
+	 * stay alive as long as this instance is in use.
+	 *
+	 * @param p a pointer inside a memory-mapped serialized image.
+	 * @param bits the bit vector this structure refers to.
+	 * @return the pointer advanced past the data of this structure.
+	 */
+	void *map(void *p, const uint64_t *const bits) {
+		uint64_t *q = static_cast<uint64_t *>(p);
+		num_words = *q++;
+		inventory_size = *q++;
+		num_ones = *q++;
+		this->bits = bits;
+		return inventory.map(q);
+	}
+
+	friend std::ostream &operator<<(std::ostream &os, const SimpleSelectHalf<AT> &ss) {
+		os.write((char *)&ss.num_words, sizeof(uint64_t));
+		os.write((char *)&ss.inventory_size, sizeof(uint64_t));
+		os.write((char *)&ss.num_ones, sizeof(uint64_t));
+		return os << ss.inventory;
+	}
+
+	/** After deserialization, the structure must be re-bound to its bit vector with setBits(). */
+	friend std::istream &operator>>(std::istream &is, SimpleSelectHalf<AT> &ss) {
+		is.read((char *)&ss.num_words, sizeof(uint64_t));
+		is.read((char *)&ss.inventory_size, sizeof(uint64_t));
+		is.read((char *)&ss.num_ones, sizeof(uint64_t));
+		return is >> ss.inventory;
+	}
+
 	/** Returns an estimate of the size (in bits) of this structure. */
 	size_t bitCount() const { return inventory.bitCount() - sizeof(inventory) * 8 + sizeof(*this) * 8; };
+
+	/** Returns a structured report of the space used by this structure (excluding the bit vector). */
+	util::SpaceReport spaceReport() const { return {"simple_select_half", sizeof(*this) * 8, AT, {util::spaceReport("inventory", inventory)}}; }
+
+	/** Prefaults the inventory (the bit vector is not owned by this
+	 * structure, and is left to the caller). */
+	void warmup() const { inventory.prefault(); }
 };
 
 } // namespace sux::bits
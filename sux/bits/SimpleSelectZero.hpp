@@ -32,6 +32,7 @@
 #include "../util/Vector.hpp"
 #include "SelectZero.hpp"
 #include <cstdint>
+#include <vector>
 
 namespace sux::bits {
 using namespace std;
@@ -61,26 +62,11 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelectZero {
 
 	uint64_t num_words, inventory_size, exact_spill_size, num_zeros;
 
-  public:
-	SimpleSelectZero() {}
-
-	/** Creates a new instance using a given bit vector.
-	 *
-	 * @param bits a bit vector of 64-bit words.
-	 * @param num_bits the length (in bits) of the bit vector.
-	 * @param max_log2_longwords_per_subinventory the number of words per subinventory:
-	 * a larger value yields a faster map that uses more space; typical values are between 0 and 3.
-	 */
-	SimpleSelectZero(const uint64_t *const bits, const uint64_t num_bits, const int max_log2_longwords_per_subinventory) : bits(bits) {
+	/** Computes the inventory layout for a given length and number of zeros. */
+	void layout(const uint64_t num_bits, const uint64_t c, const int max_log2_longwords_per_subinventory) {
 		num_words = (num_bits + 63) / 64;
-
-		// Init rank/select structure
-		uint64_t c = 0;
-		for (uint64_t i = 0; i < num_words; i++) c += __builtin_popcountll(~bits[i]);
 		num_zeros = c;
-
-		if (num_bits % 64 != 0) c -= 64 - num_bits % 64;
-		assert(c <= num_bits);
+		exact_spill_size = 0;
 
 		zeros_per_inventory = num_bits == 0 ? 0 : (c * max_zeros_per_inventory + num_bits - 1) / num_bits;
 		// Make zeros_per_inventory into a power of 2
@@ -103,6 +89,27 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelectZero {
 		printf("Number of zeros: %" PRId64 " Number of zeros per inventory item: %d\n", c, zeros_per_inventory);
 		printf("Longwords per subinventory: %d zeros per sub 64: %d sub 16: %d\n", longwords_per_subinventory, zeros_per_sub64, zeros_per_sub16);
 #endif
+	}
+
+  public:
+	SimpleSelectZero() {}
+
+	/** Creates a new instance using a given bit vector.
+	 *
+	 * @param bits a bit vector of 64-bit words.
+	 * @param num_bits the length (in bits) of the bit vector.
+	 * @param max_log2_longwords_per_subinventory the number of words per subinventory:
+	 * a larger value yields a faster map that uses more space; typical values are between 0 and 3.
+	 */
+	SimpleSelectZero(const uint64_t *const bits, const uint64_t num_bits, const int max_log2_longwords_per_subinventory) : bits(bits) {
+		// Init rank/select structure
+		uint64_t c = 0;
+		for (uint64_t i = 0; i < (num_bits + 63) / 64; i++) c += __builtin_popcountll(~bits[i]);
+
+		if (num_bits % 64 != 0) c -= 64 - num_bits % 64;
+		assert(c <= num_bits);
+
+		layout(num_bits, c, max_log2_longwords_per_subinventory);
 
 		inventory.size(inventory_size * longwords_per_inventory + 1);
 		const int64_t *end_of_inventory = &inventory + inventory_size * longwords_per_inventory + 1;
@@ -216,6 +223,8 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelectZero {
 #endif
 	}
 
+	class Builder;
+
 	uint64_t selectZero(const uint64_t rank) {
 #ifdef DEBUG
 		printf("Selecting %" PRId64 "\n...", rank);
@@ -272,4 +281,107 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelectZero {
 	size_t bitCount() const { return inventory.bitCount() - sizeof(inventory) * 8 + exact_spill.bitCount() - sizeof(exact_spill) * 8 + sizeof(*this) * 8; }
 };
 
+/** A streaming builder, computing the inventories incrementally while the bit
+ * vector is read in chunks (say, from disk), so that construction can overlap
+ * the I/O and the bit vector is never scanned a second time.
+ *
+ * Since the inventory layout depends on the density, the number of zeros must
+ * be known in advance (it usually is, from the metadata of the file being
+ * read). The positions of the zeros of the inventory entry under construction
+ * are buffered (at most 64KiB), and the entry is completed as soon as the next
+ * entry opens. Words are fed in order with appendWords(); once all words have
+ * been appended, build() returns the completed structure. The bit vector
+ * itself is not stored by the builder: as with the constructors, the caller
+ * provides in build() the address of the complete vector, which must stay
+ * alive as long as the returned instance is in use.
+ */
+template <util::AllocType AT> class SimpleSelectZero<AT>::Builder {
+	SimpleSelectZero<AT> sel;
+	uint64_t num_bits, word_pos = 0, d = 0, spilled = 0, entry_fill = 0;
+	std::vector<uint64_t> entry_positions;
+
+	/** Completes the inventory entry whose successor has just been written,
+	 * using the buffered positions. */
+	void flushEntry(const uint64_t index) {
+		if (sel.zeros_per_inventory == 1) return;
+		const uint64_t start = sel.inventory[index * sel.longwords_per_inventory];
+		const uint64_t span = sel.inventory[(index + 1) * sel.longwords_per_inventory] - start;
+		int64_t *const p64 = &sel.inventory[index * sel.longwords_per_inventory + 1];
+		uint16_t *const p16 = (uint16_t *)p64;
+		int offset = 0;
+
+		if (span < (1 << 16)) {
+			for (uint64_t k = 0; k < entry_fill; k++)
+				if ((k & sel.zeros_per_sub16_mask) == 0) {
+					assert(offset < sel.longwords_per_subinventory * 4);
+					assert(entry_positions[k] - start <= (1 << 16));
+					p16[offset++] = entry_positions[k] - start;
+				}
+		} else if (sel.zeros_per_sub64 == 1) {
+			for (uint64_t k = 0; k < entry_fill; k++) p64[offset++] = entry_positions[k];
+		} else {
+			sel.inventory[index * sel.longwords_per_inventory] |= 1ULL << 63;
+			p64[0] = spilled;
+			for (uint64_t k = 0; k < entry_fill; k++) sel.exact_spill.pushBack(entry_positions[k]);
+			spilled += entry_fill;
+		}
+	}
+
+  public:
+	/** Creates a builder for a bit vector of a given length and number of zeros.
+	 *
+	 * @param num_bits the length (in bits) of the bit vector.
+	 * @param num_zeros the number of zeros in the (first `num_bits` bits of the) bit vector.
+	 * @param max_log2_longwords_per_subinventory the number of words per subinventory:
+	 * a larger value yields a faster map that uses more space; typical values are between 0 and 3.
+	 */
+	Builder(const uint64_t num_bits, const uint64_t num_zeros, const int max_log2_longwords_per_subinventory = 3) : num_bits(num_bits) {
+		assert(num_zeros <= num_bits);
+		sel.layout(num_bits, num_zeros, max_log2_longwords_per_subinventory);
+		sel.inventory.size(sel.inventory_size * sel.longwords_per_inventory + 1);
+		entry_positions.resize(sel.zeros_per_inventory);
+	}
+
+	/** Appends the next chunk of words of the bit vector.
+	 *
+	 * @param words the next chunk of the bit vector.
+	 * @param n the number of words in the chunk.
+	 */
+	void appendWords(const uint64_t *const words, const size_t n) {
+		assert(word_pos + n <= sel.num_words);
+		for (size_t i = 0; i < n; i++, word_pos++) {
+			uint64_t word = ~words[i];
+			if (word_pos == sel.num_words - 1 && num_bits % 64 != 0) word &= (1ULL << num_bits % 64) - 1;
+			while (word != 0) {
+				const uint64_t p = word_pos * 64 + rho(word);
+				if ((d & sel.zeros_per_inventory_mask) == 0) {
+					const uint64_t index = d >> sel.log2_zeros_per_inventory;
+					sel.inventory[index * sel.longwords_per_inventory] = p;
+					if (index != 0) flushEntry(index - 1);
+					entry_fill = 0;
+				}
+				entry_positions[entry_fill++] = p;
+				d++;
+				word &= word - 1;
+			}
+		}
+	}
+
+	/** Returns the completed structure; all words must have been appended.
+	 *
+	 * @param bits the address of the complete bit vector, which must stay
+	 * alive as long as the returned instance is in use.
+	 */
+	SimpleSelectZero<AT> build(const uint64_t *const bits) {
+		assert(word_pos == sel.num_words);
+		assert(d == sel.num_zeros);
+		sel.inventory[sel.inventory_size * sel.longwords_per_inventory] = num_bits;
+		if (d != 0) flushEntry((d - 1) >> sel.log2_zeros_per_inventory);
+		sel.exact_spill.trimToFit();
+		sel.exact_spill_size = spilled;
+		sel.bits = bits;
+		return std::move(sel);
+	}
+};
+
 } // namespace sux::bits
@@ -29,6 +29,7 @@
 #pragma once
 
 #include "../support/common.hpp"
+#include "../util/SpaceReport.hpp"
 #include "../util/Vector.hpp"
 #include "SelectZero.hpp"
 #include <cstdint>
@@ -227,8 +228,57 @@ template <util::AllocType AT = util::AllocType::MALLOC> class SimpleSelectZeroHa
 		return s;
 	}
 
+	/** Re-binds this structure to a bit vector (e.g., after deserialization).
+	 *
+	 * The bit vector must have the same content as the one this
+	 * structure was built on.
+	 *
+	 * @param bits a bit vector of 64-bit words.
+	 */
+	void setBits(const uint64_t *const bits) { this->bits = bits; }
+
+	/** Maps this structure over a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator and must
+	 * stay alive as long as this instance is in use.
+	 *
+	 * @param p a pointer inside a memory-mapped serialized image.
+	 * @param bits the bit vector this structure refers to.
+	 * @return the pointer advanced past the data of this structure.
+	 */
+	void *map(void *p, const uint64_t *const bits) {
+		uint64_t *q = static_cast<uint64_t *>(p);
+		num_words = *q++;
+		inventory_size = *q++;
+		num_zeros = *q++;
+		this->bits = bits;
+		return inventory.map(q);
+	}
+
+	friend std::ostream &operator<<(std::ostream &os, const SimpleSelectZeroHalf<AT> &ss) {
+		os.write((char *)&ss.num_words, sizeof(uint64_t));
+		os.write((char *)&ss.inventory_size, sizeof(uint64_t));
+		os.write((char *)&ss.num_zeros, sizeof(uint64_t));
+		return os << ss.inventory;
+	}
+
+	/** After deserialization, the structure must be re-bound to its bit vector with setBits(). */
+	friend std::istream &operator>>(std::istream &is, SimpleSelectZeroHalf<AT> &ss) {
+		is.read((char *)&ss.num_words, sizeof(uint64_t));
+		is.read((char *)&ss.inventory_size, sizeof(uint64_t));
+		is.read((char *)&ss.num_zeros, sizeof(uint64_t));
+		return is >> ss.inventory;
+	}
+
 	/** Returns an estimate of the size (in bits) of this structure. */
 	size_t bitCount() const { return inventory.bitCount() - sizeof(inventory) * 8 + sizeof(*this) * 8; };
+
+	/** Returns a structured report of the space used by this structure (excluding the bit vector). */
+	util::SpaceReport spaceReport() const { return {"simple_select_zero_half", sizeof(*this) * 8, AT, {util::spaceReport("inventory", inventory)}}; }
+
+	/** Prefaults the inventory (the bit vector is not owned by this
+	 * structure, and is left to the caller). */
+	void warmup() const { inventory.prefault(); }
 };
 
 } // namespace sux::bits
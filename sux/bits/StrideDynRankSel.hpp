@@ -33,9 +33,14 @@
 #include "Rank.hpp"
 #include "Select.hpp"
 #include "SelectZero.hpp"
+#include <algorithm>
+#include <thread>
+#include <vector>
 
 namespace sux::bits {
 
+template <template <size_t, util::AllocType AT> class SPS, size_t WORDS, util::AllocType AT> class SyncStrideDynRankSel;
+
 /** Ranking and selection in a dynamic bit vector by means
  * of a searchable prefix-sum data structure and linear
  * searches on a sequence of words of given length.
@@ -75,6 +80,61 @@ class StrideDynRankSel : public DynamicBitVector, public Rank, public Select, pu
 
 	uint64_t *bitvector() const { return Vector; }
 
+	/** Writes a versioned snapshot of this structure.
+	 *
+	 * The snapshot contains a header, the bit data and (optionally) the
+	 * prefix sums, each section padded to a 4096-byte boundary: if the
+	 * stream starts at a block boundary, the file can be written and read
+	 * back with `O_DIRECT`.
+	 *
+	 * @param os an output stream.
+	 * @param with_prefix_sums if false, only the bit data is written and
+	 * the prefix sums are rebuilt by load(), trading restore time for a
+	 * smaller checkpoint.
+	 */
+	void dump(std::ostream &os, bool with_prefix_sums = true) const {
+		const std::streamoff start = os.tellp();
+		const uint64_t header[8] = {DUMP_MAGIC, DUMP_VERSION, with_prefix_sums, Size, WORDS, 0, 0, 0};
+		os.write((char *)header, sizeof(header));
+		pad(os, start);
+		os.write((char *)Vector, divRoundup(Size, 64) * sizeof(uint64_t));
+		pad(os, start);
+		if (with_prefix_sums) {
+			os << SrcPrefSum;
+			pad(os, start);
+		}
+	}
+
+	/** Loads a snapshot written by dump().
+	 *
+	 * The bit data is read into the provided vector, which is resized as
+	 * needed (with the additional free word required by rank(size_t)) and
+	 * must stay alive as long as the returned structure is in use. If the
+	 * snapshot was written without prefix sums, they are rebuilt here with
+	 * a linear scan of the bit data.
+	 *
+	 * @param is an input stream positioned at the start of a snapshot.
+	 * @param bitvector the vector that will own the bit data.
+	 */
+	static StrideDynRankSel load(std::istream &is, util::Vector<uint64_t, AT> &bitvector) {
+		const std::streamoff start = is.tellg();
+		uint64_t header[8];
+		is.read((char *)header, sizeof(header));
+		assert(header[0] == DUMP_MAGIC);
+		assert(header[1] == DUMP_VERSION);
+		assert(header[4] == WORDS);
+		const size_t size = header[3];
+		skip(is, start);
+		bitvector.size(size / 64 + 1);
+		is.read((char *)&bitvector, divRoundup(size, 64) * sizeof(uint64_t));
+		skip(is, start);
+		if (!header[2]) return StrideDynRankSel(&bitvector, size);
+		SPS<BOUND, AT> tree;
+		is >> tree;
+		skip(is, start);
+		return StrideDynRankSel(&bitvector, size, std::move(tree));
+	}
+
 	virtual uint64_t rank(size_t pos) {
 		size_t idx = pos / (64 * WORDS);
 		uint64_t value = SrcPrefSum.prefix(idx);
@@ -124,6 +184,50 @@ class StrideDynRankSel : public DynamicBitVector, public Rank, public Select, pu
 		return old;
 	}
 
+	/** Replaces a batch of words of the bit vector.
+	 *
+	 * The indices may appear in any order and may repeat; for repeated
+	 * indices, the last word of the batch wins. The deltas of all words
+	 * falling in the same stride are coalesced into a single update of the
+	 * underlying prefix sums, and the updates are pushed in increasing order
+	 * of stride, so bursts of nearby updates share most of their tree path
+	 * in cache and are much faster than repeated update() calls.
+	 *
+	 * @param indices indices (in words) in the bitvector.
+	 * @param words new values for the corresponding words.
+	 * @param n the number of updates in the batch.
+	 */
+	void update(const size_t *indices, const uint64_t *words, size_t n) {
+		std::vector<size_t> order(n);
+		for (size_t i = 0; i < n; i++) order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [indices](size_t a, size_t b) { return indices[a] < indices[b]; });
+
+		for (size_t i = 0; i < n;) {
+			const size_t stride = indices[order[i]] / WORDS;
+			int64_t delta = 0;
+			do {
+				const size_t idx = indices[order[i]];
+				while (i + 1 < n && indices[order[i + 1]] == idx) i++;
+				const uint64_t word = words[order[i++]];
+				delta += nu(word) - nu(Vector[idx]);
+				Vector[idx] = word;
+			} while (i < n && indices[order[i]] / WORDS == stride);
+			if (delta != 0) SrcPrefSum.add(stride + 1, delta);
+		}
+	}
+
+	/** Rebuilds the prefix sums from the current bit data.
+	 *
+	 * The tree stays correct under mutations, but levels sized for the
+	 * initial content are never reclaimed; after bulk deletions a rebuild
+	 * produces a fresh, tightly allocated tree. The strides are counted and
+	 * the tree is bulk-built in linear time, with the given number of
+	 * threads, and the new tree replaces the old one only when complete.
+	 *
+	 * @param num_threads the number of threads used to count and build.
+	 */
+	void rebuild(size_t num_threads = 1) { SrcPrefSum = buildPrefixSums(num_threads); }
+
 	virtual bool set(size_t index) {
 		uint64_t old = Vector[index / 64];
 		Vector[index / 64] |= uint64_t(1) << (index % 64);
@@ -162,6 +266,23 @@ class StrideDynRankSel : public DynamicBitVector, public Rank, public Select, pu
 	virtual size_t bitCount() const { return SrcPrefSum.bitCount() - sizeof(SrcPrefSum) * 8 + sizeof(*this) * 8 + ((Size + 63) & ~63); }
 
   private:
+	static constexpr uint64_t DUMP_MAGIC = UINT64_C(0x524e594420585553); // "SUX DYNR"
+	static constexpr uint64_t DUMP_VERSION = 1;
+	static constexpr size_t DUMP_BLOCK = 4096;
+
+	StrideDynRankSel(uint64_t bitvector[], size_t size, SPS<BOUND, AT> &&tree) : Vector(bitvector), Size(size), SrcPrefSum(std::move(tree)) {}
+
+	static void pad(std::ostream &os, std::streamoff start) {
+		static const char zeroes[DUMP_BLOCK] = {};
+		const size_t residual = size_t((os.tellp() - start) % DUMP_BLOCK);
+		if (residual != 0) os.write(zeroes, DUMP_BLOCK - residual);
+	}
+
+	static void skip(std::istream &is, std::streamoff start) {
+		const size_t residual = size_t((is.tellg() - start) % DUMP_BLOCK);
+		if (residual != 0) is.seekg(DUMP_BLOCK - residual, std::ios_base::cur);
+	}
+
 	static size_t divRoundup(size_t x, size_t y) {
 		if (y > x) return 1;
 		return (x / y) + ((x % y != 0) ? 1 : 0);
@@ -173,6 +294,34 @@ class StrideDynRankSel : public DynamicBitVector, public Rank, public Select, pu
 		return SPS<BOUND, AT>(sequence.get(), divRoundup(size, WORDS));
 	}
 
+	/** Counts the strides and bulk-builds a fresh tree, leaving this structure untouched. */
+	SPS<BOUND, AT> buildPrefixSums(size_t num_threads) const {
+		const size_t num_words = divRoundup(Size, 64);
+		const size_t buckets = divRoundup(num_words, WORDS);
+		unique_ptr<uint64_t[]> sequence = make_unique<uint64_t[]>(buckets);
+
+		if (num_threads > 1 && buckets >= num_threads) {
+			const size_t per_thread = (buckets + num_threads - 1) / num_threads;
+			std::vector<std::thread> threads;
+			for (size_t k = 0; k < num_threads; k++)
+				threads.emplace_back([&, k]() {
+					for (size_t b = k * per_thread; b < std::min((k + 1) * per_thread, buckets); b++)
+						for (size_t i = b * WORDS; i < std::min((b + 1) * WORDS, num_words); i++) sequence[b] += nu(Vector[i]);
+				});
+			for (auto &t : threads) t.join();
+		} else
+			for (size_t i = 0; i < num_words; i++) sequence[i / WORDS] += nu(Vector[i]);
+
+		return bulkBuild<SPS<BOUND, AT>>(sequence.get(), buckets, num_threads, 0);
+	}
+
+	// Not every SearchablePrefixSums implementation parallelizes its bulk
+	// build; fall back to the serial form when there is no threaded overload.
+	template <class S> static auto bulkBuild(const uint64_t sequence[], size_t size, size_t num_threads, int) -> decltype(S::bulkBuild(sequence, size, num_threads)) { return S::bulkBuild(sequence, size, num_threads); }
+	template <class S> static S bulkBuild(const uint64_t sequence[], size_t size, size_t, long) { return S::bulkBuild(sequence, size); }
+
+	friend class SyncStrideDynRankSel<SPS, WORDS, AT>;
+
 	friend std::ostream &operator<<(std::ostream &os, const StrideDynRankSel<SPS, WORDS, AT> &bv) {
 		os.write((char *)&bv.Size, sizeof(uint64_t));
 		return os << bv.SrcPrefSum << bv.Vector;
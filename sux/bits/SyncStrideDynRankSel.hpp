@@ -0,0 +1,179 @@
+/*
+ * Sux: Succinct data structures
+ *
+ * Copyright (C) 2019-2020 Stefano Marchini
+ *
+ *  This library is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as published by the Free
+ *  Software Foundation; either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * Under Section 7 of GPL version 3, you are granted additional permissions
+ * described in the GCC Runtime Library Exception, version 3.1, as published by
+ * the Free Software Foundation.
+ *
+ * You should have received a copy of the GNU General Public License and a copy of
+ * the GCC Runtime Library Exception along with this program; see the files
+ * COPYING3 and COPYING.RUNTIME respectively.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "StrideDynRankSel.hpp"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace sux::bits {
+
+/** A thread-safe wrapper around StrideDynRankSel allowing parallel
+ * readers with concurrent writers.
+ *
+ * The wrapper is a seqlock: readers run lock-free and validate a version
+ * counter after each query, retrying in the rare case a writer was active
+ * in the meantime, so read throughput scales linearly with the number of
+ * threads. Writers are serialized by a mutex; since a mutation touches one
+ * stride plus a short prefix-sum path, the writer critical section is a
+ * few hundred nanoseconds. Striping the writer lock would not help:
+ * every mutation updates the shared upper levels of the prefix-sum tree,
+ * so two writers conflict no matter how far apart their strides are.
+ *
+ * Readers may observe the bit vector mid-update, but the version check
+ * discards any result computed from such a state.
+ *
+ * @tparam SPS underlying sux::util::SearchablePrefixSums implementation.
+ * @tparam WORDS length (in words) of the linear search stride.
+ * @tparam AT a type of memory allocation for the underlying structure.
+ */
+template <template <size_t, util::AllocType AT> class SPS, size_t WORDS, util::AllocType AT = util::AllocType::MALLOC> class SyncStrideDynRankSel {
+  private:
+	StrideDynRankSel<SPS, WORDS, AT> inner;
+	/** The tree replaced by the last rebuild(), kept alive as a grace
+	 * period for readers that were in flight when it was swapped out. */
+	SPS<64 * WORDS, AT> retired;
+	mutable std::atomic<uint64_t> version{0};
+	std::mutex writer;
+
+	template <typename F> auto read(F query) const {
+		for (;;) {
+			const uint64_t v = version.load(std::memory_order_acquire);
+			if (v & 1) {
+#if defined(__x86_64__) && defined(__GNUC__)
+				__builtin_ia32_pause();
+#else
+				std::this_thread::yield();
+#endif
+				continue;
+			}
+			const auto result = query();
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (version.load(std::memory_order_relaxed) == v) return result;
+		}
+	}
+
+	template <typename F> auto write(F mutation) {
+		std::lock_guard<std::mutex> lock(writer);
+		version.fetch_add(1, std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_release);
+		const auto result = mutation();
+		version.fetch_add(1, std::memory_order_release);
+		return result;
+	}
+
+  public:
+	/** Creates a new instance using a given bit vector.
+	 *
+	 * This constructor only stores a reference
+	 * to the provided bit vector. The content of the bit vector
+	 * should be changed only through the mutation methods of
+	 * this class, or the results will be unpredictable.
+	 *
+	 * **Warning**: if you plan an calling rank(size_t) with
+	 * argument size(), you must have at least one additional
+	 * free bit at the end of the provided bit vector.
+	 *
+	 * @param bitvector a bit vector of 64-bit words.
+	 * @param size the length (in bits) of the bit vector.
+	 */
+	SyncStrideDynRankSel(uint64_t bitvector[], size_t size) : inner(bitvector, size) {}
+
+	uint64_t *bitvector() const { return inner.bitvector(); }
+
+	uint64_t rank(size_t pos) const {
+		return read([&] { return const_cast<StrideDynRankSel<SPS, WORDS, AT> &>(inner).rank(pos); });
+	}
+
+	uint64_t rankZero(size_t pos) const { return pos - rank(pos); }
+
+	size_t select(uint64_t rank) const {
+		return read([&] { return const_cast<StrideDynRankSel<SPS, WORDS, AT> &>(inner).select(rank); });
+	}
+
+	size_t selectZero(uint64_t rank) const {
+		return read([&] { return const_cast<StrideDynRankSel<SPS, WORDS, AT> &>(inner).selectZero(rank); });
+	}
+
+	uint64_t update(size_t index, uint64_t word) {
+		return write([&] { return inner.update(index, word); });
+	}
+
+	/** Replaces a batch of words of the bit vector under a single writer
+	 * critical section; see StrideDynRankSel::update(const size_t *, const uint64_t *, size_t). */
+	void update(const size_t *indices, const uint64_t *words, size_t n) {
+		write([&] {
+			inner.update(indices, words, n);
+			return 0;
+		});
+	}
+
+	/** Rebuilds the prefix sums from the current bit data while readers
+	 * continue against the old tree; see StrideDynRankSel::rebuild().
+	 *
+	 * The writer mutex excludes mutations for the whole duration, so the
+	 * live bit data can be counted safely, but the seqlock is held only for
+	 * the final swap: readers keep querying the old tree until the new one
+	 * is complete.
+	 *
+	 * @param num_threads the number of threads used to count and build.
+	 */
+	void rebuild(size_t num_threads = 1) {
+		std::lock_guard<std::mutex> lock(writer);
+		auto tree = inner.buildPrefixSums(num_threads);
+		version.fetch_add(1, std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_release);
+		std::swap(inner.SrcPrefSum, tree);
+		version.fetch_add(1, std::memory_order_release);
+		// A reader in flight during the swap may still hold pointers into the
+		// old tree, so we retire it until the next rebuild instead of freeing
+		// it; the version check makes the reader discard its result and retry.
+		std::swap(retired, tree);
+	}
+
+	bool set(size_t index) {
+		return write([&] { return inner.set(index); });
+	}
+
+	bool clear(size_t index) {
+		return write([&] { return inner.clear(index); });
+	}
+
+	bool toggle(size_t index) {
+		return write([&] { return inner.toggle(index); });
+	}
+
+	size_t size() const { return inner.size(); }
+
+	size_t bitCount() const { return inner.bitCount() - sizeof(inner) * 8 + sizeof(*this) * 8; }
+};
+
+} // namespace sux::bits
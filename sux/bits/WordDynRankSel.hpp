@@ -33,6 +33,9 @@
 #include "Rank.hpp"
 #include "Select.hpp"
 #include "SelectZero.hpp"
+#include <algorithm>
+#include <thread>
+#include <vector>
 
 namespace sux::bits {
 
@@ -79,6 +82,61 @@ template <template <size_t, util::AllocType AT> class SPS, util::AllocType AT =
 
 	uint64_t *bitvector() const { return Vector; }
 
+	/** Writes a versioned snapshot of this structure.
+	 *
+	 * The snapshot contains a header, the bit data and (optionally) the
+	 * prefix sums, each section padded to a 4096-byte boundary: if the
+	 * stream starts at a block boundary, the file can be written and read
+	 * back with `O_DIRECT`.
+	 *
+	 * @param os an output stream.
+	 * @param with_prefix_sums if false, only the bit data is written and
+	 * the prefix sums are rebuilt by load(), trading restore time for a
+	 * smaller checkpoint.
+	 */
+	void dump(std::ostream &os, bool with_prefix_sums = true) const {
+		const std::streamoff start = os.tellp();
+		const uint64_t header[8] = {DUMP_MAGIC, DUMP_VERSION, with_prefix_sums, Size, 1, 0, 0, 0};
+		os.write((char *)header, sizeof(header));
+		pad(os, start);
+		os.write((char *)Vector, divRoundup(Size, BOUND) * sizeof(uint64_t));
+		pad(os, start);
+		if (with_prefix_sums) {
+			os << SrcPrefSum;
+			pad(os, start);
+		}
+	}
+
+	/** Loads a snapshot written by dump().
+	 *
+	 * The bit data is read into the provided vector, which is resized as
+	 * needed (with the additional free word required by rank(size_t)) and
+	 * must stay alive as long as the returned structure is in use. If the
+	 * snapshot was written without prefix sums, they are rebuilt here with
+	 * a linear scan of the bit data.
+	 *
+	 * @param is an input stream positioned at the start of a snapshot.
+	 * @param bitvector the vector that will own the bit data.
+	 */
+	static WordDynRankSel load(std::istream &is, util::Vector<uint64_t, AT> &bitvector) {
+		const std::streamoff start = is.tellg();
+		uint64_t header[8];
+		is.read((char *)header, sizeof(header));
+		assert(header[0] == DUMP_MAGIC);
+		assert(header[1] == DUMP_VERSION);
+		assert(header[4] == 1);
+		const size_t size = header[3];
+		skip(is, start);
+		bitvector.size(size / 64 + 1);
+		is.read((char *)&bitvector, divRoundup(size, BOUND) * sizeof(uint64_t));
+		skip(is, start);
+		if (!header[2]) return WordDynRankSel(&bitvector, size);
+		SPS<BOUND, AT> tree;
+		is >> tree;
+		skip(is, start);
+		return WordDynRankSel(&bitvector, size, std::move(tree));
+	}
+
 	using Rank::rank;
 	using Rank::rankZero;
 	virtual uint64_t rank(size_t pos) { return SrcPrefSum.prefix(pos / 64) + nu(Vector[pos / 64] & ((1ULL << (pos % 64)) - 1)); }
@@ -108,6 +166,61 @@ template <template <size_t, util::AllocType AT> class SPS, util::AllocType AT =
 		return old;
 	}
 
+	/** Replaces a batch of words of the bit vector.
+	 *
+	 * The indices may appear in any order and may repeat; for repeated
+	 * indices, the last word of the batch wins. The deltas are pushed to the
+	 * underlying prefix sums in increasing order of index, one update per
+	 * distinct touched word, so bursts of nearby updates share most of their
+	 * tree path in cache and are much faster than repeated update() calls.
+	 *
+	 * @param indices indices (in words) in the bitvector.
+	 * @param words new values for the corresponding words.
+	 * @param n the number of updates in the batch.
+	 */
+	void update(const size_t *indices, const uint64_t *words, size_t n) {
+		std::vector<size_t> order(n);
+		for (size_t i = 0; i < n; i++) order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [indices](size_t a, size_t b) { return indices[a] < indices[b]; });
+
+		for (size_t i = 0; i < n;) {
+			const size_t idx = indices[order[i]];
+			while (i + 1 < n && indices[order[i + 1]] == idx) i++;
+			const uint64_t word = words[order[i++]];
+			const int64_t delta = nu(word) - nu(Vector[idx]);
+			Vector[idx] = word;
+			if (delta != 0) SrcPrefSum.add(idx + 1, delta);
+		}
+	}
+
+	/** Rebuilds the prefix sums from the current bit data.
+	 *
+	 * The tree stays correct under mutations, but levels sized for the
+	 * initial content are never reclaimed; after bulk deletions a rebuild
+	 * produces a fresh, tightly allocated tree. The words are counted and
+	 * the tree is bulk-built in linear time, with the given number of
+	 * threads, and the new tree replaces the old one only when complete.
+	 *
+	 * @param num_threads the number of threads used to count and build.
+	 */
+	void rebuild(size_t num_threads = 1) {
+		const size_t num_words = divRoundup(Size, BOUND);
+		unique_ptr<uint64_t[]> sequence = make_unique<uint64_t[]>(num_words);
+
+		if (num_threads > 1 && num_words >= num_threads) {
+			const size_t per_thread = (num_words + num_threads - 1) / num_threads;
+			std::vector<std::thread> threads;
+			for (size_t k = 0; k < num_threads; k++)
+				threads.emplace_back([&, k]() {
+					for (size_t i = k * per_thread; i < std::min((k + 1) * per_thread, num_words); i++) sequence[i] = nu(Vector[i]);
+				});
+			for (auto &t : threads) t.join();
+		} else
+			for (size_t i = 0; i < num_words; i++) sequence[i] = nu(Vector[i]);
+
+		SrcPrefSum = bulkBuild<SPS<BOUND, AT>>(sequence.get(), num_words, num_threads, 0);
+	}
+
 	virtual bool set(size_t index) {
 		uint64_t old = Vector[index / 64];
 		Vector[index / 64] |= uint64_t(1) << (index % 64);
@@ -146,8 +259,30 @@ template <template <size_t, util::AllocType AT> class SPS, util::AllocType AT =
 	virtual size_t bitCount() const { return SrcPrefSum.bitCount() - sizeof(SrcPrefSum) * 8 + sizeof(*this) * 8 + ((Size + 63) & ~63); }
 
   private:
+	static constexpr uint64_t DUMP_MAGIC = UINT64_C(0x524e594420585553); // "SUX DYNR"
+	static constexpr uint64_t DUMP_VERSION = 1;
+	static constexpr size_t DUMP_BLOCK = 4096;
+
+	WordDynRankSel(uint64_t bitvector[], size_t size, SPS<BOUND, AT> &&tree) : Vector(bitvector), Size(size), SrcPrefSum(std::move(tree)) {}
+
+	static void pad(std::ostream &os, std::streamoff start) {
+		static const char zeroes[DUMP_BLOCK] = {};
+		const size_t residual = size_t((os.tellp() - start) % DUMP_BLOCK);
+		if (residual != 0) os.write(zeroes, DUMP_BLOCK - residual);
+	}
+
+	static void skip(std::istream &is, std::streamoff start) {
+		const size_t residual = size_t((is.tellg() - start) % DUMP_BLOCK);
+		if (residual != 0) is.seekg(DUMP_BLOCK - residual, std::ios_base::cur);
+	}
+
 	static size_t divRoundup(size_t x, size_t y) { return (x + y - 1) / y; }
 
+	// Not every SearchablePrefixSums implementation parallelizes its bulk
+	// build; fall back to the serial form when there is no threaded overload.
+	template <class S> static auto bulkBuild(const uint64_t sequence[], size_t size, size_t num_threads, int) -> decltype(S::bulkBuild(sequence, size, num_threads)) { return S::bulkBuild(sequence, size, num_threads); }
+	template <class S> static S bulkBuild(const uint64_t sequence[], size_t size, size_t, long) { return S::bulkBuild(sequence, size); }
+
 	SPS<BOUND, AT> buildSrcPrefSum(const uint64_t bitvector[], size_t size) {
 		unique_ptr<uint64_t[]> sequence = make_unique<uint64_t[]>(size);
 		for (size_t i = 0; i < size; i++) sequence[i] = nu(bitvector[i]);
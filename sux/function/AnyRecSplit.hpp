@@ -0,0 +1,213 @@
+/*
+ * Sux: Succinct data structures
+ *
+ * Copyright (C) 2019-2020 Emmanuel Esposito and Sebastiano Vigna
+ *
+ *  This library is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as published by the Free
+ *  Software Foundation; either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * Under Section 7 of GPL version 3, you are granted additional permissions
+ * described in the GCC Runtime Library Exception, version 3.1, as published by
+ * the Free Software Foundation.
+ *
+ * You should have received a copy of the GNU General Public License and a copy of
+ * the GCC Runtime Library Exception along with this program; see the files
+ * COPYING3 and COPYING.RUNTIME respectively.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "RecSplit.hpp"
+#include <memory>
+
+namespace sux::function {
+
+/** A type-erased RecSplit wrapper choosing the leaf size at runtime.
+ *
+ * The leaf size of RecSplit is a template parameter, since the
+ * Golomb–Rice tables are computed at compile time, so a binary
+ * hard-codes one space/speed tradeoff and cannot load dumps written
+ * with a different one. This wrapper pre-instantiates every leaf size
+ * in [MIN_LEAF..MAX_LEAF], reads the leaf size from the dump header
+ * when loading or mapping, and forwards to the right instantiation;
+ * one deployment can thus serve dumps built with any leaf size in the
+ * range. Queries go through a single virtual call, and the batch
+ * overload pays it once per batch.
+ *
+ * Note that each pre-instantiated leaf size adds its Golomb–Rice table
+ * (a few hundred kilobytes of read-only data) to the binary, which is
+ * why the range is a template parameter.
+ *
+ * @tparam MIN_LEAF the smallest instantiated leaf size.
+ * @tparam MAX_LEAF the largest instantiated leaf size.
+ * @tparam AT a type of memory allocation out of sux::util::AllocType.
+ * @tparam Hasher the key hashing policy, as in RecSplit.
+ */
+
+template <size_t MIN_LEAF = 4, size_t MAX_LEAF = 16, util::AllocType AT = util::AllocType::MALLOC, typename Hasher = SpookyHasher> class AnyRecSplit {
+	static_assert(MIN_LEAF >= 2 && MIN_LEAF <= MAX_LEAF && MAX_LEAF <= MAX_LEAF_SIZE, "Invalid leaf size range");
+
+	/** The type-erased interface of one RecSplit instantiation. */
+	class Erased {
+	  public:
+		virtual ~Erased() {}
+		virtual void build(const vector<string> &keys, const size_t bucket_size, const size_t num_threads) = 0;
+		virtual void build(vector<hash128_t> &keys, const size_t bucket_size, const size_t num_threads) = 0;
+		virtual size_t query(const hash128_t &hash) = 0;
+		virtual size_t query(const string &key) = 0;
+		virtual void query(const hash128_t *hashes, const size_t n, uint64_t *out) = 0;
+		virtual size_t size() = 0;
+		virtual util::SpaceReport spaceReport() const = 0;
+		virtual void warmup() const = 0;
+		virtual void load(istream &is) = 0;
+		virtual void dump(ostream &os) const = 0;
+		virtual void map(const char *filename) = 0;
+	};
+
+	template <size_t LEAF_SIZE> class Typed : public Erased {
+		RecSplit<LEAF_SIZE, AT, Hasher> rs;
+
+	  public:
+		virtual void build(const vector<string> &keys, const size_t bucket_size, const size_t num_threads) { rs = RecSplit<LEAF_SIZE, AT, Hasher>(keys, bucket_size, num_threads); }
+		virtual void build(vector<hash128_t> &keys, const size_t bucket_size, const size_t num_threads) { rs = RecSplit<LEAF_SIZE, AT, Hasher>(keys, bucket_size, num_threads); }
+		virtual size_t query(const hash128_t &hash) { return rs(hash); }
+		virtual size_t query(const string &key) { return rs(key); }
+		virtual void query(const hash128_t *hashes, const size_t n, uint64_t *out) { rs(hashes, n, out); }
+		virtual size_t size() { return rs.size(); }
+		virtual util::SpaceReport spaceReport() const { return rs.spaceReport(); }
+		virtual void warmup() const { rs.warmup(); }
+		virtual void load(istream &is) { is >> rs; }
+		virtual void dump(ostream &os) const { os << rs; }
+		virtual void map(const char *filename) { rs.map(filename); }
+	};
+
+	unique_ptr<Erased> erased;
+	size_t leaf_size = 0;
+
+	/** Returns the instantiation for a given leaf size, walking the instantiated range at compile time. */
+	template <size_t LEAF_SIZE = MIN_LEAF> static unique_ptr<Erased> make(const size_t leaf_size) {
+		if constexpr (LEAF_SIZE <= MAX_LEAF) {
+			if (leaf_size == LEAF_SIZE) return unique_ptr<Erased>(new Typed<LEAF_SIZE>());
+			return make<LEAF_SIZE + 1>(leaf_size);
+		}
+		fprintf(stderr, "Leaf size %d outside the instantiated range %d-%d\n", int(leaf_size), int(MIN_LEAF), int(MAX_LEAF));
+		abort();
+		return nullptr;
+	}
+
+	friend ostream &operator<<(ostream &os, const AnyRecSplit<MIN_LEAF, MAX_LEAF, AT, Hasher> &rs) {
+		rs.erased->dump(os);
+		return os;
+	}
+
+	friend istream &operator>>(istream &is, AnyRecSplit<MIN_LEAF, MAX_LEAF, AT, Hasher> &rs) {
+		// The dump header starts with the leaf size; peek it to pick the instantiation.
+		size_t leaf_size;
+		is.read((char *)&leaf_size, sizeof(leaf_size));
+		is.seekg(-streamoff(sizeof(leaf_size)), ios::cur);
+		rs.leaf_size = leaf_size;
+		rs.erased = make(leaf_size);
+		rs.erased->load(is);
+		return is;
+	}
+
+  public:
+	AnyRecSplit() {}
+
+	/** Builds an AnyRecSplit instance using a given list of keys, bucket size and leaf size.
+	 *
+	 * **Warning**: duplicate keys will cause this method to never return.
+	 *
+	 * @param keys a vector of strings.
+	 * @param bucket_size the desired bucket size, as in RecSplit.
+	 * @param leaf_size the desired leaf size, in [MIN_LEAF..MAX_LEAF].
+	 * @param num_threads the number of parallel construction threads.
+	 */
+	AnyRecSplit(const vector<string> &keys, const size_t bucket_size, const size_t leaf_size, const size_t num_threads = 1) : erased(make(leaf_size)), leaf_size(leaf_size) {
+		erased->build(keys, bucket_size, num_threads);
+	}
+
+	/** Builds an AnyRecSplit instance using a given list of 128-bit hashes, bucket size and leaf size.
+	 *
+	 * **Warning**: duplicate keys will cause this method to never return.
+	 *
+	 * @param keys a vector of 128-bit hashes.
+	 * @param bucket_size the desired bucket size, as in RecSplit.
+	 * @param leaf_size the desired leaf size, in [MIN_LEAF..MAX_LEAF].
+	 * @param num_threads the number of parallel construction threads.
+	 */
+	AnyRecSplit(vector<hash128_t> &keys, const size_t bucket_size, const size_t leaf_size, const size_t num_threads = 1) : erased(make(leaf_size)), leaf_size(leaf_size) {
+		erased->build(keys, bucket_size, num_threads);
+	}
+
+	/** Maps this instance over a serialized image, with no copy, choosing
+	 * the instantiation matching the leaf size in the image header.
+	 *
+	 * @param filename the name of a file containing a serialized RecSplit instance.
+	 */
+	void map(const char *filename) {
+		const int fd = open(filename, O_RDONLY);
+		if (fd == -1) {
+			fprintf(stderr, "Cannot open %s\n", filename);
+			abort();
+		}
+		size_t ls;
+		if (read(fd, &ls, sizeof(ls)) != sizeof(ls)) {
+			fprintf(stderr, "Cannot read %s\n", filename);
+			abort();
+		}
+		close(fd);
+		leaf_size = ls;
+		erased = make(ls);
+		erased->map(filename);
+	}
+
+	/** Returns the leaf size of the wrapped instance (zero if empty). */
+	size_t leafSize() const { return leaf_size; }
+
+	/** Returns the value associated with the given 128-bit hash.
+	 *
+	 * Note that this method is mainly useful for benchmarking.
+	 * @param hash a 128-bit hash.
+	 * @return the associated value.
+	 */
+	size_t operator()(const hash128_t &hash) { return erased->query(hash); }
+
+	/** Returns the value associated with the given key.
+	 *
+	 * @param key a key.
+	 * @return the associated value.
+	 */
+	size_t operator()(const string &key) { return erased->query(key); }
+
+	/** Returns the values associated with a batch of 128-bit hashes,
+	 * paying the dispatch once for the whole batch.
+	 *
+	 * @param hashes an array of 128-bit hashes.
+	 * @param n the number of hashes.
+	 * @param out an array of `n` elements receiving the associated values.
+	 */
+	void operator()(const hash128_t *hashes, const size_t n, uint64_t *out) { erased->query(hashes, n, out); }
+
+	/** Returns the number of keys used to build this instance. */
+	inline size_t size() { return erased->size(); }
+
+	/** Returns a structured report of the space used by this structure. */
+	util::SpaceReport spaceReport() const { return erased->spaceReport(); }
+
+	/** Prefaults the wrapped instance (see RecSplit::warmup()). */
+	void warmup() const { erased->warmup(); }
+};
+
+} // namespace sux::function
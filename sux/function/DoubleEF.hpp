@@ -29,6 +29,7 @@
 #pragma once
 
 #include "../support/common.hpp"
+#include "../util/SpaceReport.hpp"
 #include "../util/Vector.hpp"
 #include <cstdint>
 #include <cstring>
@@ -90,6 +91,79 @@ template <util::AllocType AT = util::AllocType::MALLOC> class DoubleEF {
 		return size;
 	}
 
+	/** Computes the parameters and sizes the bit arrays; num_buckets,
+	 * bits_per_key_fixed_point, cum_keys_min_delta and min_diff must have
+	 * been set already. */
+	void layout(const uint64_t cum_keys_total, const uint64_t position_total) {
+		u_position = int64_t(position_total) - int64_t(bits_per_key_fixed_point * cum_keys_total >> 20) - int64_t(num_buckets * min_diff) + 1;
+		l_position = u_position / (num_buckets + 1) == 0 ? 0 : lambda(u_position / (num_buckets + 1));
+		u_cum_keys = cum_keys_total - num_buckets * cum_keys_min_delta + 1;
+		l_cum_keys = u_cum_keys / (num_buckets + 1) == 0 ? 0 : lambda(u_cum_keys / (num_buckets + 1));
+		assert(l_cum_keys * 2 + l_position <= 56); // To be able to perform a single unaligned read
+
+#ifdef MORESTATS
+		printf("Elias-Fano l (cumulative): %d\n", l_cum_keys);
+		printf("Elias-Fano l (positions): %d\n", l_position);
+		printf("Elias-Fano u (cumulative): %lld\n", u_cum_keys);
+		printf("Elias-Fano u (positions): %lld\n", u_position);
+#endif
+
+		lower_bits_mask_cum_keys = (UINT64_C(1) << l_cum_keys) - 1;
+		lower_bits_mask_position = (UINT64_C(1) << l_position) - 1;
+
+		lower_bits.size(lower_bits_size_words());
+		upper_bits_cum_keys.size(cum_keys_size_words());
+		upper_bits_position.size(position_size_words());
+	}
+
+	/** Encodes the pair of values of a bucket; must be called once per
+	 * bucket, in order, after layout(). */
+	void encode(const uint64_t i, const uint64_t cum_keys_i, const uint64_t position_i) {
+		const uint64_t cum_delta = i * uint64_t(cum_keys_min_delta);
+		const int64_t bit_delta = int64_t(i) * min_diff;
+
+		if (l_cum_keys != 0) set_bits(lower_bits, i * (l_cum_keys + l_position), l_cum_keys, (cum_keys_i - cum_delta) & lower_bits_mask_cum_keys);
+		set(upper_bits_cum_keys, ((cum_keys_i - cum_delta) >> l_cum_keys) + i);
+
+		const auto pval = int64_t(position_i) - int64_t(bits_per_key_fixed_point * cum_keys_i >> 20);
+		if (l_position != 0) set_bits(lower_bits, i * (l_cum_keys + l_position) + l_cum_keys, l_position, (pval - bit_delta) & lower_bits_mask_position);
+		set(upper_bits_position, ((pval - bit_delta) >> l_position) + i);
+	}
+
+	/** Builds the jump tables over the completed upper-bits arrays. */
+	void build_jump() {
+		jump.size(jump_size_words());
+		const uint64_t words_cum_keys = cum_keys_size_words(), words_position = position_size_words();
+
+		for (uint64_t i = 0, c = 0, last_super_q = 0; i < words_cum_keys; i++) {
+			for (int b = 0; b < 64; b++) {
+				if (upper_bits_cum_keys[i] & UINT64_C(1) << b) {
+					if ((c & super_q_mask) == 0) jump[(c / super_q) * (super_q_size * 2)] = last_super_q = i * 64 + b;
+					if ((c & q_mask) == 0) {
+						const uint64_t offset = i * 64 + b - last_super_q;
+						if (offset >= (1 << 16)) abort();
+						((uint16_t *)(&jump + (c / super_q) * (super_q_size * 2) + 2))[2 * ((c % super_q) / q)] = offset;
+					}
+					c++;
+				}
+			}
+		}
+
+		for (uint64_t i = 0, c = 0, last_super_q = 0; i < words_position; i++) {
+			for (int b = 0; b < 64; b++) {
+				if (upper_bits_position[i] & UINT64_C(1) << b) {
+					if ((c & super_q_mask) == 0) jump[(c / super_q) * (super_q_size * 2) + 1] = last_super_q = i * 64 + b;
+					if ((c & q_mask) == 0) {
+						const uint64_t offset = i * 64 + b - last_super_q;
+						if (offset >= (1 << 16)) abort();
+						((uint16_t *)(&jump + (c / super_q) * (super_q_size * 2) + 2))[2 * ((c % super_q) / q) + 1] = offset;
+					}
+					c++;
+				}
+			}
+		}
+	}
+
 	friend std::ostream &operator<<(std::ostream &os, const DoubleEF<AT> &ef) {
 		os.write((char *)&ef.num_buckets, sizeof(ef.num_buckets));
 		os.write((char *)&ef.u_cum_keys, sizeof(ef.u_cum_keys));
@@ -147,68 +221,9 @@ template <util::AllocType AT = util::AllocType::MALLOC> class DoubleEF {
 			prev_bucket_bits = bucket_bits;
 		}
 
-		u_position = int64_t(position[num_buckets]) - int64_t(bits_per_key_fixed_point * cum_keys[num_buckets] >> 20) - int64_t(num_buckets * min_diff) + 1;
-		l_position = u_position / (num_buckets + 1) == 0 ? 0 : lambda(u_position / (num_buckets + 1));
-		u_cum_keys = cum_keys[num_buckets] - num_buckets * cum_keys_min_delta + 1;
-		l_cum_keys = u_cum_keys / (num_buckets + 1) == 0 ? 0 : lambda(u_cum_keys / (num_buckets + 1));
-		assert(l_cum_keys * 2 + l_position <= 56); // To be able to perform a single unaligned read
-
-#ifdef MORESTATS
-		printf("Elias-Fano l (cumulative): %d\n", l_cum_keys);
-		printf("Elias-Fano l (positions): %d\n", l_position);
-		printf("Elias-Fano u (cumulative): %lld\n", u_cum_keys);
-		printf("Elias-Fano u (positions): %lld\n", u_position);
-#endif
-
-		lower_bits_mask_cum_keys = (UINT64_C(1) << l_cum_keys) - 1;
-		lower_bits_mask_position = (UINT64_C(1) << l_position) - 1;
-
-		const uint64_t words_lower_bits = lower_bits_size_words();
-		lower_bits.size(words_lower_bits);
-		const uint64_t words_cum_keys = cum_keys_size_words();
-		upper_bits_cum_keys.size(words_cum_keys);
-		const uint64_t words_position = position_size_words();
-		upper_bits_position.size(words_position);
-
-		for (uint64_t i = 0, cum_delta = 0, bit_delta = 0; i <= num_buckets; i++, cum_delta += cum_keys_min_delta, bit_delta += min_diff) {
-			if (l_cum_keys != 0) set_bits(lower_bits, i * (l_cum_keys + l_position), l_cum_keys, (cum_keys[i] - cum_delta) & lower_bits_mask_cum_keys);
-			set(upper_bits_cum_keys, ((cum_keys[i] - cum_delta) >> l_cum_keys) + i);
-
-			const auto pval = int64_t(position[i]) - int64_t(bits_per_key_fixed_point * cum_keys[i] >> 20);
-			if (l_position != 0) set_bits(lower_bits, i * (l_cum_keys + l_position) + l_cum_keys, l_position, (pval - bit_delta) & lower_bits_mask_position);
-			set(upper_bits_position, ((pval - bit_delta) >> l_position) + i);
-		}
-
-		const uint64_t jump_words = jump_size_words();
-		jump.size(jump_words);
-
-		for (uint64_t i = 0, c = 0, last_super_q = 0; i < words_cum_keys; i++) {
-			for (int b = 0; b < 64; b++) {
-				if (upper_bits_cum_keys[i] & UINT64_C(1) << b) {
-					if ((c & super_q_mask) == 0) jump[(c / super_q) * (super_q_size * 2)] = last_super_q = i * 64 + b;
-					if ((c & q_mask) == 0) {
-						const uint64_t offset = i * 64 + b - last_super_q;
-						if (offset >= (1 << 16)) abort();
-						((uint16_t *)(&jump + (c / super_q) * (super_q_size * 2) + 2))[2 * ((c % super_q) / q)] = offset;
-					}
-					c++;
-				}
-			}
-		}
-
-		for (uint64_t i = 0, c = 0, last_super_q = 0; i < words_position; i++) {
-			for (int b = 0; b < 64; b++) {
-				if (upper_bits_position[i] & UINT64_C(1) << b) {
-					if ((c & super_q_mask) == 0) jump[(c / super_q) * (super_q_size * 2) + 1] = last_super_q = i * 64 + b;
-					if ((c & q_mask) == 0) {
-						const uint64_t offset = i * 64 + b - last_super_q;
-						if (offset >= (1 << 16)) abort();
-						((uint16_t *)(&jump + (c / super_q) * (super_q_size * 2) + 2))[2 * ((c % super_q) / q) + 1] = offset;
-					}
-					c++;
-				}
-			}
-		}
+		layout(cum_keys[num_buckets], position[num_buckets]);
+		for (uint64_t i = 0; i <= num_buckets; i++) encode(i, cum_keys[i], position[i]);
+		build_jump();
 
 #ifndef NDEBUG
 		for (uint64_t i = 0; i < num_buckets; i++) {
@@ -226,6 +241,113 @@ template <util::AllocType AT = util::AllocType::MALLOC> class DoubleEF {
 #endif
 	}
 
+	/** A streaming builder for DoubleEF.
+	 *
+	 * The Elias-Fano parameters of the list depend on the final totals and on
+	 * the minimum deltas between consecutive pairs, so the bit arrays cannot be
+	 * written until all pairs are known. The builder therefore buffers each
+	 * pair as two 32-bit deltas (8 bytes per bucket, against the 32 bytes per
+	 * bucket of the accumulator vectors required by the vector-based
+	 * constructor) and performs the actual encoding in build().
+	 */
+	class Builder {
+		DoubleEF<AT> ef;
+		std::vector<uint32_t> cum_keys_delta, position_delta;
+		uint64_t last_cum_keys = 0, last_position = 0;
+		size_t pairs = 0;
+
+	  public:
+		Builder() {}
+
+		/** Creates a builder, preallocating the delta buffers.
+		 *
+		 * @param num_buckets the number of buckets of the resulting list (one
+		 * less than the number of pairs that will be added).
+		 */
+		Builder(const uint64_t num_buckets) {
+			cum_keys_delta.reserve(num_buckets);
+			position_delta.reserve(num_buckets);
+		}
+
+		/** Adds a pair to the list.
+		 *
+		 * Pairs must be added in order; the first pair must be (0, 0), and
+		 * both components must grow by less than 2<sup>32</sup> per pair.
+		 *
+		 * @param cum_keys the cumulative number of keys.
+		 * @param position the cumulative bit position.
+		 */
+		void add(const uint64_t cum_keys, const uint64_t position) {
+			if (pairs == 0) assert(cum_keys == 0 && position == 0);
+			else {
+				assert(cum_keys >= last_cum_keys && position >= last_position);
+				assert(cum_keys - last_cum_keys < UINT64_C(1) << 32 && position - last_position < UINT64_C(1) << 32);
+				cum_keys_delta.push_back(cum_keys - last_cum_keys);
+				position_delta.push_back(position - last_position);
+			}
+			last_cum_keys = cum_keys;
+			last_position = position;
+			pairs++;
+		}
+
+		/** Encodes the pairs added so far and returns the resulting list. */
+		DoubleEF<AT> build() {
+			assert(pairs > 1);
+			ef.num_buckets = pairs - 1;
+
+			ef.bits_per_key_fixed_point = (uint64_t(1) << 20) * (last_position / (double)last_cum_keys);
+
+			ef.min_diff = std::numeric_limits<int64_t>::max() / 2;
+			ef.cum_keys_min_delta = std::numeric_limits<int64_t>::max() / 2;
+			int64_t prev_bucket_bits = 0;
+			for (uint64_t i = 1, cum_keys = 0, position = 0; i <= ef.num_buckets; i++) {
+				cum_keys += cum_keys_delta[i - 1];
+				position += position_delta[i - 1];
+				ef.cum_keys_min_delta = min(ef.cum_keys_min_delta, int64_t(cum_keys_delta[i - 1]));
+				const int64_t bucket_bits = int64_t(position) - int64_t(ef.bits_per_key_fixed_point * cum_keys >> 20);
+				ef.min_diff = min(ef.min_diff, bucket_bits - prev_bucket_bits);
+				prev_bucket_bits = bucket_bits;
+			}
+
+			ef.layout(last_cum_keys, last_position);
+			for (uint64_t i = 0, cum_keys = 0, position = 0; i <= ef.num_buckets; i++) {
+				if (i != 0) {
+					cum_keys += cum_keys_delta[i - 1];
+					position += position_delta[i - 1];
+				}
+				ef.encode(i, cum_keys, position);
+			}
+			ef.build_jump();
+
+#ifndef NDEBUG
+			for (uint64_t i = 0, cum_keys = 0, position = 0; i < ef.num_buckets; i++) {
+				if (i != 0) {
+					cum_keys += cum_keys_delta[i - 1];
+					position += position_delta[i - 1];
+				}
+				uint64_t x, x2, y;
+				ef.get(i, x, x2, y);
+				assert(x == cum_keys);
+				assert(x2 == cum_keys + cum_keys_delta[i]);
+				assert(y == position);
+			}
+#endif
+			return std::move(ef);
+		}
+	};
+
+	/** Prefetches the cache lines accessed first by get() for a given bucket.
+	 *
+	 * Issuing prefetches for several buckets before resolving any of them
+	 * keeps multiple cache misses in flight.
+	 *
+	 * @param i the bucket whose data will be prefetched.
+	 */
+	void prefetch(const uint64_t i) const {
+		__builtin_prefetch((uint8_t *)&lower_bits + i * (l_cum_keys + l_position) / 8);
+		__builtin_prefetch(&jump + (i / super_q) * super_q_size * 2);
+	}
+
 	void get(const uint64_t i, uint64_t &cum_keys, uint64_t &cum_keys_next, uint64_t &position) {
 		const uint64_t pos_lower = i * (l_cum_keys + l_position);
 		uint64_t lower;
@@ -294,9 +416,61 @@ template <util::AllocType AT = util::AllocType::MALLOC> class DoubleEF {
 				   int64_t(bits_per_key_fixed_point * cum_keys >> 20);
 	}
 
+	/** Maps this list over a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator and must
+	 * stay alive as long as this instance is in use.
+	 *
+	 * @param p a pointer inside a memory-mapped serialized image.
+	 * @return the pointer advanced past the data of this list.
+	 */
+	uint64_t *map(uint64_t *p) {
+		num_buckets = *p++;
+		u_cum_keys = *p++;
+		u_position = *p++;
+		cum_keys_min_delta = int64_t(*p++);
+		min_diff = int64_t(*p++);
+		bits_per_key_fixed_point = *p++;
+
+		l_position = u_position / (num_buckets + 1) == 0 ? 0 : lambda(u_position / (num_buckets + 1));
+		l_cum_keys = u_cum_keys / (num_buckets + 1) == 0 ? 0 : lambda(u_cum_keys / (num_buckets + 1));
+		assert(l_cum_keys * 2 + l_position <= 56);
+
+		lower_bits_mask_cum_keys = (UINT64_C(1) << l_cum_keys) - 1;
+		lower_bits_mask_position = (UINT64_C(1) << l_position) - 1;
+
+		uint64_t nsize = *p++;
+		lower_bits.view(p, nsize);
+		p += nsize;
+		nsize = *p++;
+		upper_bits_cum_keys.view(p, nsize);
+		p += nsize;
+		nsize = *p++;
+		upper_bits_position.view(p, nsize);
+		p += nsize;
+		nsize = *p++;
+		jump.view(p, nsize);
+		return p + nsize;
+	}
+
 	uint64_t bitCountCumKeys() { return (num_buckets + 1) * l_cum_keys + num_buckets + 1 + (u_cum_keys >> l_cum_keys) + jump_size_words() / 2; }
 
 	uint64_t bitCountPosition() { return (num_buckets + 1) * l_position + num_buckets + 1 + (u_position >> l_position) + jump_size_words() / 2; }
+
+	/** Returns a structured report of the space used by this structure. */
+	util::SpaceReport spaceReport() const {
+		return {"double_ef", sizeof(*this) * 8, AT,
+				{util::spaceReport("lower_bits", lower_bits), util::spaceReport("upper_bits_cum_keys", upper_bits_cum_keys), util::spaceReport("upper_bits_position", upper_bits_position),
+				 util::spaceReport("jump", jump)}};
+	}
+
+	/** Prefaults the bit arrays in layout order. */
+	void warmup() const {
+		lower_bits.prefault();
+		upper_bits_cum_keys.prefault();
+		upper_bits_position.prefault();
+		jump.prefault();
+	}
 };
 
 } // namespace sux::function
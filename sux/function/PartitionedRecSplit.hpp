@@ -0,0 +1,222 @@
+/*
+ * Sux: Succinct data structures
+ *
+ * Copyright (C) 2019-2020 Emmanuel Esposito and Sebastiano Vigna
+ *
+ *  This library is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as published by the Free
+ *  Software Foundation; either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * Under Section 7 of GPL version 3, you are granted additional permissions
+ * described in the GCC Runtime Library Exception, version 3.1, as published by
+ * the Free Software Foundation.
+ *
+ * You should have received a copy of the GNU General Public License and a copy of
+ * the GCC Runtime Library Exception along with this program; see the files
+ * COPYING3 and COPYING.RUNTIME respectively.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "RecSplit.hpp"
+
+namespace sux::function {
+
+/** A minimal perfect hash function split into independently rebuildable partitions.
+ *
+ * The keyset is divided into partitions by the high bits of the first hash
+ * half, and each partition is stored as a RecSplit instance; partitions are
+ * built in parallel. The function maps the whole keyset onto a contiguous
+ * range, with the keys of partition p occupying the range
+ * [offset(p)..offset(p+1)), and a single partition can be rebuilt in place
+ * without touching the others, which makes incremental rebuilds possible.
+ *
+ * Inside a partition the first hash half is remixed, as the partition
+ * selection leaves it confined to a narrow interval, which would skew the
+ * bucket assignment of the underlying RecSplit.
+ *
+ * @tparam LEAF_SIZE the size of a leaf, as in RecSplit.
+ * @tparam AT a type of memory allocation out of sux::util::AllocType.
+ * @tparam Hasher the key hashing policy, as in RecSplit.
+ */
+
+template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC, typename Hasher = SpookyHasher> class PartitionedRecSplit {
+	size_t num_partitions;
+	int log2parts;
+	size_t bucket_size;
+	size_t keys_count;
+	vector<RecSplit<LEAF_SIZE, AT, Hasher>> parts;
+	vector<uint64_t> offsets;
+
+	inline size_t partition(const hash128_t &hash) const { return hash.first >> (64 - log2parts); }
+
+	// The hash passed down to a partition; remixing the first half restores a
+	// uniform bucket assignment inside the partition.
+	inline static hash128_t part_hash(const hash128_t &hash) { return hash128_t(remix(hash.first), hash.second); }
+
+	void build(vector<vector<hash128_t>> &part_keys, const size_t num_threads) {
+		parts = vector<RecSplit<LEAF_SIZE, AT, Hasher>>(num_partitions);
+		atomic<size_t> next_part(0);
+		auto thread_body = [&]() {
+			for (;;) {
+				const size_t p = next_part.fetch_add(1, memory_order_relaxed);
+				if (p >= num_partitions) break;
+				parts[p] = RecSplit<LEAF_SIZE, AT, Hasher>(part_keys[p], bucket_size);
+			}
+		};
+		vector<thread> threads;
+		for (size_t t = 0; t < max(size_t(1), num_threads); t++) threads.emplace_back(thread_body);
+		for (auto &t : threads) t.join();
+		update_offsets();
+	}
+
+	void update_offsets() {
+		offsets.resize(num_partitions + 1);
+		offsets[0] = 0;
+		for (size_t p = 0; p < num_partitions; p++) offsets[p + 1] = offsets[p] + parts[p].size();
+		keys_count = offsets[num_partitions];
+	}
+
+	friend ostream &operator<<(ostream &os, const PartitionedRecSplit<LEAF_SIZE, AT, Hasher> &rs) {
+		os.write((char *)&rs.num_partitions, sizeof(rs.num_partitions));
+		os.write((char *)&rs.bucket_size, sizeof(rs.bucket_size));
+		for (size_t p = 0; p < rs.num_partitions; p++) os << rs.parts[p];
+		return os;
+	}
+
+	friend istream &operator>>(istream &is, PartitionedRecSplit<LEAF_SIZE, AT, Hasher> &rs) {
+		is.read((char *)&rs.num_partitions, sizeof(rs.num_partitions));
+		is.read((char *)&rs.bucket_size, sizeof(rs.bucket_size));
+		rs.log2parts = lambda(rs.num_partitions);
+		rs.parts = vector<RecSplit<LEAF_SIZE, AT, Hasher>>(rs.num_partitions);
+		for (size_t p = 0; p < rs.num_partitions; p++) is >> rs.parts[p];
+		rs.update_offsets();
+		return is;
+	}
+
+  public:
+	PartitionedRecSplit() {}
+
+	/** Builds a PartitionedRecSplit instance using a given list of keys.
+	 *
+	 * **Warning**: duplicate keys will cause this method to never return.
+	 *
+	 * @param keys a vector of strings.
+	 * @param bucket_size the desired bucket size of the underlying RecSplit instances.
+	 * @param num_partitions the number of partitions (rounded up to a power of two).
+	 * @param num_threads the number of threads used to build partitions in parallel.
+	 */
+	PartitionedRecSplit(const vector<string> &keys, const size_t bucket_size, const size_t num_partitions, const size_t num_threads = 1) {
+		this->bucket_size = bucket_size;
+		this->num_partitions = round_pow2(num_partitions);
+		this->log2parts = lambda(this->num_partitions);
+
+		vector<vector<hash128_t>> part_keys(this->num_partitions);
+		for (const auto &key : keys) {
+			const hash128_t h = Hasher::hash(key.c_str(), key.size());
+			part_keys[partition(h)].push_back(part_hash(h));
+		}
+		build(part_keys, num_threads);
+	}
+
+	/** Builds a PartitionedRecSplit instance using a given list of 128-bit hashes.
+	 *
+	 * **Warning**: duplicate keys will cause this method to never return.
+	 *
+	 * Note that this constructor is mainly useful for benchmarking.
+	 * @param keys a vector of 128-bit hashes.
+	 * @param bucket_size the desired bucket size of the underlying RecSplit instances.
+	 * @param num_partitions the number of partitions (rounded up to a power of two).
+	 * @param num_threads the number of threads used to build partitions in parallel.
+	 */
+	PartitionedRecSplit(const vector<hash128_t> &keys, const size_t bucket_size, const size_t num_partitions, const size_t num_threads = 1) {
+		this->bucket_size = bucket_size;
+		this->num_partitions = round_pow2(num_partitions);
+		this->log2parts = lambda(this->num_partitions);
+
+		vector<vector<hash128_t>> part_keys(this->num_partitions);
+		for (const auto &h : keys) part_keys[partition(h)].push_back(part_hash(h));
+		build(part_keys, num_threads);
+	}
+
+	/** Rebuilds a single partition in place using a new list of keys.
+	 *
+	 * All the provided keys must belong to the given partition. If the number
+	 * of keys of the partition changes, the offsets of the following
+	 * partitions shift accordingly.
+	 *
+	 * **Warning**: duplicate keys will cause this method to never return.
+	 *
+	 * @param p the index of the partition to rebuild.
+	 * @param keys the new keys of the partition.
+	 */
+	void rebuild(const size_t p, const vector<string> &keys) {
+		vector<hash128_t> hashes;
+		for (const auto &key : keys) {
+			const hash128_t h = Hasher::hash(key.c_str(), key.size());
+			if (partition(h) != p) {
+				fprintf(stderr, "Key of partition %d passed to the rebuild of partition %d\n", int(partition(h)), int(p));
+				abort();
+			}
+			hashes.push_back(part_hash(h));
+		}
+		parts[p] = RecSplit<LEAF_SIZE, AT, Hasher>(hashes, bucket_size);
+		update_offsets();
+	}
+
+	/** Returns the value associated with the given 128-bit hash.
+	 *
+	 * Note that this method is mainly useful for benchmarking.
+	 * @param hash a 128-bit hash.
+	 * @return the associated value.
+	 */
+	size_t operator()(const hash128_t &hash) {
+		const size_t p = partition(hash);
+		return offsets[p] + parts[p](part_hash(hash));
+	}
+
+	/** Returns the value associated with the given key.
+	 *
+	 * @param key a key.
+	 * @return the associated value.
+	 */
+	size_t operator()(const string &key) { return operator()(Hasher::hash(key.c_str(), key.size())); }
+
+	/** Returns the value associated with the given key, without
+	 * materializing a string.
+	 *
+	 * @param key a key.
+	 * @return the associated value.
+	 */
+	size_t operator()(const string_view key) { return operator()(Hasher::hash(key.data(), key.size())); }
+
+	/** Returns the value associated with a binary key given as a pointer
+	 * and a length, without materializing a string.
+	 *
+	 * @param key a pointer to the key.
+	 * @param length the length in bytes of the key.
+	 * @return the associated value.
+	 */
+	size_t operator()(const void *key, const size_t length) { return operator()(Hasher::hash(key, length)); }
+
+	/** Returns the number of partitions of this instance. */
+	inline size_t partitions() const { return num_partitions; }
+
+	/** Returns the first value assigned to the keys of a given partition. */
+	inline uint64_t offset(const size_t p) const { return offsets[p]; }
+
+	/** Returns the number of keys used to build this PartitionedRecSplit instance. */
+	inline size_t size() const { return this->keys_count; }
+};
+
+} // namespace sux::function
@@ -29,16 +29,27 @@
 #pragma once
 
 #include "../support/SpookyV2.hpp"
+#include "../util/SpaceReport.hpp"
 #include "../util/Vector.hpp"
 #include "DoubleEF.hpp"
 #include "RiceBitVector.hpp"
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cmath>
 #include <string>
+#include <string_view>
+#if defined(__cpp_impl_coroutine)
+#include "../support/Lookup.hpp"
+#endif
+#include <thread>
 #include <vector>
 #include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace sux::function {
 
@@ -281,8 +292,122 @@ static constexpr array<uint8_t, MAX_LEAF_SIZE> fill_bij_midstop() {
 	return memo;
 }
 
+#ifdef __AVX2__
+
+// 64-bit lane-wise product of the low 64 bits (AVX2 has no 64x64 multiply).
+__m256i inline mullo64(const __m256i a, const __m256i b) {
+	const __m256i lo = _mm256_mul_epu32(a, b);
+	const __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)), _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b));
+	return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+// Lane-wise remix() (see the scalar version above).
+__m256i inline remix256(__m256i z) {
+	z = mullo64(_mm256_xor_si256(z, _mm256_srli_epi64(z, 30)), _mm256_set1_epi64x(0xbf58476d1ce4e5b9));
+	z = mullo64(_mm256_xor_si256(z, _mm256_srli_epi64(z, 27)), _mm256_set1_epi64x(0x94d049bb133111eb));
+	return _mm256_xor_si256(z, _mm256_srli_epi64(z, 31));
+}
+
+#endif // __AVX2__
+
+/** Computes the bitmask of the values remap16(remix(bucket[i] + x), m)
+ * for i in [start..end), i.e. the mask checked by the bijection search
+ * at the leaves; vectorized four keys at a time when AVX2 is available.
+ */
+uint32_t inline leaf_mask(const uint64_t *const bucket, const size_t start, const size_t end, const uint64_t x, const uint64_t m) {
+	uint32_t mask = 0;
+	size_t i = start;
+#ifdef __AVX2__
+	const __m256i xv = _mm256_set1_epi64x(x);
+	const __m256i mask48 = _mm256_set1_epi64x((uint64_t(1) << 48) - 1);
+	const __m256i mv = _mm256_set1_epi64x(m);
+	const __m256i ones = _mm256_set1_epi64x(1);
+	__m256i acc = _mm256_setzero_si256();
+	for (; i + 4 <= end; i += 4) {
+		const __m256i z = remix256(_mm256_add_epi64(_mm256_loadu_si256((const __m256i *)(bucket + i)), xv));
+		const __m256i r = _mm256_srli_epi64(mullo64(_mm256_and_si256(z, mask48), mv), 48);
+		acc = _mm256_or_si256(acc, _mm256_sllv_epi64(ones, r));
+	}
+	const __m128i acc128 = _mm_or_si128(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+	mask = uint32_t(_mm_cvtsi128_si64(acc128) | _mm_extract_epi64(acc128, 1));
+#endif
+	for (; i < end; i++) mask |= uint32_t(1) << remap16(remix(bucket[i] + x), m);
+	return mask;
+}
+
 #define first_hash(k, len) spooky(k, len, 0)
 #define golomb_param(m) (memo[m] >> 27)
+
+/** Optional per-instance construction statistics for RecSplit.
+ *
+ * An instance of this class can be attached to the constructors of RecSplit.
+ * All counters are atomic, so multi-threaded builds update them concurrently,
+ * and no work is performed at all when no instance is attached. This is the
+ * per-instance, thread-safe replacement for the file-scope globals compiled
+ * in with -DSTATS/-DMORESTATS, which remain available for the benchmarks.
+ */
+class RecSplitStats {
+  public:
+	/** The number of levels whose split times are recorded individually
+	 * (the last entry accumulates all deeper levels). */
+	static constexpr int MAX_STATS_LEVELS = 20;
+
+	/** The number of bijections found, indexed by leaf size. */
+	atomic<uint64_t> bij_count[MAX_LEAF_SIZE];
+	/** The overall number of trials of the bijections found, indexed by leaf size. */
+	atomic<uint64_t> bij_trials[MAX_LEAF_SIZE];
+	/** The time (in nanoseconds) spent searching for bijections. */
+	atomic<uint64_t> bij_time;
+	/** The number of splittings computed. */
+	atomic<uint64_t> split_count;
+	/** The overall number of trials of the splittings computed. */
+	atomic<uint64_t> split_trials;
+	/** The time (in nanoseconds) spent searching for splittings, indexed by level. */
+	atomic<uint64_t> split_time[MAX_STATS_LEVELS];
+
+	RecSplitStats() { reset(); }
+
+	void reset() {
+		for (int m = 0; m < MAX_LEAF_SIZE; m++) bij_count[m] = bij_trials[m] = 0;
+		for (int l = 0; l < MAX_STATS_LEVELS; l++) split_time[l] = 0;
+		bij_time = split_count = split_trials = 0;
+	}
+
+	/** Returns the average number of trials per bijection of the given leaf size. */
+	double avgBijTrials(const size_t m) const { return bij_count[m] ? (double)bij_trials[m] / bij_count[m] : 0; }
+
+	/** Returns the average number of trials per splitting. */
+	double avgSplitTrials() const { return split_count ? (double)split_trials / split_count : 0; }
+};
+
+/** The default key hashing policy of RecSplit, based on SpookyHash.
+ *
+ * A hashing policy provides a single static method turning a key into a
+ * hash128_t; it can be replaced (e.g., with ShortKeyHasher) through the
+ * `Hasher` template parameter of RecSplit. Note that instances built with
+ * different policies are incompatible, dumps included.
+ */
+struct SpookyHasher {
+	static hash128_t hash(const void *data, const size_t length) { return first_hash(data, length); }
+};
+
+/** A cheap hashing policy for short keys.
+ *
+ * Keys of at most 16 bytes are mixed with three rounds of remix(), which is
+ * considerably faster than SpookyHash and injective on keys of equal length;
+ * longer keys fall back to SpookyHash.
+ */
+struct ShortKeyHasher {
+	static hash128_t hash(const void *data, const size_t length) {
+		if (length > 16) return first_hash(data, length);
+		uint64_t a = 0, b = 0;
+		memcpy(&a, data, min(length, size_t(8)));
+		if (length > 8) memcpy(&b, (const char *)data + 8, length - 8);
+		const uint64_t h0 = remix(a + 0x9e3779b97f4a7c15 * (length + 1));
+		const uint64_t h1 = remix(b + h0);
+		return hash128_t(h1, remix(h0 ^ h1));
+	}
+};
 #define skip_bits(m) (memo[m] & 0xFFFF)
 #define skip_nodes(m) ((memo[m] >> 16) & 0x7FF)
 
@@ -297,7 +422,7 @@ static constexpr array<uint8_t, MAX_LEAF_SIZE> fill_bij_midstop() {
  * @tparam AT a type of memory allocation out of sux::util::AllocType.
  */
 
-template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class RecSplit {
+template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC, typename Hasher = SpookyHasher> class RecSplit {
 	using SplitStrat = SplittingStrategy<LEAF_SIZE>;
 
 	static constexpr size_t _leaf = LEAF_SIZE;
@@ -314,10 +439,33 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 	size_t keys_count;
 	RiceBitVector<AT> descriptors;
 	DoubleEF<AT> ef;
+	void *mapped_base = nullptr;
+	size_t mapped_length = 0;
+	RecSplitStats *stats = nullptr;
 
   public:
 	RecSplit() {}
 
+	~RecSplit() {
+		if (mapped_base) munmap(mapped_base, mapped_length);
+	}
+
+	RecSplit(RecSplit &&oth)
+		: bucket_size(oth.bucket_size), nbuckets(oth.nbuckets), keys_count(oth.keys_count), descriptors(std::move(oth.descriptors)), ef(std::move(oth.ef)),
+		  mapped_base(std::exchange(oth.mapped_base, nullptr)), mapped_length(std::exchange(oth.mapped_length, 0)), stats(std::exchange(oth.stats, nullptr)) {}
+
+	RecSplit &operator=(RecSplit &&oth) {
+		std::swap(bucket_size, oth.bucket_size);
+		std::swap(nbuckets, oth.nbuckets);
+		std::swap(keys_count, oth.keys_count);
+		std::swap(descriptors, oth.descriptors);
+		std::swap(ef, oth.ef);
+		std::swap(mapped_base, oth.mapped_base);
+		std::swap(mapped_length, oth.mapped_length);
+		std::swap(stats, oth.stats);
+		return *this;
+	}
+
 	/** Builds a RecSplit instance using a given list of keys and bucket size.
 	 *
 	 * **Warning**: duplicate keys will cause this method to never return.
@@ -326,15 +474,19 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 	 * @param bucket_size the desired bucket size; typical sizes go from
 	 * 100 to 2000, with smaller buckets giving slightly larger but faster
 	 * functions.
+	 * @param num_threads the number of threads to use during construction;
+	 * the result does not depend on this parameter.
+	 * @param stats if not `nullptr`, construction statistics are accumulated there.
 	 */
-	RecSplit(const vector<string> &keys, const size_t bucket_size) {
+	RecSplit(const vector<string> &keys, const size_t bucket_size, const size_t num_threads = 1, RecSplitStats *stats = nullptr) {
+		this->stats = stats;
 		this->bucket_size = bucket_size;
 		this->keys_count = keys.size();
 		hash128_t *h = (hash128_t *)malloc(this->keys_count * sizeof(hash128_t));
 		for (size_t i = 0; i < this->keys_count; ++i) {
-			h[i] = first_hash(keys[i].c_str(), keys[i].size());
+			h[i] = Hasher::hash(keys[i].c_str(), keys[i].size());
 		}
-		hash_gen(h);
+		hash_gen(h, num_threads);
 		free(h);
 	}
 
@@ -347,11 +499,15 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 	 * @param bucket_size the desired bucket size; typical sizes go from
 	 * 100 to 2000, with smaller buckets giving slightly larger but faster
 	 * functions.
+	 * @param num_threads the number of threads to use during construction;
+	 * the result does not depend on this parameter.
+	 * @param stats if not `nullptr`, construction statistics are accumulated there.
 	 */
-	RecSplit(vector<hash128_t> &keys, const size_t bucket_size) {
+	RecSplit(vector<hash128_t> &keys, const size_t bucket_size, const size_t num_threads = 1, RecSplitStats *stats = nullptr) {
+		this->stats = stats;
 		this->bucket_size = bucket_size;
 		this->keys_count = keys.size();
-		hash_gen(&keys[0]);
+		hash_gen(&keys[0], num_threads);
 	}
 
 	/** Builds a RecSplit instance using a list of keys returned by a stream and bucket size.
@@ -360,13 +516,141 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 	 *
 	 * @param input an open input stream returning a list of keys, one per line.
 	 * @param bucket_size the desired bucket size.
+	 * @param num_threads the number of threads to use during construction;
+	 * the result does not depend on this parameter.
 	 */
-	RecSplit(ifstream& input, const size_t bucket_size) {
+	RecSplit(ifstream& input, const size_t bucket_size, const size_t num_threads = 1) {
 		this->bucket_size = bucket_size;
 		vector<hash128_t> h;
-		for(string key; getline(input, key);) h.push_back(first_hash(key.c_str(), key.size()));
+		for(string key; getline(input, key);) h.push_back(Hasher::hash(key.c_str(), key.size()));
 		this->keys_count = h.size();
-		hash_gen(&h[0]);
+		hash_gen(&h[0], num_threads);
+	}
+
+	/** Builds a RecSplit instance using a list of keys returned by a stream, spilling
+	 * hashed keys to disk so that memory usage is bounded.
+	 *
+	 * **Warning**: duplicate keys will cause this method to never return.
+	 *
+	 * Keys are hashed and scattered sequentially into temporary runs partitioned
+	 * by the high bits of the first hash half; since buckets are assigned by
+	 * multiplicative range reduction of the same half, each run covers a
+	 * contiguous range of buckets and the runs can be sorted and processed one
+	 * at a time. Peak memory is roughly 16 bytes per key divided by the number
+	 * of runs, plus the bucket cumulatives. The result is bit-for-bit identical
+	 * to an in-memory build.
+	 *
+	 * @param input an open input stream returning a list of keys, one per line.
+	 * @param bucket_size the desired bucket size.
+	 * @param tmp_dir a directory for the temporary spill files.
+	 * @param spill_runs the number of spill runs (rounded up to a power of two).
+	 */
+	RecSplit(ifstream &input, const size_t bucket_size, const string &tmp_dir, const size_t spill_runs = 256) {
+		this->bucket_size = bucket_size;
+		const size_t runs = round_pow2(spill_runs);
+		const int log2runs = lambda(runs);
+
+		// Pass 1: hash keys and scatter them into runs by the high bits of the first hash half.
+		const string prefix = tmp_dir + "/recsplit." + to_string(getpid()) + ".spill.";
+		vector<FILE *> spill(runs);
+		for (size_t f = 0; f < runs; f++) {
+			const string name = prefix + to_string(f);
+			spill[f] = fopen(name.c_str(), "w+");
+			if (spill[f] == NULL) {
+				fprintf(stderr, "Cannot create temporary file %s\n", name.c_str());
+				abort();
+			}
+		}
+		this->keys_count = 0;
+		for (string key; getline(input, key);) {
+			const hash128_t h = Hasher::hash(key.c_str(), key.size());
+			fwrite(&h, sizeof h, 1, spill[h.first >> (64 - log2runs)]);
+			this->keys_count++;
+		}
+
+		nbuckets = max(1, (keys_count + bucket_size - 1) / bucket_size);
+		typename DoubleEF<AT>::Builder ef_builder(nbuckets);
+		typename RiceBitVector<AT>::Builder builder;
+		ef_builder.add(0, 0);
+
+		// Pass 2: sort each run by bucket and process its buckets in order. A
+		// bucket may straddle a run boundary, in which case its keys are carried
+		// over into the next run.
+		vector<hash128_t> run;
+		for (size_t f = 0, bucket_idx = 0, keys_acc = 0; f < runs; f++) {
+			const size_t carried = run.size();
+			fseek(spill[f], 0, SEEK_END);
+			const size_t run_keys = ftell(spill[f]) / sizeof(hash128_t);
+			run.resize(carried + run_keys, hash128_t(0, 0));
+			rewind(spill[f]);
+			if (fread(&run[carried], sizeof(hash128_t), run_keys, spill[f]) != run_keys) {
+				fprintf(stderr, "Cannot read back temporary file %zu\n", f);
+				abort();
+			}
+			fclose(spill[f]);
+			remove((prefix + to_string(f)).c_str());
+
+			sort(run.begin(), run.end(), [this](const hash128_t &a, const hash128_t &b) { return hash128_to_bucket(a) < hash128_to_bucket(b); });
+
+			// The bucket containing the last hash of this run's range may continue in the next run.
+			const size_t limit = f == runs - 1 ? nbuckets : hash128_to_bucket(hash128_t((f + 1) << (64 - log2runs), 0));
+			size_t pos = 0;
+			for (; bucket_idx < limit; bucket_idx++) {
+				vector<uint64_t> bucket;
+				for (; pos < run.size() && hash128_to_bucket(run[pos]) == bucket_idx; pos++) bucket.push_back(run[pos].second);
+
+				keys_acc += bucket.size();
+				if (bucket.size() > 1) {
+					vector<uint32_t> unary;
+					recSplit(bucket, builder, unary);
+					builder.appendUnaryAll(unary);
+				}
+				ef_builder.add(keys_acc, builder.getBits());
+			}
+			run.erase(run.begin(), run.begin() + pos);
+		}
+		builder.appendFixed(1, 1); // Sentinel (avoids checking for parts of size 1)
+		descriptors = builder.build();
+		ef = ef_builder.build();
+	}
+
+	/** Maps a serialized RecSplit instance read-only, with no copy.
+	 *
+	 * The dump (written with the `<<` operator) is `mmap()`-ed and the internal
+	 * structures point directly into the mapping, so loading takes constant
+	 * time and pages are faulted in lazily by queries. The mapping is released
+	 * at destruction time.
+	 *
+	 * @param filename the name of a file containing a serialized RecSplit instance.
+	 */
+	void map(const char *filename) {
+		const int fd = open(filename, O_RDONLY);
+		if (fd == -1) {
+			fprintf(stderr, "Cannot open %s\n", filename);
+			abort();
+		}
+		struct stat st;
+		fstat(fd, &st);
+		mapped_length = st.st_size;
+		mapped_base = mmap(nullptr, mapped_length, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (mapped_base == MAP_FAILED) {
+			fprintf(stderr, "Cannot map %s\n", filename);
+			abort();
+		}
+
+		uint64_t *p = (uint64_t *)mapped_base;
+		const size_t leaf_size = *p++;
+		if (leaf_size != LEAF_SIZE) {
+			fprintf(stderr, "Serialized leaf size %d, code leaf size %d\n", int(leaf_size), int(LEAF_SIZE));
+			abort();
+		}
+		bucket_size = *p++;
+		keys_count = *p++;
+		nbuckets = max(1, (keys_count + bucket_size - 1) / bucket_size);
+
+		p = descriptors.map(p);
+		ef.map(p);
 	}
 
 	/** Returns the value associated with the given 128-bit hash.
@@ -379,9 +663,63 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 		const size_t bucket = hash128_to_bucket(hash);
 		uint64_t cum_keys, cum_keys_next, bit_pos;
 		ef.get(bucket, cum_keys, cum_keys_next, bit_pos);
+		return bucket_query(hash, cum_keys, cum_keys_next - cum_keys, bit_pos);
+	}
+
+	/** Returns the values associated with a batch of 128-bit hashes.
+	 *
+	 * The hashes are processed in small windows whose bucket cumulatives and
+	 * descriptor positions are prefetched before any of them is resolved, so
+	 * several cache misses are kept in flight; on memory-bound workloads this
+	 * is significantly faster than repeated single-key lookups.
+	 *
+	 * Note that this method is mainly useful for benchmarking.
+	 * @param hashes an array of 128-bit hashes.
+	 * @param n the number of hashes.
+	 * @param out an array of `n` elements receiving the associated values.
+	 */
+	void operator()(const hash128_t *hashes, const size_t n, uint64_t *out) {
+		constexpr size_t window = 16;
+		size_t bucket[window];
+		uint64_t cum_keys[window], cum_keys_next[window], bit_pos[window];
+
+		for (size_t base = 0; base < n; base += window) {
+			const size_t w = min(window, n - base);
+			for (size_t j = 0; j < w; j++) {
+				bucket[j] = hash128_to_bucket(hashes[base + j]);
+				ef.prefetch(bucket[j]);
+			}
+			for (size_t j = 0; j < w; j++) {
+				ef.get(bucket[j], cum_keys[j], cum_keys_next[j], bit_pos[j]);
+				descriptors.prefetch(bit_pos[j]);
+			}
+			for (size_t j = 0; j < w; j++) out[base + j] = bucket_query(hashes[base + j], cum_keys[j], cum_keys_next[j] - cum_keys[j], bit_pos[j]);
+		}
+	}
+
+#if defined(__cpp_impl_coroutine)
+	/** Returns the lookup of a 128-bit hash as a suspendable Lookup (see sux::Lookup).
+	 *
+	 * The lookup suspends after prefetching the bucket bounds and again
+	 * after prefetching the bucket descriptors, so a driver such as
+	 * sux::interleave() can overlap the misses of many queries, also on
+	 * different structures, which the batched overload cannot.
+	 */
+	Lookup<size_t> queryLookup(const hash128_t hash) {
+		const size_t bucket = hash128_to_bucket(hash);
+		ef.prefetch(bucket);
+		co_await std::suspend_always{};
+		uint64_t cum_keys, cum_keys_next, bit_pos;
+		ef.get(bucket, cum_keys, cum_keys_next, bit_pos);
+		descriptors.prefetch(bit_pos);
+		co_await std::suspend_always{};
+		co_return bucket_query(hash, cum_keys, cum_keys_next - cum_keys, bit_pos);
+	}
+#endif
 
-		// Number of keys in this bucket
-		size_t m = cum_keys_next - cum_keys;
+  private:
+	// Walks the splitting tree of a bucket; m is the number of keys in the bucket.
+	size_t bucket_query(const hash128_t &hash, uint64_t cum_keys, size_t m, const uint64_t bit_pos) {
 		auto reader = descriptors.reader();
 		reader.readReset(bit_pos, skip_bits(m));
 		int level = 0;
@@ -426,16 +764,87 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 		return cum_keys + remap16(remix(hash.second + b + start_seed[level]), m);
 	}
 
+  public:
 	/** Returns the value associated with the given key.
 	 *
 	 * @param key a key.
 	 * @return the associated value.
 	 */
-	size_t operator()(const string &key) { return operator()(first_hash(key.c_str(), key.size())); }
+	size_t operator()(const string &key) { return operator()(Hasher::hash(key.c_str(), key.size())); }
+
+	/** Returns the value associated with the given key, without
+	 * materializing a string.
+	 *
+	 * @param key a key.
+	 * @return the associated value.
+	 */
+	size_t operator()(const string_view key) { return operator()(Hasher::hash(key.data(), key.size())); }
+
+	/** Returns the value associated with a binary key given as a pointer
+	 * and a length, without materializing a string.
+	 *
+	 * @param key a pointer to the key.
+	 * @param length the length in bytes of the key.
+	 * @return the associated value.
+	 */
+	size_t operator()(const void *key, const size_t length) { return operator()(Hasher::hash(key, length)); }
+
+	/** Returns the value associated with an 8-byte binary key.
+	 *
+	 * The length is a compile-time constant, so the hash short path
+	 * inlines and the key is fed to it straight from a register.
+	 *
+	 * @param key an 8-byte binary key.
+	 * @return the associated value.
+	 */
+	size_t operator()(const uint64_t key) { return operator()(Hasher::hash(&key, sizeof key)); }
+
+	/** Returns the value associated with a 16-byte binary key given as
+	 * two words, straight from registers.
+	 *
+	 * Note that, unlike operator()(const hash128_t &), the words are a
+	 * _key_, which is hashed like any other.
+	 *
+	 * @param k0 the first 8 bytes of the key.
+	 * @param k1 the last 8 bytes of the key.
+	 * @return the associated value.
+	 */
+	size_t operator()(const uint64_t k0, const uint64_t k1) {
+		const uint64_t key[2] = {k0, k1};
+		return operator()(Hasher::hash(key, sizeof key));
+	}
 
 	/** Returns the number of keys used to build this RecSplit instance. */
 	inline size_t size() { return this->keys_count; }
 
+	/** Returns a structured report of the space used by this structure.
+	 *
+	 * For an instance mapped over a serialized image the component
+	 * vectors are views into the mapping, which is reported as a
+	 * component of its own.
+	 */
+	util::SpaceReport spaceReport() const {
+		util::SpaceReport descriptors_report = descriptors.spaceReport();
+		descriptors_report.name = "descriptors";
+		util::SpaceReport report{"recsplit", sizeof(*this) * 8 - sizeof(descriptors) * 8 - sizeof(ef) * 8, AT, {std::move(descriptors_report), ef.spaceReport()}};
+		if (mapped_length != 0) report.components.push_back({"mapped", mapped_length * 8, util::SMALLPAGE, {}});
+		return report;
+	}
+
+	/** Prefaults the descriptors and the bucket cumulatives in layout order,
+	 * so that the first queries after loading or mapping do not pay soft
+	 * page faults. Meant to be called during a deployment drain, before
+	 * taking traffic.
+	 */
+	void warmup() const {
+		if (mapped_base) {
+			util::prefault(mapped_base, mapped_length);
+			return;
+		}
+		descriptors.warmup();
+		ef.warmup();
+	}
+
   private:
 	// Maps a 128-bit to a bucket using the first 64-bit half.
 	inline uint64_t hash128_to_bucket(const hash128_t &hash) const { return remap128(hash.first, nbuckets); }
@@ -457,12 +866,13 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 			sum_depths += m * level;
 			auto start_time = high_resolution_clock::now();
 #endif
+			high_resolution_clock::time_point stats_start;
+			if (stats) stats_start = high_resolution_clock::now();
 			uint32_t mask;
 			const uint32_t found = (1 << m) - 1;
 			if constexpr (_leaf <= 8) {
 				for (;;) {
-					mask = 0;
-					for (size_t i = start; i < end; i++) mask |= uint32_t(1) << remap16(remix(bucket[i] + x), m);
+					mask = leaf_mask(&bucket[0], start, end, x, m);
 #ifdef MORESTATS
 					num_bij_evals[m] += m;
 #endif
@@ -470,16 +880,14 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 					x++;
 				}
 			} else {
-				const size_t midstop = bij_midstop[m];
+				const int midstop = bij_midstop[m];
 				for (;;) {
-					mask = 0;
-					size_t i;
-					for (i = start; i < start + midstop; i++) mask |= uint32_t(1) << remap16(remix(bucket[i] + x), m);
+					mask = leaf_mask(&bucket[0], start, start + midstop, x, m);
 #ifdef MORESTATS
 					num_bij_evals[m] += midstop;
 #endif
 					if (nu(mask) == midstop) {
-						for (; i < end; i++) mask |= uint32_t(1) << remap16(remix(bucket[i] + x), m);
+						mask |= leaf_mask(&bucket[0], start + midstop, end, x, m);
 #ifdef MORESTATS
 						num_bij_evals[m] += m - midstop;
 #endif
@@ -492,6 +900,11 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 			time_bij += duration_cast<nanoseconds>(high_resolution_clock::now() - start_time).count();
 #endif
 			x -= start_seed[level];
+			if (stats) {
+				stats->bij_count[m].fetch_add(1, memory_order_relaxed);
+				stats->bij_trials[m].fetch_add(x + 1, memory_order_relaxed);
+				stats->bij_time.fetch_add(duration_cast<nanoseconds>(high_resolution_clock::now() - stats_start).count(), memory_order_relaxed);
+			}
 			const auto log2golomb = golomb_param(m);
 			builder.appendFixed(x, log2golomb);
 			unary.push_back(x >> log2golomb);
@@ -514,6 +927,8 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 #ifdef MORESTATS
 			auto start_time = high_resolution_clock::now();
 #endif
+			high_resolution_clock::time_point stats_start;
+			if (stats) stats_start = high_resolution_clock::now();
 			if (m > upper_aggr) { // fanout = 2
 				const size_t split = ((uint16_t(m / 2 + upper_aggr - 1) / upper_aggr)) * upper_aggr;
 
@@ -544,6 +959,7 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 #ifdef MORESTATS
 				time_split[min(MAX_LEVEL_TIME, level)] += duration_cast<nanoseconds>(high_resolution_clock::now() - start_time).count();
 #endif
+				if (stats) stats->split_time[min(RecSplitStats::MAX_STATS_LEVELS - 1, level)].fetch_add(duration_cast<nanoseconds>(high_resolution_clock::now() - stats_start).count(), memory_order_relaxed);
 				recSplit(bucket, temp, start, start + split, builder, unary, level + 1);
 				if (m - split > 1) recSplit(bucket, temp, start + split, end, builder, unary, level + 1);
 #ifdef MORESTATS
@@ -581,6 +997,7 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 #ifdef MORESTATS
 				time_split[min(MAX_LEVEL_TIME, level)] += duration_cast<nanoseconds>(high_resolution_clock::now() - start_time).count();
 #endif
+				if (stats) stats->split_time[min(RecSplitStats::MAX_STATS_LEVELS - 1, level)].fetch_add(duration_cast<nanoseconds>(high_resolution_clock::now() - stats_start).count(), memory_order_relaxed);
 				size_t i;
 				for (i = 0; i < m - lower_aggr; i += lower_aggr) {
 					recSplit(bucket, temp, start + i, start + i + lower_aggr, builder, unary, level + 1);
@@ -620,6 +1037,7 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 #ifdef MORESTATS
 				time_split[min(MAX_LEVEL_TIME, level)] += duration_cast<nanoseconds>(high_resolution_clock::now() - start_time).count();
 #endif
+				if (stats) stats->split_time[min(RecSplitStats::MAX_STATS_LEVELS - 1, level)].fetch_add(duration_cast<nanoseconds>(high_resolution_clock::now() - stats_start).count(), memory_order_relaxed);
 				size_t i;
 				for (i = 0; i < m - _leaf; i += _leaf) {
 					recSplit(bucket, temp, start + i, start + i + _leaf, builder, unary, level + 1);
@@ -631,6 +1049,10 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 #endif
 			}
 
+			if (stats) {
+				stats->split_count.fetch_add(1, memory_order_relaxed);
+				stats->split_trials.fetch_add(x + 1, memory_order_relaxed);
+			}
 #ifdef MORESTATS
 			++split_count;
 			num_split_trials += x + 1;
@@ -662,7 +1084,7 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 		}
 	}
 
-	void hash_gen(hash128_t *hashes) {
+	void hash_gen(hash128_t *hashes, const size_t num_threads = 1) {
 #ifdef MORESTATS
 		time_bij = 0;
 		memset(time_split, 0, sizeof time_split);
@@ -685,26 +1107,62 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 		}
 #endif
 		nbuckets = max(1, (keys_count + bucket_size - 1) / bucket_size);
-		auto bucket_size_acc = vector<int64_t>(nbuckets + 1);
-		auto bucket_pos_acc = vector<int64_t>(nbuckets + 1);
+		typename DoubleEF<AT>::Builder ef_builder(nbuckets);
 
 		sort(hashes, hashes + keys_count, [this](const hash128_t &a, const hash128_t &b) { return hash128_to_bucket(a) < hash128_to_bucket(b); });
 		typename RiceBitVector<AT>::Builder builder;
 
-		bucket_size_acc[0] = bucket_pos_acc[0] = 0;
+		ef_builder.add(0, 0);
+		if (num_threads > 1 && nbuckets > 1) {
+			// Bucket boundaries in the sorted hash array.
+			auto bucket_start = vector<size_t>(nbuckets + 1);
+			for (size_t i = 0, last = 0; i < nbuckets; i++) {
+				bucket_start[i] = last;
+				while (last < keys_count && hash128_to_bucket(hashes[last]) == i) last++;
+			}
+			bucket_start[nbuckets] = keys_count;
+
+			// Each bucket is computed into its own builder; buckets are claimed
+			// dynamically, as split times are heavily skewed across buckets.
+			auto bucket_builders = vector<typename RiceBitVector<AT>::Builder>(nbuckets);
+			atomic<size_t> next_bucket(0);
+			auto thread_body = [&]() {
+				vector<uint64_t> bucket;
+				vector<uint32_t> unary;
+				for (;;) {
+					const size_t i = next_bucket.fetch_add(1, memory_order_relaxed);
+					if (i >= nbuckets) break;
+					if (bucket_start[i + 1] - bucket_start[i] <= 1) continue;
+					bucket.clear();
+					unary.clear();
+					for (size_t j = bucket_start[i]; j < bucket_start[i + 1]; j++) bucket.push_back(hashes[j].second);
+					recSplit(bucket, bucket_builders[i], unary);
+					bucket_builders[i].appendUnaryAll(unary);
+				}
+			};
+			vector<thread> threads;
+			for (size_t t = 0; t < num_threads; t++) threads.emplace_back(thread_body);
+			for (auto &t : threads) t.join();
+
+			// Merging the per-bucket builders in order makes the result
+			// bit-for-bit identical to a serial build.
+			for (size_t i = 0; i < nbuckets; i++) {
+				builder.appendBitsFrom(bucket_builders[i]);
+				ef_builder.add(bucket_start[i + 1], builder.getBits());
+			}
+		} else
 		for (size_t i = 0, last = 0; i < nbuckets; i++) {
 			vector<uint64_t> bucket;
 			for (; last < keys_count && hash128_to_bucket(hashes[last]) == i; last++) bucket.push_back(hashes[last].second);
 
-			const size_t s = bucket.size();
-			bucket_size_acc[i + 1] = bucket_size_acc[i] + s;
 			if (bucket.size() > 1) {
 				vector<uint32_t> unary;
 				recSplit(bucket, builder, unary);
 				builder.appendUnaryAll(unary);
 			}
-			bucket_pos_acc[i + 1] = builder.getBits();
+			ef_builder.add(last, builder.getBits());
 #ifdef MORESTATS
+			const size_t s = bucket.size();
 			auto upper_leaves = (s + _leaf - 1) / _leaf;
 			auto upper_height = ceil(log(upper_leaves) / log(2)); // TODO: check
 			auto upper_s = _leaf * pow(2, upper_height);
@@ -717,7 +1175,7 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 		}
 		builder.appendFixed(1, 1); // Sentinel (avoids checking for parts of size 1)
 		descriptors = builder.build();
-		ef = DoubleEF<AT>(vector<uint64_t>(bucket_size_acc.begin(), bucket_size_acc.end()), vector<uint64_t>(bucket_pos_acc.begin(), bucket_pos_acc.end()));
+		ef = ef_builder.build();
 
 #ifdef STATS
 		// Evaluation purposes only
@@ -804,7 +1262,7 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 #endif
 	}
 
-	friend ostream &operator<<(ostream &os, const RecSplit<LEAF_SIZE, AT> &rs) {
+	friend ostream &operator<<(ostream &os, const RecSplit<LEAF_SIZE, AT, Hasher> &rs) {
 		const size_t leaf_size = LEAF_SIZE;
 		os.write((char *)&leaf_size, sizeof(leaf_size));
 		os.write((char *)&rs.bucket_size, sizeof(rs.bucket_size));
@@ -814,7 +1272,7 @@ template <size_t LEAF_SIZE, util::AllocType AT = util::AllocType::MALLOC> class
 		return os;
 	}
 
-	friend istream &operator>>(istream &is, RecSplit<LEAF_SIZE, AT> &rs) {
+	friend istream &operator>>(istream &is, RecSplit<LEAF_SIZE, AT, Hasher> &rs) {
 		size_t leaf_size;
 		is.read((char *)&leaf_size, sizeof(leaf_size));
 		if (leaf_size != LEAF_SIZE) {
@@ -29,6 +29,7 @@
 #pragma once
 
 #include "../support/common.hpp"
+#include "../util/SpaceReport.hpp"
 #include "../util/Vector.hpp"
 #include <cstdint>
 #include <cstdio>
@@ -92,6 +93,32 @@ template <util::AllocType AT = util::AllocType::MALLOC> class RiceBitVector {
 			}
 		}
 
+		/** Appends the bits accumulated by another builder.
+		 *
+		 * The result is the same as appending to this builder, in order, the
+		 * fixed and unary parts appended to `other`, which makes it possible
+		 * to assemble independently built parts of a bit vector.
+		 *
+		 * @param other the builder whose bits will be appended.
+		 */
+		void appendBitsFrom(const Builder &other) {
+			if (other.bit_count == 0) return;
+			data.resize((((bit_count + other.bit_count + 7) / 8) + 7 + 7) / 8);
+
+			const uint64_t *src = &other.data;
+			const int used_bits = bit_count & 63;
+			uint64_t *append_ptr = &data + bit_count / 64;
+
+			// Bits beyond other.bit_count in the last source word are zero,
+			// so we can OR in whole words.
+			for (size_t i = 0; i < (other.bit_count + 63) / 64; i++) {
+				*append_ptr |= src[i] << used_bits;
+				if (used_bits != 0) *++append_ptr = src[i] >> (64 - used_bits);
+				else ++append_ptr;
+			}
+			bit_count += other.bit_count;
+		}
+
 		uint64_t getBits() { return bit_count; }
 
 		RiceBitVector<AT> build() {
@@ -102,6 +129,10 @@ template <util::AllocType AT = util::AllocType::MALLOC> class RiceBitVector {
 
   private:
 	util::Vector<uint64_t, AT> data;
+	util::Vector<uint64_t, AT> skips;
+
+	/** Sampling rate of the optional skip index, in words of the bit vector. */
+	static constexpr size_t SKIP_WORDS = 8;
 
 	friend std::ostream &operator<<(std::ostream &os, const RiceBitVector<AT> &rbv) {
 		os << rbv.data;
@@ -117,17 +148,61 @@ template <util::AllocType AT = util::AllocType::MALLOC> class RiceBitVector {
 	RiceBitVector() {}
 	RiceBitVector(util::Vector<uint64_t, AT> data) : data(std::move(data)) {}
 
+	/** Maps this bit vector over a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator and must
+	 * stay alive as long as this instance is in use.
+	 *
+	 * @param p a pointer inside a memory-mapped serialized image.
+	 * @return the pointer advanced past the data of this bit vector.
+	 */
+	uint64_t *map(uint64_t *p) {
+		const uint64_t nsize = *p++;
+		data.view(p, nsize);
+		return p + nsize;
+	}
+
 	size_t getBits() const { return data.size() * sizeof(uint64_t) * 8; }
 
+	/** Returns a structured report of the space used by this structure. */
+	util::SpaceReport spaceReport() const { return {"rice_bit_vector", sizeof(*this) * 8, AT, {util::spaceReport("data", data), util::spaceReport("skips", skips)}}; }
+
+	/** Prefaults the descriptor data in layout order. */
+	void warmup() const {
+		data.prefault();
+		skips.prefault();
+	}
+
+	/** Builds a sparse skip index over the unary terminators.
+	 *
+	 * The index samples the number of ones preceding every `SKIP_WORDS`-th
+	 * word of the bit vector (one word of index every 512 bits of data),
+	 * letting Reader::skipSubtree() jump directly to the word holding the
+	 * target terminator instead of scanning every word of the codes it
+	 * discards. The index is optional and is not serialized: it must be
+	 * rebuilt after deserialization or map() if desired.
+	 */
+	void buildSkipIndex() {
+		const size_t words = data.size();
+		skips.size(words / SKIP_WORDS + 1);
+		uint64_t c = 0;
+		for (size_t i = 0; i < words; i++) {
+			if ((i & (SKIP_WORDS - 1)) == 0) skips[i / SKIP_WORDS] = c;
+			c += nu(data[i]);
+		}
+		if ((words & (SKIP_WORDS - 1)) == 0) skips[words / SKIP_WORDS] = c;
+	}
+
 	class Reader {
 		size_t curr_fixed_offset = 0;
 		uint64_t curr_window_unary = 0;
 		uint64_t *curr_ptr_unary;
 		int valid_lower_bits_unary = 0;
 		util::Vector<uint64_t, AT> &data;
+		const util::Vector<uint64_t, AT> &skips;
 
 	  public:
-		Reader(util::Vector<uint64_t, AT> &data) : data(data) {}
+		Reader(util::Vector<uint64_t, AT> &data, const util::Vector<uint64_t, AT> &skips) : data(data), skips(skips) {}
 
 		uint64_t readNext(const int log2golomb) {
 			uint64_t result = 0;
@@ -161,6 +236,36 @@ template <util::AllocType AT = util::AllocType::MALLOC> class RiceBitVector {
 		void skipSubtree(const size_t nodes, const size_t fixed_len) {
 			assert(nodes > 0);
 			size_t missing = nodes, cnt;
+
+			if (skips.size() != 0 && missing >= SKIP_WORDS * 64 && (cnt = nu(curr_window_unary)) < missing) {
+				// The skip index locates the word holding the target terminator
+				// in logarithmic time instead of popcounting every word up to it.
+				missing -= cnt;
+				const size_t w = curr_ptr_unary - &data;
+				uint64_t rank = skips[w / SKIP_WORDS]; // Ones before word w
+				for (size_t i = w & ~(SKIP_WORDS - 1); i < w; i++) rank += nu(data[i]);
+				const uint64_t target = rank + missing;
+
+				// The largest block whose cumulative count is below the target
+				size_t lo = w / SKIP_WORDS, hi = skips.size() - 1;
+				while (lo < hi) {
+					const size_t mid = (lo + hi + 1) / 2;
+					if (skips[mid] < target) lo = mid;
+					else hi = mid - 1;
+				}
+
+				size_t i = lo == w / SKIP_WORDS ? w : lo * SKIP_WORDS;
+				uint64_t c = lo == w / SKIP_WORDS ? rank : skips[lo];
+				for (uint64_t ones; c + (ones = nu(data[i])) < target; i++) c += ones;
+
+				cnt = select64(data[i], target - c - 1);
+				curr_ptr_unary = &data + i + 1;
+				curr_window_unary = data[i] >> cnt >> 1;
+				valid_lower_bits_unary = 63 - cnt;
+				curr_fixed_offset += fixed_len;
+				return;
+			}
+
 			while ((cnt = nu(curr_window_unary)) < missing) {
 				curr_window_unary = *(curr_ptr_unary++);
 				missing -= cnt;
@@ -184,7 +289,10 @@ template <util::AllocType AT = util::AllocType::MALLOC> class RiceBitVector {
 		}
 	};
 
-	Reader reader() { return Reader(data); }
+	/** Prefetches the cache line holding a given bit position of the descriptor data. */
+	void prefetch(const size_t bit_pos) const { __builtin_prefetch((uint8_t *)&data + bit_pos / 8); }
+
+	Reader reader() { return Reader(data, skips); }
 };
 
 } // namespace sux::function
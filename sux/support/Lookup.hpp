@@ -0,0 +1,159 @@
+/*
+ * Sux: Succinct data structures
+ *
+ * Copyright (C) 2007-2020 Sebastiano Vigna
+ *
+ *  This library is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as published by the Free
+ *  Software Foundation; either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * Under Section 7 of GPL version 3, you are granted additional permissions
+ * described in the GCC Runtime Library Exception, version 3.1, as published by
+ * the Free Software Foundation.
+ *
+ * You should have received a copy of the GNU General Public License and a copy of
+ * the GCC Runtime Library Exception along with this program; see the files
+ * COPYING3 and COPYING.RUNTIME respectively.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine)
+#error "Lookup.hpp requires C++20 coroutines (compile with -std=c++20)"
+#endif
+
+#include <algorithm>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <utility>
+#include <vector>
+
+namespace sux {
+
+/** A suspendable lookup, used to interleave the cache misses of
+ * independent queries on the same thread.
+ *
+ * The batched methods of this library overlap the memory accesses of
+ * homogeneous query streams, but they cannot mix queries on different
+ * structures. A Lookup is a coroutine that issues a prefetch and suspends
+ * at each potential cache miss (see prefetched()); a round-robin driver
+ * such as interleave() keeps a couple dozen of them in flight, so while
+ * one lookup waits for memory the others make progress, whatever
+ * structure each of them is querying.
+ *
+ * Lookups are lazy (nothing runs until the first resume()), movable and
+ * single-owner; the methods returning them are available only when the
+ * library is compiled as C++20 or later.
+ *
+ * @tparam T the result type of the lookup.
+ */
+template <typename T> class [[nodiscard]] Lookup {
+  public:
+	struct promise_type {
+		T value;
+		Lookup get_return_object() { return Lookup(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() const noexcept { return {}; }
+		std::suspend_always final_suspend() const noexcept { return {}; }
+		void return_value(T v) { value = v; }
+		void unhandled_exception() { std::terminate(); }
+	};
+
+	Lookup() = default;
+	Lookup(Lookup &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+	Lookup &operator=(Lookup &&other) noexcept {
+		if (handle) handle.destroy();
+		handle = std::exchange(other.handle, {});
+		return *this;
+	}
+	Lookup(const Lookup &) = delete;
+	Lookup &operator=(const Lookup &) = delete;
+	~Lookup() {
+		if (handle) handle.destroy();
+	}
+
+	/** Returns true if this object owns a coroutine. */
+	explicit operator bool() const { return bool(handle); }
+
+	/** Runs the lookup up to its next suspension point (or to completion). */
+	void resume() { handle.resume(); }
+
+	/** Returns true if the lookup has completed. */
+	bool done() const { return handle.done(); }
+
+	/** Returns the result; the lookup must be done(). */
+	T result() const { return handle.promise().value; }
+
+  private:
+	explicit Lookup(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+	std::coroutine_handle<promise_type> handle;
+};
+
+/** Issues a prefetch for the given address and returns an awaitable
+ * suspending the lookup, so the access that needs the address runs after
+ * the driver has given other lookups a chance to cover the miss.
+ *
+ * When several independent addresses are needed by the same access,
+ * prefetch the others with `__builtin_prefetch` and `co_await` only the
+ * last one, paying a single suspension.
+ */
+inline std::suspend_always prefetched(const void *const address) {
+	__builtin_prefetch(address);
+	return {};
+}
+
+/** Runs a stream of lookups, keeping a window of them in flight.
+ *
+ * The lookups are resumed round-robin: each suspension (see prefetched())
+ * hands control to the next lookup in the window, so the cache misses of
+ * up to `window` lookups are in flight at once. On dependent-load chains
+ * much larger than the cache this is several times faster than running
+ * the lookups one by one, and the lookups may query different structures.
+ *
+ * @param n the number of lookups.
+ * @param make a function returning, for each index from 0 to `n`
+ * (excluded), the corresponding Lookup.
+ * @param out an array of `n` elements receiving the results.
+ * @param window the number of lookups kept in flight.
+ */
+template <typename T, typename Make> void interleave(const size_t n, Make make, T *const out, const size_t window = 16) {
+	if (n == 0) return;
+	const size_t w = std::max(size_t(1), std::min(window, n));
+	std::vector<Lookup<T>> slot(w);
+	std::vector<size_t> index(w);
+
+	size_t next = 0, active = 0;
+	for (; next < w; next++, active++) {
+		index[next] = next;
+		slot[next] = make(next);
+	}
+
+	while (active != 0) {
+		for (size_t s = 0; s < w; s++) {
+			if (!slot[s]) continue;
+			slot[s].resume();
+			if (slot[s].done()) {
+				out[index[s]] = slot[s].result();
+				if (next < n) {
+					index[s] = next;
+					slot[s] = make(next++);
+				} else {
+					slot[s] = Lookup<T>();
+					active--;
+				}
+			}
+		}
+	}
+}
+
+} // namespace sux
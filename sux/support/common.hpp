@@ -37,6 +37,9 @@
 
 #if defined(__x86_64__)
 #include <x86intrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#include <cpuid.h>
+#endif
 #endif
 
 // Macro stringification
@@ -335,11 +338,135 @@ inline void bitwrite_inc(void *const word, int from, int length, uint64_t inc) {
 	}
 }
 
+/** Extracts consecutive equal-width bit fields into an array.
+ * @param word a bit array.
+ * @param from starting bit index of the first field.
+ * @param length width of a field (from 1 up to 64).
+ * @param out an array of `n` elements receiving the fields.
+ * @param n the number of fields.
+ *
+ * Extracts the fields in the bit ranges `[from + i * length, from + (i + 1) * length)`
+ * into `out[i]`. The bit array must extend at least to the 64-bit word
+ * containing the last bit of the last field.
+ */
+inline void bitread_bulk_fallback(const void *const word, const uint64_t from, const int length, uint64_t *const out, const size_t n) {
+	const uint64_t *const w = static_cast<const uint64_t *>(word);
+	uint64_t b = from;
+	for (size_t i = 0; i < n; i++, b += length) out[i] = bitread(w + b / 64, b % 64, length);
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+/** See bitread_bulk_fallback(). Fields of up to 57 bits always fit in one
+ * byte-granular unaligned 8-byte load, so each lane gathers the load
+ * containing its field, shifts it by the residual bit offset (variable
+ * shifts, one per lane) and masks. A load can touch up to seven bytes
+ * beyond its field; fields too close to the end of the word containing the
+ * last bit are left to the scalar kernel so no load overruns the array. */
+__attribute__((target("avx2"))) inline void bitread_bulk_avx2(const void *const word, const uint64_t from, const int length, uint64_t *const out, const size_t n) {
+	size_t i = 0;
+	const uint64_t total = (from + n * uint64_t(length) + 63) / 64 * 64;
+	if (length <= 57 && total >= from + 64) {
+		const size_t safe = min(n, size_t((total - 64 - from) / length + 1));
+		__m256i b = _mm256_add_epi64(_mm256_set1_epi64x(from), _mm256_setr_epi64x(0, length, 2 * length, 3 * length));
+		const __m256i step = _mm256_set1_epi64x(4 * uint64_t(length));
+		const __m256i vmask = _mm256_set1_epi64x(-1ULL >> (64 - length));
+		for (; i + 4 <= safe; i += 4) {
+			const __m256i gathered = _mm256_i64gather_epi64(reinterpret_cast<const long long *>(word), _mm256_srli_epi64(b, 3), 1);
+			const __m256i shifted = _mm256_srlv_epi64(gathered, _mm256_and_si256(b, _mm256_set1_epi64x(7)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_and_si256(shifted, vmask));
+			b = _mm256_add_epi64(b, step);
+		}
+	}
+	bitread_bulk_fallback(word, from + i * uint64_t(length), length, out + i, n - i);
+}
+
+/** See bitread_bulk_avx2(); same kernel, eight fields per iteration. */
+__attribute__((target("avx512f"))) inline void bitread_bulk_avx512(const void *const word, const uint64_t from, const int length, uint64_t *const out, const size_t n) {
+	size_t i = 0;
+	const uint64_t total = (from + n * uint64_t(length) + 63) / 64 * 64;
+	if (length <= 57 && total >= from + 64) {
+		const size_t safe = min(n, size_t((total - 64 - from) / length + 1));
+		__m512i b = _mm512_add_epi64(_mm512_set1_epi64(from), _mm512_setr_epi64(0, length, 2 * length, 3 * length, 4 * length, 5 * length, 6 * length, 7 * length));
+		const __m512i step = _mm512_set1_epi64(8 * uint64_t(length));
+		const __m512i vmask = _mm512_set1_epi64(-1ULL >> (64 - length));
+		for (; i + 8 <= safe; i += 8) {
+			const __m512i gathered = _mm512_i64gather_epi64(_mm512_srli_epi64(b, 3), word, 1);
+			const __m512i shifted = _mm512_srlv_epi64(gathered, _mm512_and_epi64(b, _mm512_set1_epi64(7)));
+			_mm512_storeu_si512(out + i, _mm512_and_epi64(shifted, vmask));
+			b = _mm512_add_epi64(b, step);
+		}
+	}
+	bitread_bulk_fallback(word, from + i * uint64_t(length), length, out + i, n - i);
+}
+
+/** Extracts consecutive equal-width bit fields into an array (see
+ * bitread_bulk_fallback() for the contract).
+ *
+ * The kernel is chosen at run time on the first invocation, so a generic
+ * binary still uses gathers and variable shifts on hosts that have them.
+ */
+inline void bitread_bulk(const void *const word, const uint64_t from, const int length, uint64_t *const out, const size_t n) {
+	static void (*const impl)(const void *const, const uint64_t, const int, uint64_t *const, const size_t) =
+		__builtin_cpu_supports("avx512f") ? bitread_bulk_avx512 : (__builtin_cpu_supports("avx2") ? bitread_bulk_avx2 : bitread_bulk_fallback);
+	impl(word, from, length, out, n);
+}
+#else
+inline void bitread_bulk(const void *const word, const uint64_t from, const int length, uint64_t *const out, const size_t n) { bitread_bulk_fallback(word, from, length, out, n); }
+#endif
+
+/** Writes an array as consecutive equal-width bit fields (the scatter
+ * counterpart of bitread_bulk()).
+ * @param word a bit array.
+ * @param from starting bit index of the first field.
+ * @param length width of a field (from 1 up to 64).
+ * @param val an array of `n` field values; bits beyond `length` are ignored.
+ * @param n the number of fields.
+ *
+ * The fields are packed in an accumulator and emitted one full word at a
+ * time, so only the first and last touched words are read back (a SIMD
+ * scatter would be incorrect here: fields narrower than a byte make
+ * adjacent lanes store to the same addresses). Bits of the array below
+ * `from` and past the last field are preserved.
+ */
+inline void bitwrite_bulk(void *const word, const uint64_t from, const int length, const uint64_t *const val, const size_t n) {
+	if (n == 0) return;
+	uint64_t *w = static_cast<uint64_t *>(word) + from / 64;
+	int bit = from % 64;
+	const uint64_t mask = -1ULL >> (64 - length);
+	uint64_t cur = bit ? *w & (-1ULL >> (64 - bit)) : 0;
+	for (size_t i = 0; i < n; i++) {
+		const uint64_t v = val[i] & mask;
+		cur |= v << bit;
+		bit += length;
+		if (bit >= 64) {
+			*w++ = cur;
+			bit -= 64;
+			cur = bit ? v >> (length - bit) : 0;
+		}
+	}
+	if (bit) *w = (*w & (-1ULL << bit)) | cur;
+}
+
 /** Count the number of 1-bits in a word.
  * @param word binary word.
  *
+ * When the binary is not compiled for a target with the `popcnt`
+ * instruction, the kernel is chosen at run time on the first invocation,
+ * so a generic binary still uses the native instruction on hosts that
+ * have it.
  */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(__POPCNT__)
+__attribute__((target("popcnt"))) inline int nu_popcnt(uint64_t word) { return __builtin_popcountll(word); }
+
+inline int nu_fallback(uint64_t word) { return __builtin_popcountll(word); }
+
+inline int nu(uint64_t word) {
+	static int (*const impl)(uint64_t) = __builtin_cpu_supports("popcnt") ? nu_popcnt : nu_fallback;
+	return impl(word);
+}
+#else
 inline int nu(uint64_t word) { return __builtin_popcountll(word); }
+#endif
 
 /** Return a number rounded to the desired power of two multiple.
  * @param number value to round up.
@@ -372,8 +499,7 @@ inline size_t updroot(size_t j, size_t n) { return n & (SIZE_MAX << lambda((j ^
  * [4] Facebook Folly library: https://github.com/facebook/folly
  *
  */
-inline uint64_t select64(uint64_t x, uint64_t k) {
-#ifndef __haswell__
+inline uint64_t select64_broadword(uint64_t x, uint64_t k) {
 	constexpr uint64_t kOnesStep4 = 0x1111111111111111ULL;
 	constexpr uint64_t kOnesStep8 = 0x0101010101010101ULL;
 	constexpr uint64_t kLAMBDAsStep8 = 0x80ULL * kOnesStep8;
@@ -389,7 +515,10 @@ inline uint64_t select64(uint64_t x, uint64_t k) {
 	uint64_t place = nu(geqKStep8) * 8;
 	uint64_t byteRank = k - (((byteSums << 8) >> place) & uint64_t(0xFF));
 	return place + kSelectInByte[((x >> place) & 0xFF) | (byteRank << 8)];
-#elif defined(__GNUC__) || defined(__clang__)
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+inline uint64_t select64_pdep(uint64_t x, uint64_t k) {
 	// GCC and Clang won't inline the intrinsics.
 	uint64_t result = uint64_t(1) << k;
 
@@ -399,6 +528,47 @@ inline uint64_t select64(uint64_t x, uint64_t k) {
 		: "r"(x));
 
 	return result;
+}
+
+/** Returns true if the host executes `pdep` in hardware.
+ *
+ * On AMD Zen and Zen 2 (family 17h) `pdep` is microcoded and much slower
+ * than the broadword selection kernel, so BMI2 support alone is not enough.
+ */
+inline bool has_fast_pdep() {
+	if (!__builtin_cpu_supports("bmi2")) return false;
+	unsigned eax, ebx, ecx, edx;
+	if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) return false;
+	if (ebx == 0x68747541 && edx == 0x69746e65 && ecx == 0x444d4163) { // "AuthenticAMD"
+		if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+		const unsigned family = ((eax >> 8) & 0xF) + ((eax >> 20) & 0xFF);
+		if (family == 0x17) return false;
+	}
+	return true;
+}
+#endif
+
+/** Returns the index of the k-th 1-bit in the 64-bit word x.
+ * @param x 64-bit word.
+ * @param k 0-based rank (`k = 0` returns the position of the first 1-bit).
+ *
+ * Unless the `pdep`-based kernel is forced at compile time by defining
+ * `__haswell__`, the kernel is chosen at run time on the first invocation
+ * (see has_fast_pdep()).
+ */
+inline uint64_t select64(uint64_t x, uint64_t k) {
+#ifndef __haswell__
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+	// The kernel is chosen at run time on the first invocation, so the same
+	// binary uses `pdep` on hosts where it is fast and the broadword
+	// algorithm everywhere else.
+	static uint64_t (*const impl)(uint64_t, uint64_t) = has_fast_pdep() ? select64_pdep : select64_broadword;
+	return impl(x, k);
+#else
+	return select64_broadword(x, k);
+#endif
+#elif defined(__GNUC__) || defined(__clang__)
+	return select64_pdep(x, k);
 #else
 	return _tzcnt_u64(_pdep_u64(1ULL << k, x));
 #endif
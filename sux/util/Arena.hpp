@@ -0,0 +1,157 @@
+/*
+ * Sux: Succinct data structures
+ *
+ * Copyright (C) 2019-2020 Stefano Marchini
+ *
+ *  This library is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as published by the Free
+ *  Software Foundation; either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * Under Section 7 of GPL version 3, you are granted additional permissions
+ * described in the GCC Runtime Library Exception, version 3.1, as published by
+ * the Free Software Foundation.
+ *
+ * You should have received a copy of the GNU General Public License and a copy of
+ * the GCC Runtime Library Exception along with this program; see the files
+ * COPYING3 and COPYING.RUNTIME respectively.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <assert.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace sux::util {
+
+/** A bump-pointer suballocator over a caller-provided buffer.
+ *
+ * An arena hands out consecutive slices of a single buffer, so many small
+ * structures can share one allocation instead of each owning a `malloc()`
+ * or `mmap()` region: there is no per-instance slack, and structures built
+ * one after the other end up contiguous in memory, which improves locality
+ * when they are iterated in the same order.
+ *
+ * Individual slices are never returned to the arena, except for the most
+ * recently allocated one, which can be freed or resized in place by moving
+ * the bump pointer; everything else is reclaimed at once with reset() or
+ * by discarding the buffer. The caller retains ownership of the buffer,
+ * which must outlive every structure allocated from the arena.
+ *
+ * Vectors instantiated with ::ARENA bind at their first allocation to the
+ * arena installed on the current thread with Arena::Use:
+ *
+ *     Arena arena(buffer, length);
+ *     Arena::Use use(arena);
+ *     FenwickByteL<64, ARENA> tree(sequence, size); // suballocated
+ */
+
+class Arena {
+	char *start, *cur, *limit;
+
+  public:
+	/** Creates an arena over a given buffer.
+	 *
+	 * @param buffer a pointer to the buffer (8-byte alignment is enforced internally).
+	 * @param length the length of the buffer, in bytes.
+	 */
+	Arena(void *buffer, size_t length) {
+		start = cur = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(buffer) + 7) & ~uintptr_t(7));
+		limit = static_cast<char *>(buffer) + length;
+	}
+
+	// Delete copy operators: allocations hold pointers into this arena.
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	/** Allocates a given number of bytes by bumping the arena pointer.
+	 *
+	 * @param space the number of bytes to allocate.
+	 * @return a pointer to the allocated (8-byte aligned) slice.
+	 */
+	void *alloc(size_t space) {
+		char *const mem = cur;
+		assert(mem + aligned(space) <= limit && "arena exhausted");
+		cur += aligned(space);
+		return mem;
+	}
+
+	/** Resizes a previously allocated slice.
+	 *
+	 * The most recently allocated slice is resized in place by moving the
+	 * arena pointer; any other slice is copied into a fresh allocation and
+	 * its old space is reclaimed only at reset().
+	 *
+	 * @param mem a pointer returned by alloc() or realloc().
+	 * @param old_space the current size of the slice, in bytes.
+	 * @param space the desired new size, in bytes.
+	 * @return a pointer to the resized slice.
+	 */
+	void *realloc(void *mem, size_t old_space, size_t space) {
+		if (static_cast<char *>(mem) + aligned(old_space) == cur) {
+			assert(static_cast<char *>(mem) + aligned(space) <= limit && "arena exhausted");
+			cur = static_cast<char *>(mem) + aligned(space);
+			return mem;
+		}
+		if (aligned(space) <= aligned(old_space)) return mem;
+		void *const result = alloc(space);
+		memcpy(result, mem, old_space);
+		return result;
+	}
+
+	/** Frees a previously allocated slice.
+	 *
+	 * The most recently allocated slice is reclaimed by moving the arena
+	 * pointer back; freeing any other slice is a no-op.
+	 *
+	 * @param mem a pointer returned by alloc() or realloc().
+	 * @param space the current size of the slice, in bytes.
+	 */
+	void free(void *mem, size_t space) {
+		if (static_cast<char *>(mem) + aligned(space) == cur) cur = static_cast<char *>(mem);
+	}
+
+	/** Reclaims the whole buffer, invalidating every structure allocated from this arena. */
+	void reset() { cur = start; }
+
+	/** Returns the number of bytes allocated so far. */
+	size_t used() const { return cur - start; }
+
+	/** Returns the length of the buffer, in bytes. */
+	size_t capacity() const { return limit - start; }
+
+	/** Returns a reference to the arena installed on the current thread (initially, `nullptr`). */
+	static Arena *&current() {
+		static thread_local Arena *current = nullptr;
+		return current;
+	}
+
+	/** Installs an arena on the current thread for the lifetime of this object.
+	 *
+	 * Scopes nest: at destruction, the previously installed arena (if any)
+	 * is restored.
+	 */
+	class Use {
+		Arena *const previous;
+
+	  public:
+		Use(Arena &arena) : previous(current()) { current() = &arena; }
+		~Use() { current() = previous; }
+	};
+
+  private:
+	static size_t aligned(size_t space) { return (space + 7) & ~size_t(7); }
+};
+
+} // namespace sux::util
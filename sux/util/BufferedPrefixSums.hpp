@@ -0,0 +1,172 @@
+/*
+ * Sux: Succinct data structures
+ *
+ * Copyright (C) 2007-2020 Sebastiano Vigna
+ *
+ *  This library is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as published by the Free
+ *  Software Foundation; either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * Under Section 7 of GPL version 3, you are granted additional permissions
+ * described in the GCC Runtime Library Exception, version 3.1, as published by
+ * the Free Software Foundation.
+ *
+ * You should have received a copy of the GNU General Public License and a copy of
+ * the GCC Runtime Library Exception along with this program; see the files
+ * COPYING3 and COPYING.RUNTIME respectively.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "SearchablePrefixSums.hpp"
+#include "Vector.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace sux::util {
+
+/** A write-buffering decorator for searchable prefix-sum structures.
+ *
+ * Every add() on a Fenwick tree walks a full root-to-leaf update path;
+ * when ingestion concentrates millions of increments in small index
+ * ranges, most of those walks touch the same nodes over and over. This
+ * decorator absorbs increments into a small open-addressing delta table
+ * (BUFFER entries, so cache resident for the default size) and merges
+ * them into the underlying tree only when the table fills up, one add()
+ * per distinct index in increasing order, so repeated and nearby
+ * increments share their tree path.
+ *
+ * prefix() consults the delta table with a linear scan, which bounds its
+ * extra cost by the table size; find(), compFind(), push() and pop()
+ * merge the pending deltas first and then delegate, so they remain exact
+ * at the price of an amortized flush. Mixed workloads can size BUFFER
+ * down to shift the balance from ingest throughput to query cost.
+ *
+ * @tparam SPS the underlying sux::util::SearchablePrefixSums implementation.
+ * @tparam BUFFER the number of entries of the delta table (a power of two).
+ */
+template <class SPS, size_t BUFFER = 1024> class BufferedPrefixSums : public SearchablePrefixSums {
+  private:
+	static_assert(BUFFER != 0 && (BUFFER & (BUFFER - 1)) == 0, "The delta table size must be a power of two");
+
+	SPS tree;
+	size_t index[BUFFER] = {}; // Zero marks an empty slot (valid indices start from 1)
+	int64_t delta[BUFFER] = {};
+	size_t fill = 0;
+
+	static size_t hash(size_t idx) { return (idx * UINT64_C(0x9E3779B97F4A7C15)) >> 32 & (BUFFER - 1); }
+
+  public:
+	/** Creates a new instance decorating an empty tree. */
+	BufferedPrefixSums() {}
+
+	/** Creates a new instance decorating a tree built over a given sequence of values.
+	 *
+	 * @param sequence a sequence of nonnegative integers (see the underlying implementation for bounds).
+	 * @param size the number of elements in the sequence.
+	 */
+	BufferedPrefixSums(uint64_t sequence[], size_t size) : tree(sequence, size) {}
+
+	/** Creates a new instance decorating a given tree. */
+	BufferedPrefixSums(SPS &&tree) : tree(std::move(tree)) {}
+
+	/** Merges all pending deltas into the underlying tree. */
+	void flush() {
+		if (fill == 0) return;
+		// Merging in increasing index order makes the update paths share
+		// their upper tree nodes in cache.
+		std::pair<size_t, int64_t> pending[BUFFER];
+		size_t n = 0;
+		for (size_t i = 0; i < BUFFER; i++)
+			if (index[i] != 0) {
+				pending[n++] = {index[i], delta[i]};
+				index[i] = 0;
+				delta[i] = 0;
+			}
+		std::sort(pending, pending + n);
+		for (size_t i = 0; i < n; i++)
+			if (pending[i].second != 0) tree.add(pending[i].first, pending[i].second);
+		fill = 0;
+	}
+
+	virtual void add(size_t idx, int64_t c) {
+		assert(idx != 0);
+		size_t slot = hash(idx);
+		while (index[slot] != 0 && index[slot] != idx) slot = (slot + 1) & (BUFFER - 1);
+		if (index[slot] == 0) {
+			// Flush at half load so probe sequences stay short.
+			if (fill == BUFFER / 2) {
+				flush();
+				return add(idx, c);
+			}
+			index[slot] = idx;
+			fill++;
+		}
+		delta[slot] += c;
+	}
+
+	using SearchablePrefixSums::compFind;
+	using SearchablePrefixSums::find;
+	using SearchablePrefixSums::prefix;
+
+	virtual uint64_t prefix(size_t length) {
+		int64_t pending = 0;
+		for (size_t i = 0; i < BUFFER; i++) pending += delta[i] * (index[i] != 0 && index[i] <= length);
+		return tree.prefix(length) + pending;
+	}
+
+	virtual size_t find(uint64_t *val) {
+		flush();
+		return tree.find(val);
+	}
+
+	virtual size_t compFind(uint64_t *val) {
+		flush();
+		return tree.compFind(val);
+	}
+
+	virtual void push(uint64_t val) {
+		flush();
+		tree.push(val);
+	}
+
+	virtual void pop() {
+		flush();
+		tree.pop();
+	}
+
+	virtual size_t size() const { return tree.size(); }
+
+	virtual size_t bitCount() const { return tree.bitCount() - sizeof(tree) * 8 + sizeof(*this) * 8; }
+
+	friend std::ostream &operator<<(std::ostream &os, const BufferedPrefixSums<SPS, BUFFER> &bf) {
+		os << bf.tree;
+		const uint64_t fill = bf.fill;
+		os.write((char *)&fill, sizeof(uint64_t));
+		os.write((char *)bf.index, sizeof(bf.index));
+		os.write((char *)bf.delta, sizeof(bf.delta));
+		return os;
+	}
+
+	friend std::istream &operator>>(std::istream &is, BufferedPrefixSums<SPS, BUFFER> &bf) {
+		is >> bf.tree;
+		uint64_t fill;
+		is.read((char *)&fill, sizeof(uint64_t));
+		bf.fill = fill;
+		is.read((char *)bf.index, sizeof(bf.index));
+		is.read((char *)bf.delta, sizeof(bf.delta));
+		return is;
+	}
+};
+
+} // namespace sux::util
@@ -29,6 +29,7 @@
 #pragma once
 
 #include "SearchablePrefixSums.hpp"
+#include "SpaceReport.hpp"
 #include "Vector.hpp"
 #include <cstring>
 
@@ -70,6 +71,34 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickBitF : public Search
 			for (size_t idx = m; idx <= Size; idx += m) addToPartialFrequency(idx, getPartialFrequency(idx - m / 2));
 	}
 
+	/** Builds a tree over a given sequence in a single streaming pass.
+	 *
+	 * The result is identical to the one produced by the constructor, but
+	 * each node is computed from a running prefix sum and written exactly
+	 * once, in increasing position order, so both the input and the tree
+	 * are traversed strictly sequentially.
+	 *
+	 * @param sequence a sequence of nonnegative integers smaller than or equal to the template parameter `BOUND`.
+	 * @param size the number of elements in the sequence.
+	 */
+	static FenwickBitF bulkBuild(const uint64_t sequence[], size_t size) {
+		FenwickBitF tree;
+		tree.Size = size;
+		tree.Tree.size((first_bit_after(size) + END_PADDING + 7) >> 3);
+
+		uint64_t cum = 0;
+		uint64_t cumAt[65] = {}; // Prefix sum at the last multiple of each power of two.
+		for (size_t idx = 1; idx <= size; idx++) {
+			cum += sequence[idx - 1];
+			const int h = rho(idx);
+			tree.addToPartialFrequency(idx, cum - cumAt[h + 1]);
+			for (int j = 0; j <= h; j++) cumAt[j] = cum;
+		}
+
+		return tree;
+	}
+
+	using SearchablePrefixSums::prefix;
 	virtual uint64_t prefix(size_t idx) {
 		uint64_t sum = 0;
 
@@ -81,6 +110,35 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickBitF : public Search
 		return sum;
 	}
 
+	virtual void prefix(const size_t *idx, uint64_t *out, size_t n) {
+		// Interleaving the traversals lets the cache misses of several
+		// tree paths overlap instead of paying each one in full.
+		constexpr size_t INTERLEAVE = 16;
+		for (size_t base = 0; base < n; base += INTERLEAVE) {
+			const size_t batch = min(INTERLEAVE, n - base);
+			size_t curr[INTERLEAVE];
+
+			for (size_t i = 0; i < batch; i++) {
+				curr[i] = idx[base + i];
+				out[base + i] = 0;
+				if (curr[i] != 0) prefetchPartialFrequency(curr[i]);
+			}
+
+			for (bool again = true; again;) {
+				again = false;
+				for (size_t i = 0; i < batch; i++) {
+					if (curr[i] == 0) continue;
+					out[base + i] += getPartialFrequency(curr[i]);
+					curr[i] = clear_rho(curr[i]);
+					if (curr[i] != 0) {
+						prefetchPartialFrequency(curr[i]);
+						again = true;
+					}
+				}
+			}
+		}
+	}
+
 	virtual void add(size_t idx, int64_t inc) {
 		while (idx <= Size) {
 			addToPartialFrequency(idx, inc);
@@ -106,6 +164,35 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickBitF : public Search
 		return node;
 	}
 
+	virtual void find(const uint64_t *val, size_t *out, size_t n) {
+		constexpr size_t INTERLEAVE = 16;
+		for (size_t base = 0; base < n; base += INTERLEAVE) {
+			const size_t batch = min(INTERLEAVE, n - base);
+			size_t node[INTERLEAVE];
+			uint64_t excess[INTERLEAVE];
+
+			for (size_t i = 0; i < batch; i++) {
+				node[i] = 0;
+				excess[i] = val[base + i];
+			}
+
+			for (size_t m = mask_lambda(Size); m != 0; m >>= 1) {
+				for (size_t i = 0; i < batch; i++) {
+					if (node[i] + m <= Size) {
+						const uint64_t value = getPartialFrequency(node[i] + m);
+						if (excess[i] >= value) {
+							node[i] += m;
+							excess[i] -= value;
+						}
+					}
+					if (m > 1 && node[i] + m / 2 <= Size) prefetchPartialFrequency(node[i] + m / 2);
+				}
+			}
+
+			for (size_t i = 0; i < batch; i++) out[base + i] = node[i];
+		}
+	}
+
 	using SearchablePrefixSums::compFind;
 	virtual size_t compFind(uint64_t *val) {
 		size_t node = 0;
@@ -125,6 +212,35 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickBitF : public Search
 		return node;
 	}
 
+	virtual void compFind(const uint64_t *val, size_t *out, size_t n) {
+		constexpr size_t INTERLEAVE = 16;
+		for (size_t base = 0; base < n; base += INTERLEAVE) {
+			const size_t batch = min(INTERLEAVE, n - base);
+			size_t node[INTERLEAVE];
+			uint64_t excess[INTERLEAVE];
+
+			for (size_t i = 0; i < batch; i++) {
+				node[i] = 0;
+				excess[i] = val[base + i];
+			}
+
+			for (size_t m = mask_lambda(Size); m != 0; m >>= 1) {
+				for (size_t i = 0; i < batch; i++) {
+					if (node[i] + m <= Size) {
+						const uint64_t value = (BOUND << rho(node[i] + m)) - getPartialFrequency(node[i] + m);
+						if (excess[i] >= value) {
+							node[i] += m;
+							excess[i] -= value;
+						}
+					}
+					if (m > 1 && node[i] + m / 2 <= Size) prefetchPartialFrequency(node[i] + m / 2);
+				}
+			}
+
+			for (size_t i = 0; i < batch; i++) out[base + i] = node[i];
+		}
+	}
+
 	virtual void push(uint64_t val) {
 		Tree.resize((first_bit_after(++Size) + END_PADDING + 7) >> 3);
 		addToPartialFrequency(Size, val);
@@ -152,11 +268,34 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickBitF : public Search
 
 	virtual size_t bitCount() const { return Tree.bitCount() - sizeof(Tree) * 8 + sizeof(*this) * 8; }
 
+	/** Returns a structured report of the space used by this structure. */
+	SpaceReport spaceReport() const { return {"fenwick_bitf", sizeof(*this) * 8, AT, {util::spaceReport("tree", Tree)}}; }
+
+	/** Maps this tree over a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator and must
+	 * stay alive as long as this instance is in use.
+	 *
+	 * @param p a pointer inside a memory-mapped serialized image.
+	 * @return the pointer advanced past the data of this tree.
+	 */
+	void *map(void *p) {
+		uint64_t nsize;
+		memcpy(&nsize, p, sizeof(uint64_t));
+		Size = nsize;
+		return Tree.map(static_cast<char *>(p) + sizeof(uint64_t));
+	}
+
   private:
 	inline static size_t holes(size_t idx) { return STARTING_OFFSET + (idx >> 14) * 64; }
 
 	inline static size_t first_bit_after(size_t idx) { return (BOUNDSIZE + 1) * idx - nu(idx) + holes(idx); }
 
+	inline void prefetchPartialFrequency(size_t idx) const {
+		idx--;
+		__builtin_prefetch(&Tree[((BOUNDSIZE + 1) * idx - nu(idx) + holes(idx)) / 8]);
+	}
+
 	inline uint64_t getPartialFrequency(size_t idx) const {
 		const uint64_t mask = (UINT64_C(1) << (BOUNDSIZE + rho(idx))) - 1;
 		idx--;
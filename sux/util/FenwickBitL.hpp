@@ -29,6 +29,7 @@
 #pragma once
 
 #include "SearchablePrefixSums.hpp"
+#include "SpaceReport.hpp"
 #include "Vector.hpp"
 
 namespace sux::util {
@@ -80,6 +81,36 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickBitL : public Search
 		}
 	}
 
+	/** Builds a tree over a given sequence in a single streaming pass.
+	 *
+	 * The result is identical to the one produced by the constructor, but
+	 * each node is computed from a running prefix sum and written exactly
+	 * once, with a sequential write stream per level, so the input is
+	 * traversed only once.
+	 *
+	 * @param sequence a sequence of nonnegative integers smaller than or equal to the template parameter `BOUND`.
+	 * @param size the number of elements in the sequence.
+	 */
+	static FenwickBitL bulkBuild(const uint64_t sequence[], size_t size) {
+		FenwickBitL tree;
+		tree.Size = size;
+		tree.Levels = size != 0 ? lambda(size) + 1 : 1;
+		tree.size(size ? size : 1);
+
+		uint64_t cum = 0;
+		uint64_t cumAt[65] = {}; // Prefix sum at the last multiple of each power of two.
+		for (size_t idx = 1; idx <= size; idx++) {
+			cum += sequence[idx - 1];
+			const int h = rho(idx);
+			const size_t highpos = (BOUNDSIZE + h) * (idx >> (h + 1));
+			bitwrite_inc(&tree.Tree[h][highpos / 8], highpos % 8, BOUNDSIZE + h, cum - cumAt[h + 1]);
+			for (int j = 0; j <= h; j++) cumAt[j] = cum;
+		}
+
+		return tree;
+	}
+
+	using SearchablePrefixSums::prefix;
 	virtual uint64_t prefix(size_t idx) {
 		uint64_t sum = 0;
 
@@ -211,6 +242,33 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickBitL : public Search
 		return ret;
 	}
 
+	/** Returns a structured report of the space used by this structure. */
+	SpaceReport spaceReport() const {
+		SpaceReport report{"fenwick_bitl", sizeof(*this) * 8, AT, {}};
+		for (size_t i = 0; i < 64; i++)
+			if (Tree[i].capacity() != 0) report.components.push_back(util::spaceReport("level" + std::to_string(i), Tree[i]));
+		return report;
+	}
+
+	/** Maps this tree over a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator and must
+	 * stay alive as long as this instance is in use.
+	 *
+	 * @param p a pointer inside a memory-mapped serialized image.
+	 * @return the pointer advanced past the data of this tree.
+	 */
+	void *map(void *p) {
+		uint64_t nsize, nlevels;
+		memcpy(&nsize, p, sizeof(uint64_t));
+		memcpy(&nlevels, static_cast<char *>(p) + sizeof(uint64_t), sizeof(uint64_t));
+		Size = nsize;
+		Levels = nlevels;
+		p = static_cast<char *>(p) + 2 * sizeof(uint64_t);
+		for (size_t i = 0; i < Levels; i++) p = Tree[i].map(p);
+		return p;
+	}
+
   private:
 	friend std::ostream &operator<<(std::ostream &os, const FenwickBitL<BOUND, AT> &ft) {
 		os.write((char *)&ft.Size, sizeof(uint64_t));
@@ -0,0 +1,262 @@
+/*
+ * Sux: Succinct data structures
+ *
+ * Copyright (C) 2007-2020 Sebastiano Vigna
+ *
+ *  This library is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as published by the Free
+ *  Software Foundation; either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * Under Section 7 of GPL version 3, you are granted additional permissions
+ * described in the GCC Runtime Library Exception, version 3.1, as published by
+ * the Free Software Foundation.
+ *
+ * You should have received a copy of the GNU General Public License and a copy of
+ * the GCC Runtime Library Exception along with this program; see the files
+ * COPYING3 and COPYING.RUNTIME respectively.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "FenwickBitF.hpp"
+#include "FenwickBitL.hpp"
+#include "FenwickByteF.hpp"
+#include "FenwickByteL.hpp"
+#include "FenwickFixedF.hpp"
+#include "FenwickFixedL.hpp"
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <memory>
+
+namespace sux::util {
+
+using namespace std;
+
+/** The six Fenwick tree layouts, in the order used by FenwickCostModel. */
+enum class FenwickLayout { FIXEDF, FIXEDL, BYTEF, BYTEL, BITF, BITL };
+
+/** A cost model selecting among the six Fenwick tree layouts.
+ *
+ * The right layout for a given workload depends on the tree size, on the
+ * element bound and on the mix of queries and updates: the fixed layouts
+ * have the cheapest node accesses, but the compressed layouts keep more of
+ * the tree in cache, so they win once the fixed tree outgrows it. Picking
+ * by rule of thumb can cost a small integer factor, so this class keeps a
+ * table of per-operation costs for each layout in three footprint classes
+ * (roughly: fits in core caches, fits in the last-level cache, misses to
+ * memory) and returns the layout minimizing the expected cost of a
+ * query/update mix.
+ *
+ * The table ships with conservative defaults; calibrate() replaces them
+ * with timings measured on the host, and the model can be serialized with
+ * the usual stream operators (or load()/store(), which add a file on top)
+ * so one calibration serves all later runs on the same machine.
+ *
+ * @tparam BOUND maximum representable value, as in the Fenwick trees.
+ */
+template <size_t BOUND> class FenwickCostModel {
+  public:
+	static constexpr size_t LAYOUTS = 6;
+	static constexpr size_t CLASSES = 3;
+
+  private:
+	static constexpr uint32_t VERSION = 1;
+	// One tree per footprint class is timed during calibration; the sizes
+	// are chosen so the fixed layout lands in the middle of each class.
+	static constexpr size_t CALIBRATION_SIZE[CLASSES] = {1 << 12, 1 << 17, 1 << 22};
+	// Class boundaries (in bytes of tree footprint): within core caches,
+	// within a typical last-level cache, missing to memory.
+	static constexpr size_t CLASS_BOUND[CLASSES - 1] = {256 * 1024, 16 * 1024 * 1024};
+
+	// Cost (in nanoseconds) of one prefix() and one add(), per footprint
+	// class and layout. The defaults encode the usual folklore: fixed
+	// layouts are cheapest while they fit in cache, compressed layouts
+	// take over when the tree misses to memory.
+	double query_ns[CLASSES][LAYOUTS] = {{5, 5, 7, 7, 9, 9}, {9, 8, 11, 10, 13, 12}, {60, 55, 45, 40, 38, 35}};
+	double update_ns[CLASSES][LAYOUTS] = {{5, 5, 8, 8, 12, 12}, {9, 8, 12, 11, 16, 15}, {60, 55, 50, 45, 48, 44}};
+
+	/** Approximate footprint (in bits per element) of a layout. */
+	static constexpr double footprint(const FenwickLayout layout) {
+		const double l = ceil_log2_plus1(BOUND);
+		switch (layout) {
+		case FenwickLayout::FIXEDF:
+		case FenwickLayout::FIXEDL:
+			return 64;
+		case FenwickLayout::BYTEF:
+		case FenwickLayout::BYTEL:
+			return (size_t(l) + 6 + 7) / 8 * 8;
+		default:
+			// Node width grows with the level, but level sizes halve.
+			return l + 2;
+		}
+	}
+
+	static size_t footprintClass(const size_t bytes) { return bytes < CLASS_BOUND[0] ? 0 : bytes < CLASS_BOUND[1] ? 1 : 2; }
+
+	template <template <size_t, AllocType> class Layout> void calibrateLayout(const size_t layout, const size_t ops) {
+		for (size_t cls = 0; cls < CLASSES; cls++) {
+			const size_t size = CALIBRATION_SIZE[cls];
+			uint64_t state = 0x9E3779B97F4A7C15 * (layout + 1);
+			const auto rnd = [&state]() { return state = state * 6364136223846793005 + 1442695040888963407; };
+
+			unique_ptr<uint64_t[]> sequence(new uint64_t[size]);
+			for (size_t i = 0; i < size; i++) sequence[i] = rnd() % BOUND;
+			Layout<BOUND, MALLOC> tree(sequence.get(), size);
+
+			// The volatile accumulator keeps the queries alive; its cost is
+			// uniform across the layouts.
+			volatile uint64_t sink = 0;
+			auto start = chrono::high_resolution_clock::now();
+			for (size_t i = 0; i < ops; i++) sink = sink + tree.prefix(rnd() % (size + 1));
+			query_ns[cls][layout] = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count() / double(ops);
+
+			// Updates come in +1/-1 pairs on the same index, so elements
+			// stay within [0..BOUND] whatever the update order; the second
+			// update of a pair hits a warm path, but it does so uniformly
+			// across the layouts.
+			start = chrono::high_resolution_clock::now();
+			for (size_t i = 0; i < ops / 2; i++) {
+				const size_t idx = rnd() % size + 1;
+				tree.add(idx, 1);
+				tree.add(idx, -1);
+			}
+			update_ns[cls][layout] = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count() / double(ops / 2 * 2);
+		}
+	}
+
+  public:
+	/** Returns the layout minimizing the expected cost of a workload.
+	 *
+	 * @param size the expected number of elements.
+	 * @param query_fraction the fraction of operations that are queries
+	 * (prefix() or find()); the remainder are updates.
+	 */
+	FenwickLayout best(const size_t size, double query_fraction) const {
+		query_fraction = min(1., max(0., query_fraction));
+		size_t best = 0;
+		double best_cost = numeric_limits<double>::infinity();
+		for (size_t layout = 0; layout < LAYOUTS; layout++) {
+			const size_t cls = footprintClass(size_t(size * footprint(FenwickLayout(layout)) / 8));
+			const double cost = query_fraction * query_ns[cls][layout] + (1 - query_fraction) * update_ns[cls][layout];
+			if (cost < best_cost) {
+				best_cost = cost;
+				best = layout;
+			}
+		}
+		return FenwickLayout(best);
+	}
+
+	/** Replaces the cost table with timings measured on this machine.
+	 *
+	 * Each layout is built at one representative size per footprint class
+	 * and timed on random queries and updates; with the default number of
+	 * operations the whole calibration takes a fraction of a second.
+	 *
+	 * @param ops the number of operations timed per layout and class.
+	 */
+	void calibrate(const size_t ops = 1 << 16) {
+		calibrateLayout<FenwickFixedF>(size_t(FenwickLayout::FIXEDF), ops);
+		calibrateLayout<FenwickFixedL>(size_t(FenwickLayout::FIXEDL), ops);
+		calibrateLayout<FenwickByteF>(size_t(FenwickLayout::BYTEF), ops);
+		calibrateLayout<FenwickByteL>(size_t(FenwickLayout::BYTEL), ops);
+		calibrateLayout<FenwickBitF>(size_t(FenwickLayout::BITF), ops);
+		calibrateLayout<FenwickBitL>(size_t(FenwickLayout::BITL), ops);
+	}
+
+	/** Loads a model stored with store(); returns false (leaving the
+	 * defaults in place) if the file does not exist or was written for a
+	 * different version or bound. */
+	bool load(const char *const path) {
+		ifstream is(path);
+		if (!is) return false;
+		is >> *this;
+		return bool(is);
+	}
+
+	/** Stores this model to a file (see load()). */
+	void store(const char *const path) const {
+		ofstream os(path);
+		os << *this;
+	}
+
+	/** Returns a model calibrated on this machine, reusing the given file
+	 * across runs: the model is loaded from the file if possible, and
+	 * calibrated and stored there otherwise. */
+	static FenwickCostModel calibrated(const char *const path, const size_t ops = 1 << 16) {
+		FenwickCostModel model;
+		if (!model.load(path)) {
+			model.calibrate(ops);
+			model.store(path);
+		}
+		return model;
+	}
+
+	friend ostream &operator<<(ostream &os, const FenwickCostModel<BOUND> &model) {
+		os << "fenwick-cost-model " << VERSION << " " << BOUND << "\n";
+		os.precision(17);
+		for (size_t cls = 0; cls < CLASSES; cls++)
+			for (size_t layout = 0; layout < LAYOUTS; layout++) os << model.query_ns[cls][layout] << " " << model.update_ns[cls][layout] << (layout == LAYOUTS - 1 ? "\n" : " ");
+		return os;
+	}
+
+	friend istream &operator>>(istream &is, FenwickCostModel<BOUND> &model) {
+		string magic;
+		uint32_t version;
+		size_t bound;
+		is >> magic >> version >> bound;
+		if (magic != "fenwick-cost-model" || version != VERSION || bound != BOUND) {
+			is.setstate(ios::failbit);
+			return is;
+		}
+		for (size_t cls = 0; cls < CLASSES; cls++)
+			for (size_t layout = 0; layout < LAYOUTS; layout++) is >> model.query_ns[cls][layout] >> model.update_ns[cls][layout];
+		return is;
+	}
+};
+
+/** Builds the Fenwick tree layout best suited to a given workload.
+ *
+ * The layout is chosen by the given cost model (by default, one with the
+ * built-in cost table; pass FenwickCostModel::calibrated() for choices
+ * based on timings of this machine) and returned behind the
+ * SearchablePrefixSums interface, so queries and updates pay one virtual
+ * call for not committing to a layout at compile time.
+ *
+ * @tparam BOUND maximum representable value, as in the Fenwick trees.
+ * @tparam AT a type of memory allocation out of AllocType.
+ * @param sequence a sequence of nonnegative integers smaller than or equal to `BOUND`.
+ * @param size the number of elements in the sequence.
+ * @param query_fraction the expected fraction of operations that are
+ * queries (prefix() or find()); the remainder are updates.
+ * @param model the cost model driving the choice.
+ */
+template <size_t BOUND, AllocType AT = MALLOC>
+unique_ptr<SearchablePrefixSums> makeFenwick(uint64_t sequence[], const size_t size, const double query_fraction, const FenwickCostModel<BOUND> &model = FenwickCostModel<BOUND>()) {
+	switch (model.best(size, query_fraction)) {
+	case FenwickLayout::FIXEDF:
+		return make_unique<FenwickFixedF<BOUND, AT>>(sequence, size);
+	case FenwickLayout::FIXEDL:
+		return make_unique<FenwickFixedL<BOUND, AT>>(sequence, size);
+	case FenwickLayout::BYTEF:
+		return make_unique<FenwickByteF<BOUND, AT>>(sequence, size);
+	case FenwickLayout::BYTEL:
+		return make_unique<FenwickByteL<BOUND, AT>>(sequence, size);
+	case FenwickLayout::BITF:
+		return make_unique<FenwickBitF<BOUND, AT>>(sequence, size);
+	default:
+		return make_unique<FenwickBitL<BOUND, AT>>(sequence, size);
+	}
+}
+
+} // namespace sux::util
@@ -0,0 +1,268 @@
+/*
+ * Sux: Succinct data structures
+ *
+ * Copyright (C) 2019-2020 Stefano Marchini
+ *
+ *  This library is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as published by the Free
+ *  Software Foundation; either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * Under Section 7 of GPL version 3, you are granted additional permissions
+ * described in the GCC Runtime Library Exception, version 3.1, as published by
+ * the Free Software Foundation.
+ *
+ * You should have received a copy of the GNU General Public License and a copy of
+ * the GCC Runtime Library Exception along with this program; see the files
+ * COPYING3 and COPYING.RUNTIME respectively.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "SearchablePrefixSums.hpp"
+#include "SpaceReport.hpp"
+#include "Vector.hpp"
+
+namespace sux::util {
+
+/** A standard (fixed-size) Fenwick-like tree in cache-line-blocked layout.
+ *
+ * The tree has branching factor eight: each node is a cache line holding
+ * the eight running sums over the children of the node. An operation thus
+ * touches one cache line per octal digit of its argument—at most
+ * &lceil;log<sub>2</sub>(`size`) / 3&rceil; lines—instead of one line per set bit
+ * (classical layout) or per level (level-order layout), which roughly
+ * halves the number of cache misses per operation on trees much larger
+ * than the last-level cache. The price is updates that write up to eight
+ * words, but still within a single cache line per level. For the blocks
+ * to coincide with cache lines the backing memory must be 64-byte
+ * aligned, which is guaranteed by the `mmap()`-based ::AllocType's.
+ *
+ * In the last, partially filled block of each level the slots following
+ * the running sums replicate the last sum, so searches remain monotone.
+ *
+ * @tparam BOUND maximum representable value (at most the maximum value of a `uint64_t`).
+ * @tparam AT a type of memory allocation out of ::AllocType.
+ */
+
+template <size_t BOUND, AllocType AT = MALLOC> class FenwickFixedB : public SearchablePrefixSums, public Expandable {
+  public:
+	static constexpr size_t BOUNDSIZE = ceil_log2_plus1(BOUND);
+	static_assert(BOUNDSIZE >= 1 && BOUNDSIZE <= 64, "Leaves can't be stored in a 64-bit word");
+
+  protected:
+	Vector<uint64_t, AT> Tree[22]; // 8^22 > 2^64: enough levels for any Size
+	size_t Levels, Size;
+
+  public:
+	/** Creates a new instance with no values (empty tree). */
+	FenwickFixedB() : Levels(1), Size(0) {}
+
+	/** Creates a new instance with given vector of values.
+	 *
+	 * Note that the provided sequence is read at construction time but
+	 * it will not be referenced afterwards.
+	 *
+	 * @param sequence a sequence of nonnegative integers smaller than or equal to the template parameter `BOUND`.
+	 * @param size the number of elements in the sequence.
+	 */
+	FenwickFixedB(uint64_t sequence[], size_t size) : Levels(size != 0 ? lambda(size) / 3 + 1 : 1), Size(size) {
+		this->size(size ? size : 1);
+
+		uint64_t cum = 0;
+		uint64_t base[23] = {}; // Prefix sum at the last multiple of each power of eight.
+		for (size_t idx = 1; idx <= size; idx++) {
+			cum += sequence[idx - 1];
+			size_t q = idx;
+			for (size_t l = 0; l < Levels; l++) {
+				Tree[l][q - 1] = cum - base[l + 1];
+				base[l] = cum;
+				if (q & 7) break;
+				q >>= 3;
+			}
+		}
+
+		// Replicate the last running sum over the trailing slots.
+		for (size_t l = 0; l < Levels; l++) {
+			const size_t b = size ? (size - 1) >> (3 * (l + 1)) : 0;
+			for (size_t j = size >> (3 * l); j < (b + 1) * 8; j++) Tree[l][j] = cum - base[l + 1];
+		}
+	}
+
+	using SearchablePrefixSums::prefix;
+	virtual uint64_t prefix(size_t idx) {
+		uint64_t sum = 0;
+
+		for (size_t l = 0; idx != 0; l++, idx >>= 3) {
+			if (idx & 7) sum += Tree[l][idx - 1];
+		}
+
+		return sum;
+	}
+
+	virtual void add(size_t idx, int64_t inc) {
+		size_t e = idx - 1;
+		for (size_t l = 0; l < Levels; l++, e >>= 3) {
+			uint64_t *const block = &Tree[l][e & ~size_t(7)];
+			for (size_t j = e & 7; j < 8; j++) block[j] += inc;
+		}
+	}
+
+	using SearchablePrefixSums::find;
+	virtual size_t find(uint64_t *val) {
+		size_t node = 0, b = 0;
+
+		for (size_t l = Levels - 1; l != SIZE_MAX; l--) {
+			if ((b + 1) * 8 > Tree[l].size()) break;
+
+			const uint64_t *const block = &Tree[l][b * 8];
+			size_t c = 0;
+			while (c < 8 && block[c] <= *val) c++;
+
+			if (c != 0) *val -= block[c - 1];
+			node += c << (3 * l);
+			b = b * 8 + c;
+		}
+
+		return min(node, Size);
+	}
+
+	using SearchablePrefixSums::compFind;
+	virtual size_t compFind(uint64_t *val) {
+		size_t node = 0, b = 0;
+
+		for (size_t l = Levels - 1; l != SIZE_MAX; l--) {
+			if ((b + 1) * 8 > Tree[l].size()) break;
+
+			const uint64_t *const block = &Tree[l][b * 8];
+			size_t c = 0;
+			while (c < 8 && (BOUND << (3 * l)) * (c + 1) - block[c] <= *val) c++;
+
+			if (c != 0) *val -= (BOUND << (3 * l)) * c - block[c - 1];
+			node += c << (3 * l);
+			b = b * 8 + c;
+		}
+
+		return min(node, Size);
+	}
+
+	virtual void push(uint64_t val) {
+		Size++;
+
+		while ((size_t(1) << (3 * Levels)) <= Size) {
+			// New top level: a single block whose running sums all equal the
+			// current total, since every existing element falls in its first child.
+			const uint64_t total = prefix(Size - 1);
+			Tree[Levels].resize(8);
+			for (size_t j = 0; j < 8; j++) Tree[Levels][j] = total;
+			Levels++;
+		}
+
+		size_t e = Size - 1;
+		for (size_t l = 0; l < Levels; l++, e >>= 3) {
+			if (Tree[l].size() < (e | 7) + 1) Tree[l].resize((e | 7) + 1);
+		}
+
+		add(Size, val);
+	}
+
+	virtual void pop() {
+		// Remove the last value from every running sum that includes it; the
+		// trailing slots then again replicate the sums of the shorter prefix.
+		const uint64_t last = prefix(Size) - prefix(Size - 1);
+		add(Size, -int64_t(last));
+		Size--;
+	}
+
+	virtual void grow(size_t space) {
+		if (space == 0) space = 1;
+		size_t levels = lambda(space) / 3 + 1;
+		for (size_t i = 0; i < levels; i++) Tree[i].grow((((space - 1) >> (3 * (i + 1))) + 1) * 8);
+	}
+
+	virtual void reserve(size_t space) {
+		if (space == 0) space = 1;
+		size_t levels = lambda(space) / 3 + 1;
+		for (size_t i = 0; i < levels; i++) Tree[i].reserve((((space - 1) >> (3 * (i + 1))) + 1) * 8);
+	}
+
+	using Expandable::trimToFit;
+	virtual void trim(size_t space) {
+		if (space == 0) space = 1;
+		size_t levels = lambda(space) / 3 + 1;
+		for (size_t i = 0; i < levels; i++) Tree[i].trim((((space - 1) >> (3 * (i + 1))) + 1) * 8);
+	}
+
+	virtual void resize(size_t space) {
+		if (space == 0) space = 1;
+		size_t levels = lambda(space) / 3 + 1;
+		for (size_t i = 0; i < levels; i++) Tree[i].resize((((space - 1) >> (3 * (i + 1))) + 1) * 8);
+	}
+
+	virtual void size(size_t space) {
+		if (space == 0) space = 1;
+		size_t levels = lambda(space) / 3 + 1;
+		for (size_t i = 0; i < levels; i++) Tree[i].size((((space - 1) >> (3 * (i + 1))) + 1) * 8);
+	}
+
+	virtual size_t size() const { return Size; }
+
+	virtual size_t bitCount() const {
+		size_t ret = sizeof(*this) * 8;
+		for (size_t i = 0; i < 22; i++) ret += Tree[i].bitCount() - sizeof(Tree[i]) * 8;
+		return ret;
+	}
+
+	/** Returns a structured report of the space used by this structure. */
+	SpaceReport spaceReport() const {
+		SpaceReport report{"fenwick_fixedb", sizeof(*this) * 8, AT, {}};
+		for (size_t i = 0; i < 22; i++)
+			if (Tree[i].capacity() != 0) report.components.push_back(util::spaceReport("level" + std::to_string(i), Tree[i]));
+		return report;
+	}
+
+	/** Maps this tree over a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator and must
+	 * stay alive as long as this instance is in use.
+	 *
+	 * @param p a pointer inside a memory-mapped serialized image.
+	 * @return the pointer advanced past the data of this tree.
+	 */
+	void *map(void *p) {
+		uint64_t nsize, nlevels;
+		memcpy(&nsize, p, sizeof(uint64_t));
+		memcpy(&nlevels, static_cast<char *>(p) + sizeof(uint64_t), sizeof(uint64_t));
+		Size = nsize;
+		Levels = nlevels;
+		p = static_cast<char *>(p) + 2 * sizeof(uint64_t);
+		for (size_t i = 0; i < Levels; i++) p = Tree[i].map(p);
+		return p;
+	}
+
+  private:
+	friend std::ostream &operator<<(std::ostream &os, const FenwickFixedB<BOUND, AT> &ft) {
+		os.write((char *)&ft.Size, sizeof(uint64_t));
+		os.write((char *)&ft.Levels, sizeof(uint64_t));
+		for (size_t i = 0; i < ft.Levels; i++) os << ft.Tree[i];
+		return os;
+	}
+
+	friend std::istream &operator>>(std::istream &is, FenwickFixedB<BOUND, AT> &ft) {
+		is.read((char *)&ft.Size, sizeof(uint64_t));
+		is.read((char *)&ft.Levels, sizeof(uint64_t));
+		for (size_t i = 0; i < ft.Levels; i++) is >> ft.Tree[i];
+		return is;
+	}
+};
+
+} // namespace sux::util
@@ -29,7 +29,10 @@
 #pragma once
 
 #include "SearchablePrefixSums.hpp"
+#include "SpaceReport.hpp"
 #include "Vector.hpp"
+#include <thread>
+#include <vector>
 
 namespace sux::util {
 
@@ -68,6 +71,59 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickFixedF : public Sear
 		}
 	}
 
+	/** Builds a tree over a given sequence in a single streaming pass.
+	 *
+	 * The result is identical to the one produced by the constructor, but
+	 * each node is computed from a running prefix sum and written exactly
+	 * once, in increasing position order, so both the input and the tree
+	 * are traversed strictly sequentially. With more than one thread, the
+	 * sequence is split into power-of-two-aligned chunks that are summed
+	 * and built in parallel.
+	 *
+	 * @param sequence a sequence of nonnegative integers smaller than or equal to the template parameter `BOUND`.
+	 * @param size the number of elements in the sequence.
+	 * @param num_threads the number of threads used to build the tree.
+	 */
+	static FenwickFixedF bulkBuild(const uint64_t sequence[], size_t size, size_t num_threads = 1) {
+		FenwickFixedF tree;
+		tree.Size = size;
+		tree.Tree.size(pos(size) + 1);
+
+		if (num_threads > 1 && size >= num_threads) {
+			const size_t per_thread = (size + num_threads - 1) / num_threads;
+			int log2_chunk = lambda(per_thread);
+			if ((size_t(1) << log2_chunk) < per_thread) log2_chunk++;
+			const size_t chunk = size_t(1) << log2_chunk;
+			const size_t num_chunks = (size + chunk - 1) / chunk;
+
+			// Prefix sums at the chunk boundaries.
+			std::vector<uint64_t> boundary(num_chunks + 1);
+			std::vector<std::thread> threads;
+			for (size_t k = 0; k < num_chunks; k++)
+				threads.emplace_back([&, k]() {
+					uint64_t sum = 0;
+					for (size_t idx = k * chunk; idx < std::min((k + 1) * chunk, size); idx++) sum += sequence[idx];
+					boundary[k + 1] = sum;
+				});
+			for (auto &t : threads) t.join();
+			threads.clear();
+
+			for (size_t k = 0; k < num_chunks; k++) boundary[k + 1] += boundary[k];
+
+			// Each chunk streams its nodes; those spanning several chunks are
+			// completed afterwards from the boundary sums.
+			for (size_t k = 0; k < num_chunks; k++)
+				threads.emplace_back([&, k]() { tree.streamBuild(sequence, k * chunk, std::min((k + 1) * chunk, size), boundary[k], log2_chunk); });
+			for (auto &t : threads) t.join();
+
+			for (size_t k = 1; k * chunk <= size; k++) tree.Tree[pos(k * chunk)] = boundary[k] - boundary[clear_rho(k)];
+		} else
+			tree.streamBuild(sequence, 0, size, 0, 64);
+
+		return tree;
+	}
+
+	using SearchablePrefixSums::prefix;
 	virtual uint64_t prefix(size_t idx) {
 		uint64_t sum = 0;
 
@@ -79,6 +135,35 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickFixedF : public Sear
 		return sum;
 	}
 
+	virtual void prefix(const size_t *idx, uint64_t *out, size_t n) {
+		// Interleaving the traversals lets the cache misses of several
+		// tree paths overlap instead of paying each one in full.
+		constexpr size_t INTERLEAVE = 16;
+		for (size_t base = 0; base < n; base += INTERLEAVE) {
+			const size_t batch = min(INTERLEAVE, n - base);
+			size_t curr[INTERLEAVE];
+
+			for (size_t i = 0; i < batch; i++) {
+				curr[i] = idx[base + i];
+				out[base + i] = 0;
+				if (curr[i] != 0) __builtin_prefetch(&Tree[pos(curr[i])]);
+			}
+
+			for (bool again = true; again;) {
+				again = false;
+				for (size_t i = 0; i < batch; i++) {
+					if (curr[i] == 0) continue;
+					out[base + i] += Tree[pos(curr[i])];
+					curr[i] = clear_rho(curr[i]);
+					if (curr[i] != 0) {
+						__builtin_prefetch(&Tree[pos(curr[i])]);
+						again = true;
+					}
+				}
+			}
+		}
+	}
+
 	virtual void add(size_t idx, int64_t inc) {
 		while (idx <= Size) {
 			Tree[pos(idx)] += inc;
@@ -104,6 +189,35 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickFixedF : public Sear
 		return node;
 	}
 
+	virtual void find(const uint64_t *val, size_t *out, size_t n) {
+		constexpr size_t INTERLEAVE = 16;
+		for (size_t base = 0; base < n; base += INTERLEAVE) {
+			const size_t batch = min(INTERLEAVE, n - base);
+			size_t node[INTERLEAVE];
+			uint64_t excess[INTERLEAVE];
+
+			for (size_t i = 0; i < batch; i++) {
+				node[i] = 0;
+				excess[i] = val[base + i];
+			}
+
+			for (size_t m = mask_lambda(Size); m != 0; m >>= 1) {
+				for (size_t i = 0; i < batch; i++) {
+					if (node[i] + m <= Size) {
+						const uint64_t value = Tree[pos(node[i] + m)];
+						if (excess[i] >= value) {
+							node[i] += m;
+							excess[i] -= value;
+						}
+					}
+					if (m > 1 && node[i] + m / 2 <= Size) __builtin_prefetch(&Tree[pos(node[i] + m / 2)]);
+				}
+			}
+
+			for (size_t i = 0; i < batch; i++) out[base + i] = node[i];
+		}
+	}
+
 	using SearchablePrefixSums::compFind;
 	virtual size_t compFind(uint64_t *val) {
 		size_t node = 0;
@@ -122,6 +236,35 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickFixedF : public Sear
 		return node;
 	}
 
+	virtual void compFind(const uint64_t *val, size_t *out, size_t n) {
+		constexpr size_t INTERLEAVE = 16;
+		for (size_t base = 0; base < n; base += INTERLEAVE) {
+			const size_t batch = min(INTERLEAVE, n - base);
+			size_t node[INTERLEAVE];
+			uint64_t excess[INTERLEAVE];
+
+			for (size_t i = 0; i < batch; i++) {
+				node[i] = 0;
+				excess[i] = val[base + i];
+			}
+
+			for (size_t m = mask_lambda(Size); m != 0; m >>= 1) {
+				for (size_t i = 0; i < batch; i++) {
+					if (node[i] + m <= Size) {
+						const uint64_t value = (BOUND << rho(node[i] + m)) - Tree[pos(node[i] + m)];
+						if (excess[i] >= value) {
+							node[i] += m;
+							excess[i] -= value;
+						}
+					}
+					if (m > 1 && node[i] + m / 2 <= Size) __builtin_prefetch(&Tree[pos(node[i] + m / 2)]);
+				}
+			}
+
+			for (size_t i = 0; i < batch; i++) out[base + i] = node[i];
+		}
+	}
+
 	virtual void push(uint64_t val) {
 		size_t p = pos(++Size);
 		Tree.resize(p + 1);
@@ -152,11 +295,46 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickFixedF : public Sear
 
 	virtual size_t bitCount() const { return Tree.bitCount() - sizeof(Tree) * 8 + sizeof(*this) * 8; }
 
+	/** Returns a structured report of the space used by this structure. */
+	SpaceReport spaceReport() const { return {"fenwick_fixedf", sizeof(*this) * 8, AT, {util::spaceReport("tree", Tree)}}; }
+
+	/** Maps this tree over a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator and must
+	 * stay alive as long as this instance is in use.
+	 *
+	 * @param p a pointer inside a memory-mapped serialized image.
+	 * @return the pointer advanced past the data of this tree.
+	 */
+	void *map(void *p) {
+		uint64_t nsize;
+		memcpy(&nsize, p, sizeof(uint64_t));
+		Size = nsize;
+		return Tree.map(static_cast<char *>(p) + sizeof(uint64_t));
+	}
+
   private:
 	static inline size_t holes(size_t idx) { return idx >> 14; }
 
 	static inline size_t pos(size_t idx) { return idx + holes(idx); }
 
+	/** Builds the nodes of indices in (from, to], given the prefix sum at `from`.
+	 *
+	 * `from` must be a multiple of 2^max_height; nodes of height at least
+	 * max_height span several chunks and are skipped (64 disables skipping).
+	 */
+	void streamBuild(const uint64_t sequence[], size_t from, size_t to, uint64_t cum, int max_height) {
+		uint64_t cumAt[65]; // Prefix sum at the last multiple of each power of two.
+		for (int j = 0; j <= 64; j++) cumAt[j] = cum;
+
+		for (size_t idx = from + 1; idx <= to; idx++) {
+			cum += sequence[idx - 1];
+			const int h = rho(idx);
+			if (h < max_height) Tree[pos(idx)] = cum - cumAt[h + 1];
+			for (int j = 0; j <= h && j < max_height; j++) cumAt[j] = cum;
+		}
+	}
+
 	friend std::ostream &operator<<(std::ostream &os, const FenwickFixedF<BOUND, AT> &ft) {
 		os.write((char *)&ft.Size, sizeof(uint64_t));
 		return os << ft.Tree;
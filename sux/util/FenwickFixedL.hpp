@@ -29,7 +29,10 @@
 #pragma once
 
 #include "SearchablePrefixSums.hpp"
+#include "SpaceReport.hpp"
 #include "Vector.hpp"
+#include <thread>
+#include <vector>
 
 namespace sux::util {
 
@@ -77,6 +80,64 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickFixedL : public Sear
 		}
 	}
 
+	/** Builds a tree over a given sequence in a single streaming pass.
+	 *
+	 * The result is identical to the one produced by the constructor, but
+	 * each node is computed from a running prefix sum and written exactly
+	 * once, with a sequential write stream per level, so the input is
+	 * traversed only once. With more than one thread, the sequence is
+	 * split into power-of-two-aligned chunks that are summed and built in
+	 * parallel.
+	 *
+	 * @param sequence a sequence of nonnegative integers smaller than or equal to the template parameter `BOUND`.
+	 * @param size the number of elements in the sequence.
+	 * @param num_threads the number of threads used to build the tree.
+	 */
+	static FenwickFixedL bulkBuild(const uint64_t sequence[], size_t size, size_t num_threads = 1) {
+		FenwickFixedL tree;
+		tree.Size = size;
+		tree.Levels = size != 0 ? lambda(size) + 1 : 1;
+		tree.size(size ? size : 1);
+
+		if (num_threads > 1 && size >= num_threads) {
+			const size_t per_thread = (size + num_threads - 1) / num_threads;
+			int log2_chunk = lambda(per_thread);
+			if ((size_t(1) << log2_chunk) < per_thread) log2_chunk++;
+			const size_t chunk = size_t(1) << log2_chunk;
+			const size_t num_chunks = (size + chunk - 1) / chunk;
+
+			// Prefix sums at the chunk boundaries.
+			std::vector<uint64_t> boundary(num_chunks + 1);
+			std::vector<std::thread> threads;
+			for (size_t k = 0; k < num_chunks; k++)
+				threads.emplace_back([&, k]() {
+					uint64_t sum = 0;
+					for (size_t idx = k * chunk; idx < std::min((k + 1) * chunk, size); idx++) sum += sequence[idx];
+					boundary[k + 1] = sum;
+				});
+			for (auto &t : threads) t.join();
+			threads.clear();
+
+			for (size_t k = 0; k < num_chunks; k++) boundary[k + 1] += boundary[k];
+
+			// Each chunk streams its nodes; those spanning several chunks are
+			// completed afterwards from the boundary sums.
+			for (size_t k = 0; k < num_chunks; k++)
+				threads.emplace_back([&, k]() { tree.streamBuild(sequence, k * chunk, std::min((k + 1) * chunk, size), boundary[k], log2_chunk); });
+			for (auto &t : threads) t.join();
+
+			for (size_t k = 1; k * chunk <= size; k++) {
+				const size_t idx = k * chunk;
+				const int h = rho(idx);
+				tree.Tree[h][idx >> (h + 1)] = boundary[k] - boundary[clear_rho(k)];
+			}
+		} else
+			tree.streamBuild(sequence, 0, size, 0, 64);
+
+		return tree;
+	}
+
+	using SearchablePrefixSums::prefix;
 	virtual uint64_t prefix(size_t idx) {
 		uint64_t sum = 0;
 
@@ -200,7 +261,51 @@ template <size_t BOUND, AllocType AT = MALLOC> class FenwickFixedL : public Sear
 		return ret;
 	}
 
+	/** Returns a structured report of the space used by this structure. */
+	SpaceReport spaceReport() const {
+		SpaceReport report{"fenwick_fixedl", sizeof(*this) * 8, AT, {}};
+		for (size_t i = 0; i < 64; i++)
+			if (Tree[i].capacity() != 0) report.components.push_back(util::spaceReport("level" + std::to_string(i), Tree[i]));
+		return report;
+	}
+
+	/** Maps this tree over a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator and must
+	 * stay alive as long as this instance is in use.
+	 *
+	 * @param p a pointer inside a memory-mapped serialized image.
+	 * @return the pointer advanced past the data of this tree.
+	 */
+	void *map(void *p) {
+		uint64_t nsize, nlevels;
+		memcpy(&nsize, p, sizeof(uint64_t));
+		memcpy(&nlevels, static_cast<char *>(p) + sizeof(uint64_t), sizeof(uint64_t));
+		Size = nsize;
+		Levels = nlevels;
+		p = static_cast<char *>(p) + 2 * sizeof(uint64_t);
+		for (size_t i = 0; i < 64; i++) p = Tree[i].map(p);
+		return p;
+	}
+
   private:
+	/** Builds the nodes of indices in (from, to], given the prefix sum at `from`.
+	 *
+	 * `from` must be a multiple of 2^max_height; nodes of height at least
+	 * max_height span several chunks and are skipped (64 disables skipping).
+	 */
+	void streamBuild(const uint64_t sequence[], size_t from, size_t to, uint64_t cum, int max_height) {
+		uint64_t cumAt[65]; // Prefix sum at the last multiple of each power of two.
+		for (int j = 0; j <= 64; j++) cumAt[j] = cum;
+
+		for (size_t idx = from + 1; idx <= to; idx++) {
+			cum += sequence[idx - 1];
+			const int h = rho(idx);
+			if (h < max_height) Tree[h][idx >> (h + 1)] = cum - cumAt[h + 1];
+			for (int j = 0; j <= h && j < max_height; j++) cumAt[j] = cum;
+		}
+	}
+
 	friend std::ostream &operator<<(std::ostream &os, const FenwickFixedL<BOUND, AT> &ft) {
 		os.write((char *)&ft.Size, sizeof(uint64_t));
 		os.write((char *)&ft.Levels, sizeof(uint64_t));
@@ -62,6 +62,20 @@ class SearchablePrefixSums {
 	 */
 	virtual uint64_t prefix(size_t length) = 0;
 
+	/** Compute a batch of prefix sums.
+	 *
+	 * Implementations may interleave the tree traversals of several queries
+	 * so that their cache misses overlap; on trees much larger than the
+	 * cache this is several times faster than repeated prefix() calls.
+	 *
+	 * @param idx the lengths of the prefix sums (each from 0 to size(), included).
+	 * @param out filled with the corresponding prefix sums.
+	 * @param n the number of queries in the batch.
+	 */
+	virtual void prefix(const size_t *idx, uint64_t *out, size_t n) {
+		for (size_t i = 0; i < n; i++) out[i] = prefix(idx[i]);
+	}
+
 	/** Increment an element of the sequence (not the tree).
 	 *
 	 * @param idx: index of the element.
@@ -86,6 +100,20 @@ class SearchablePrefixSums {
 	virtual size_t find(uint64_t *val) = 0;
 	size_t find(uint64_t val) { return find(&val); }
 
+	/** Search a batch of bounds; see find(uint64_t *).
+	 *
+	 * As for prefix(const size_t *, uint64_t *, size_t), implementations may
+	 * interleave the tree traversals of several queries. The excess values
+	 * are not reported.
+	 *
+	 * @param val the bounds for the prefix sums.
+	 * @param out filled with the corresponding prefix lengths.
+	 * @param n the number of queries in the batch.
+	 */
+	virtual void find(const uint64_t *val, size_t *out, size_t n) {
+		for (size_t i = 0; i < n; i++) out[i] = find(val[i]);
+	}
+
 	/** Search the length of the longest prefix whose complemented sum is less than or equal to a given bound.
 	 *
 	 * @param val bound for the complemented prefix sum.
@@ -100,6 +128,20 @@ class SearchablePrefixSums {
 	virtual size_t compFind(uint64_t *val) = 0;
 	size_t compFind(uint64_t val) { return compFind(&val); }
 
+	/** Search a batch of bounds; see compFind(uint64_t *).
+	 *
+	 * As for prefix(const size_t *, uint64_t *, size_t), implementations may
+	 * interleave the tree traversals of several queries. The excess values
+	 * are not reported.
+	 *
+	 * @param val the bounds for the complemented prefix sums.
+	 * @param out filled with the corresponding prefix lengths.
+	 * @param n the number of queries in the batch.
+	 */
+	virtual void compFind(const uint64_t *val, size_t *out, size_t n) {
+		for (size_t i = 0; i < n; i++) out[i] = compFind(val[i]);
+	}
+
 	/** Append a value to the sequence
 	 *
 	 * @param val: value to append.
@@ -0,0 +1,104 @@
+/*
+ * Sux: Succinct data structures
+ *
+ * Copyright (C) 2007-2020 Sebastiano Vigna
+ *
+ *  This library is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU Lesser General Public License as published by the Free
+ *  Software Foundation; either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 3, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * Under Section 7 of GPL version 3, you are granted additional permissions
+ * described in the GCC Runtime Library Exception, version 3.1, as published by
+ * the Free Software Foundation.
+ *
+ * You should have received a copy of the GNU General Public License and a copy of
+ * the GCC Runtime Library Exception along with this program; see the files
+ * COPYING3 and COPYING.RUNTIME respectively.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Vector.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sux::util {
+
+/** A node of a structured space report.
+ *
+ * bitCount() returns a single number, but most structures in this
+ * library are compositions (e.g., an EliasFano instance holds upper and
+ * lower bits plus two select inventories) and a flat total does not say
+ * where the bytes go. A space report is a tree of nodes, one per
+ * component, each carrying the component's name, the bits it owns
+ * directly (excluding its subcomponents) and the type of allocation
+ * backing them, so the breakdown can be exported as metrics or inspected
+ * during capacity planning. Structures return their report from a
+ * spaceReport() method; building one reads a few sizes and allocates
+ * only the nodes themselves, so it is cheap enough for production use.
+ *
+ * The invariant totalBits() == bitCount() holds for all structures
+ * implementing both.
+ */
+struct SpaceReport {
+	/** The name of the component (typically the structure or field name). */
+	std::string name;
+	/** The bits owned directly by this component, excluding its subcomponents. */
+	size_t bits = 0;
+	/** The type of allocation backing this component's bits. */
+	AllocType alloc = MALLOC;
+	/** The subcomponents of this component. */
+	std::vector<SpaceReport> components;
+
+	/** Returns the bits of this component and of all its subcomponents. */
+	size_t totalBits() const {
+		size_t total = bits;
+		for (const SpaceReport &c : components) total += c.totalBits();
+		return total;
+	}
+
+	/** Returns the name of an ::AllocType. */
+	static const char *allocName(AllocType alloc) {
+		switch (alloc) {
+		case MALLOC: return "malloc";
+		case SMALLPAGE: return "smallpage";
+		case TRANSHUGEPAGE: return "transhugepage";
+		case FORCEHUGEPAGE: return "forcehugepage";
+		case NUMABIND: return "numabind";
+		case NUMAINTERLEAVE: return "numainterleave";
+		case ARENA: return "arena";
+		}
+		return "unknown";
+	}
+
+	/** Writes an indented human-readable rendering of this report.
+	 *
+	 * @param os an output stream.
+	 * @param depth the indentation depth of this node.
+	 */
+	void print(std::ostream &os, size_t depth = 0) const {
+		for (size_t i = 0; i < depth; i++) os << "  ";
+		os << name << ": " << totalBits() << " bits (" << allocName(alloc) << ")\n";
+		for (const SpaceReport &c : components) c.print(os, depth + 1);
+	}
+};
+
+/** Returns a leaf report for the backing storage of a vector.
+ *
+ * @param name the name of the component the vector backs.
+ * @param v a vector.
+ */
+template <typename T, AllocType AT> SpaceReport spaceReport(std::string name, const Vector<T, AT> &v) { return {std::move(name), v.bitCount() - sizeof(v) * 8, AT, {}}; }
+
+} // namespace sux::util
@@ -29,11 +29,18 @@
 #pragma once
 
 #include "../support/common.hpp"
+#include "Arena.hpp"
 #include "Expandable.hpp"
 #include <assert.h>
 #include <iostream>
 #include <string>
 #include <sys/mman.h>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 namespace sux::util {
 
@@ -41,6 +48,7 @@ namespace sux::util {
  *
  * \see https://www.kernel.org/doc/html/latest/admin-guide/mm/hugetlbpage.html
  * \see https://www.kernel.org/doc/html/latest/admin-guide/mm/transhuge.html
+ * \see https://www.kernel.org/doc/html/latest/admin-guide/mm/numa_memory_policy.html
  */
 enum AllocType {
 	/** Standard allocation with `malloc()` (usually, the default). */
@@ -54,9 +62,54 @@ enum AllocType {
 	 * In this case allocations are aligned on a huge (typically, 2MiB) memory page.
 	 * This feature is usually disabled by default and it requires the administrator
 	 * to pre-reserve space for huge memory pages as documented in the reported external references  */
-	FORCEHUGEPAGE
+	FORCEHUGEPAGE,
+	/** Allocation with `mmap()` bound with `mbind()` to the NUMA node of the
+	 * allocating thread, so a structure can be placed on a chosen node by
+	 * building it from a thread pinned there. On non-NUMA systems, and where
+	 * `mbind()` is not available, this type behaves like ::SMALLPAGE. */
+	NUMABIND,
+	/** Allocation with `mmap()` interleaved with `mbind()` page by page across
+	 * all NUMA nodes with memory, evening out the access load of structures
+	 * queried from every node. On non-NUMA systems, and where `mbind()` is not
+	 * available, this type behaves like ::SMALLPAGE. */
+	NUMAINTERLEAVE,
+	/** Suballocation from a shared, caller-provided ::Arena. The vector binds
+	 * at its first allocation to the arena installed on the current thread
+	 * with Arena::Use, and grows by a bump of the arena pointer: many small
+	 * vectors can thus share a single allocation, with no per-instance slack
+	 * and contiguous placement. The arena must outlive the vector. */
+	ARENA
 };
 
+/** Empty base of Vector holding the arena pointer for ::ARENA vectors only. */
+template <AllocType AT> struct ArenaBinding {};
+template <> struct ArenaBinding<ARENA> { Arena *arena = nullptr; };
+
+/** Prefaults a memory range, so that later reads do not pay soft page faults.
+ *
+ * Where available, the range is populated with `madvise(MADV_POPULATE_READ)`;
+ * otherwise, it is advised with `MADV_WILLNEED` and then one byte per page is
+ * read in layout order. Useful on lazily faulted memory, such as a read-only
+ * mapping of a serialized structure, before taking traffic.
+ *
+ * @param mem the start of the range.
+ * @param length the length in bytes of the range.
+ */
+inline void prefault(const void *mem, size_t length) {
+	if (length == 0) return;
+	const size_t page = 4096;
+	const char *p = reinterpret_cast<const char *>(reinterpret_cast<uintptr_t>(mem) & ~(page - 1));
+	const char *const end = static_cast<const char *>(mem) + length;
+#ifdef MADV_POPULATE_READ
+	if (madvise(const_cast<char *>(p), end - p, MADV_POPULATE_READ) == 0) return;
+#endif
+#ifdef MADV_WILLNEED
+	madvise(const_cast<char *>(p), end - p, MADV_WILLNEED);
+#endif
+	volatile char sum = 0;
+	for (; p < end; p += page) sum = sum + *p;
+}
+
 /** An expandable vector with settable type of memory allocation.
  *
  * Instances of this class have a behavior similar to std::vector.
@@ -75,7 +128,7 @@ enum AllocType {
  * @tparam AT a type of memory allocation out of ::AllocType.
  */
 
-template <typename T, AllocType AT = MALLOC> class Vector : public Expandable {
+template <typename T, AllocType AT = MALLOC> class Vector : public Expandable, ArenaBinding<AT> {
 
 #ifndef MAP_HUGETLB
 #pragma message("Huge pages not supported")
@@ -92,15 +145,17 @@ template <typename T, AllocType AT = MALLOC> class Vector : public Expandable {
 	T *data = nullptr;
 
   public:
-	Vector<T, AT>() = default;
+	Vector() = default;
 
-	explicit Vector<T, AT>(size_t length) { size(length); }
+	explicit Vector(size_t length) { size(length); }
 
-	explicit Vector<T, AT>(const T *data, size_t length) : Vector(length) { memcpy(this->data, data, length); }
+	explicit Vector(const T *data, size_t length) : Vector(length) { memcpy(this->data, data, length); }
 
-	~Vector<T, AT>() {
-		if (data) {
-			if (AT == MALLOC) {
+	~Vector() {
+		if (data && _capacity != 0) {
+			if constexpr (AT == ARENA) {
+				this->arena->free(data, _capacity * sizeof(T));
+			} else if (AT == MALLOC) {
 				free(data);
 			} else {
 				int result = munmap(data, _capacity);
@@ -109,12 +164,47 @@ template <typename T, AllocType AT = MALLOC> class Vector : public Expandable {
 		}
 	}
 
+	/** Turns this vector into a non-owning view of a given backing array.
+	 *
+	 * The vector does not free the backing array at destruction: the caller
+	 * retains ownership of the memory (typically, a read-only memory mapping
+	 * of a serialized structure). The view must not be resized.
+	 *
+	 * @param data a pointer to the backing array.
+	 * @param length the number of elements of the view.
+	 */
+	void view(T *data, size_t length) {
+		this->~Vector<T, AT>();
+		this->data = data;
+		this->_size = length;
+		this->_capacity = 0;
+	}
+
+	/** Turns this vector into a non-owning view of a serialized image, with no copy.
+	 *
+	 * The image must have been written by the `<<` operator and must stay
+	 * alive as long as this vector is in use (typically, it is a read-only
+	 * memory mapping of a file). The view must not be resized.
+	 *
+	 * @param p a pointer inside a serialized image.
+	 * @return the pointer advanced past the data of this vector.
+	 */
+	void *map(void *p) {
+		uint64_t nsize;
+		memcpy(&nsize, p, sizeof(uint64_t));
+		T *const start = reinterpret_cast<T *>(static_cast<char *>(p) + sizeof(uint64_t));
+		view(start, nsize);
+		return start + nsize;
+	}
+
 	// Delete copy operators
 	Vector(const Vector &) = delete;
 	Vector &operator=(const Vector &) = delete;
 
 	// Define move operators
-	Vector(Vector<T, AT> &&oth) : _size(std::exchange(oth._size, 0)), _capacity(std::exchange(oth._capacity, 0)), data(std::exchange(oth.data, nullptr)) {}
+	Vector(Vector<T, AT> &&oth) : _size(std::exchange(oth._size, 0)), _capacity(std::exchange(oth._capacity, 0)), data(std::exchange(oth.data, nullptr)) {
+		if constexpr (AT == ARENA) this->arena = std::exchange(oth.arena, nullptr);
+	}
 
 	Vector<T, AT> &operator=(Vector<T, AT> &&oth) {
 		swap(*this, oth);
@@ -203,6 +293,7 @@ template <typename T, AllocType AT = MALLOC> class Vector : public Expandable {
 		std::swap(first._size, second._size);
 		std::swap(first._capacity, second._capacity);
 		std::swap(first.data, second.data);
+		if constexpr (AT == ARENA) std::swap(first.arena, second.arena);
 	}
 
 	/** Returns a pointer at the start of the backing array. */
@@ -230,7 +321,41 @@ template <typename T, AllocType AT = MALLOC> class Vector : public Expandable {
 	 */
 	size_t bitCount() const { return sizeof(*this) * 8 + _capacity * sizeof(T) * 8; }
 
+	/** Prefaults the backing array (see sux::util::prefault()).
+	 *
+	 * Owned allocations are touched when they are made, so this is mainly
+	 * useful on views of lazily faulted memory, such as vectors mapped
+	 * over a serialized image with map() or view().
+	 */
+	void prefault() const { sux::util::prefault(data, _size * sizeof(T)); }
+
   private:
+	/** Applies the NUMA policy of this AllocType to a freshly mapped region.
+	 *
+	 * The policy must be applied before the region is touched, as it affects
+	 * pages as they are faulted in. Placement is best-effort: failures (e.g.,
+	 * kernels without NUMA support) are ignored and leave the default policy.
+	 */
+	static void numa_place(void *mem, size_t space) {
+#if defined(__linux__) && defined(SYS_mbind)
+		unsigned long nodemask[16] = {};
+		const unsigned long maxnode = sizeof(nodemask) * 8;
+		if (AT == NUMAINTERLEAVE) {
+			// MPOL_F_MEMS_ALLOWED (4) fills the mask of the nodes with memory.
+			if (syscall(SYS_get_mempolicy, nullptr, nodemask, maxnode, nullptr, 4) != 0) return;
+			syscall(SYS_mbind, mem, space, 3 /* MPOL_INTERLEAVE */, nodemask, maxnode + 1, 0);
+		} else {
+			unsigned cpu, node;
+			if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return;
+			nodemask[node / (8 * sizeof(unsigned long))] = 1UL << node % (8 * sizeof(unsigned long));
+			syscall(SYS_mbind, mem, space, 2 /* MPOL_BIND */, nodemask, maxnode + 1, 0);
+		}
+#else
+		(void)mem;
+		(void)space;
+#endif
+	}
+
 	static size_t page_aligned(size_t size) {
 		if (AT == FORCEHUGEPAGE)
 			return ((2 * 1024 * 1024 - 1) | (size * sizeof(T) - 1)) + 1;
@@ -244,7 +369,15 @@ template <typename T, AllocType AT = MALLOC> class Vector : public Expandable {
 		void *mem;
 		size_t space; // Space to allocate, in bytes
 
-		if (AT == MALLOC) {
+		if constexpr (AT == ARENA) {
+			space = size * sizeof(T);
+			if (_capacity == 0) {
+				if (!this->arena) this->arena = Arena::current();
+				assert(this->arena && "no arena installed with Arena::Use");
+				mem = this->arena->alloc(space);
+			} else
+				mem = this->arena->realloc(data, _capacity * sizeof(T), space);
+		} else if (AT == MALLOC) {
 			space = size * sizeof(T);
 			mem = _capacity == 0 ? malloc(space) : realloc(data, space);
 			assert(mem != NULL && "malloc failed");
@@ -266,6 +399,8 @@ template <typename T, AllocType AT = MALLOC> class Vector : public Expandable {
 				int adv = madvise(mem, space, MADV_HUGEPAGE);
 				assert(adv == 0 && "madvise failed");
 			}
+
+			if (AT == NUMABIND || AT == NUMAINTERLEAVE) numa_place(mem, space);
 		}
 
 		if (_capacity * sizeof(T) < space) memset(static_cast<char *>(mem) + _capacity * sizeof(T), 0, space - _capacity * sizeof(T));
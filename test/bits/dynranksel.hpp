@@ -7,9 +7,14 @@
 #include <sux/util/FenwickFixedF.hpp>
 #include <sux/util/FenwickFixedL.hpp>
 
+#include <sux/bits/AdaptiveDynRankSel.hpp>
 #include <sux/bits/StrideDynRankSel.hpp>
+#include <sux/bits/SyncStrideDynRankSel.hpp>
 #include <sux/bits/WordDynRankSel.hpp>
 
+#include <sstream>
+#include <thread>
+
 TEST(dynranksel, all_ones) {
 	using namespace sux;
 
@@ -409,6 +414,310 @@ template <std::size_t S> void run_dynranksel(std::size_t size) {
 	delete[] bvfixedf;
 }
 
+TEST(dynranksel, batch_update) {
+	using namespace sux;
+
+	constexpr size_t size = 64 * 1024;
+	constexpr size_t words = size / 64;
+	uint64_t *bvword = new uint64_t[words + 1]();
+	uint64_t *bvstride = new uint64_t[words + 1]();
+	uint64_t *bvref = new uint64_t[words + 1]();
+	for (size_t i = 0; i < words; i++) bvword[i] = bvstride[i] = bvref[i] = next();
+
+	bits::WordDynRankSel<util::FenwickFixedF> word(bvword, size);
+	bits::StrideDynRankSel<util::FenwickByteL, 8> stride(bvstride, size);
+	bits::WordDynRankSel<util::FenwickFixedF> ref(bvref, size);
+
+	// Batches of clustered updates with repeated indices: the last word of
+	// the batch must win, and the result must match one-by-one updates.
+	constexpr size_t n = 1000;
+	std::vector<size_t> indices(n);
+	std::vector<uint64_t> values(n);
+	for (size_t round = 0; round < 4; round++) {
+		const size_t base = next() % (words / 2);
+		for (size_t i = 0; i < n; i++) {
+			indices[i] = base + next() % (words / 4);
+			values[i] = next();
+		}
+
+		for (size_t i = 0; i < n; i++) ref.update(indices[i], values[i]);
+		word.update(&indices[0], &values[0], n);
+		stride.update(&indices[0], &values[0], n);
+
+		for (size_t i = 0; i < words; i++) {
+			ASSERT_EQ(bvref[i], bvword[i]) << "at word " << i;
+			ASSERT_EQ(bvref[i], bvstride[i]) << "at word " << i;
+		}
+		for (size_t pos = 0; pos <= size; pos += 63) {
+			ASSERT_EQ(ref.rank(pos), word.rank(pos)) << "at position " << pos;
+			ASSERT_EQ(ref.rank(pos), stride.rank(pos)) << "at position " << pos;
+		}
+		const uint64_t ones = ref.rank(size);
+		for (uint64_t r = 0; r < ones; r += 17) {
+			ASSERT_EQ(ref.select(r), word.select(r)) << "at rank " << r;
+			ASSERT_EQ(ref.select(r), stride.select(r)) << "at rank " << r;
+		}
+	}
+
+	delete[] bvref;
+	delete[] bvstride;
+	delete[] bvword;
+}
+
+TEST(dynranksel, rebuild) {
+	using namespace sux;
+
+	constexpr size_t size = 64 * 1024;
+	constexpr size_t words = size / 64;
+	uint64_t *bvword = new uint64_t[words + 1]();
+	uint64_t *bvstride = new uint64_t[words + 1]();
+	uint64_t *bvsync = new uint64_t[words + 1]();
+	uint64_t *bvref = new uint64_t[words + 1]();
+	for (size_t i = 0; i < words; i++) bvword[i] = bvstride[i] = bvsync[i] = bvref[i] = next();
+
+	bits::WordDynRankSel<util::FenwickFixedF> word(bvword, size);
+	bits::StrideDynRankSel<util::FenwickByteL, 8> stride(bvstride, size);
+	bits::SyncStrideDynRankSel<util::FenwickFixedL, 8> sync(bvsync, size);
+
+	// Bulk deletions, then rebuilds with one and several threads: all
+	// queries must match a structure freshly built over the same bit data.
+	for (size_t i = 0; i < size; i += 3) {
+		word.clear(i);
+		stride.clear(i);
+		sync.clear(i);
+		bvref[i / 64] &= ~(UINT64_C(1) << i % 64);
+	}
+	word.rebuild();
+	word.rebuild(3);
+	stride.rebuild(3);
+
+	// The sync wrapper rebuilds while readers keep querying the old tree.
+	std::atomic<bool> stop(false);
+	std::atomic<size_t> failures(0);
+	const uint64_t invariant = sync.rank(size);
+	std::thread reader([&]() {
+		while (!stop.load()) {
+			if (sync.rank(size) != invariant) failures.fetch_add(1);
+			for (size_t pos = 0; pos <= size; pos += 611)
+				if (sync.rank(pos) > pos) failures.fetch_add(1);
+		}
+	});
+	for (size_t round = 0; round < 16; round++) sync.rebuild(1 + round % 3);
+	stop.store(true);
+	reader.join();
+	EXPECT_EQ(0u, failures.load());
+
+	bits::WordDynRankSel<util::FenwickFixedF> ref(bvref, size);
+	for (size_t pos = 0; pos <= size; pos += 61) {
+		const uint64_t r = ref.rank(pos);
+		ASSERT_EQ(r, word.rank(pos)) << "at position " << pos;
+		ASSERT_EQ(r, stride.rank(pos)) << "at position " << pos;
+		ASSERT_EQ(r, sync.rank(pos)) << "at position " << pos;
+	}
+	const uint64_t ones = ref.rank(size);
+	for (uint64_t r = 0; r < ones; r += 17) {
+		const size_t pos = ref.select(r);
+		ASSERT_EQ(pos, word.select(r)) << "at rank " << r;
+		ASSERT_EQ(pos, stride.select(r)) << "at rank " << r;
+		ASSERT_EQ(pos, sync.select(r)) << "at rank " << r;
+	}
+	for (uint64_t r = 0; r < size - ones; r += 17) {
+		const size_t pos = ref.selectZero(r);
+		ASSERT_EQ(pos, word.selectZero(r)) << "at rank " << r;
+		ASSERT_EQ(pos, stride.selectZero(r)) << "at rank " << r;
+		ASSERT_EQ(pos, sync.selectZero(r)) << "at rank " << r;
+	}
+
+	delete[] bvref;
+	delete[] bvsync;
+	delete[] bvstride;
+	delete[] bvword;
+}
+
+TEST(dynranksel, dump_load) {
+	using namespace sux;
+
+	for (size_t size : {size_t(100), size_t(64 * 1024 + 17)}) {
+		const size_t words = size / 64 + 1;
+		uint64_t *bvword = new uint64_t[words]();
+		uint64_t *bvstride = new uint64_t[words]();
+		for (size_t i = 0; i < size; i++)
+			if (next() % 2) {
+				bvword[i / 64] |= UINT64_C(1) << i % 64;
+				bvstride[i / 64] |= UINT64_C(1) << i % 64;
+			}
+
+		bits::WordDynRankSel<util::FenwickFixedF> word(bvword, size);
+		bits::StrideDynRankSel<util::FenwickByteL, 8> stride(bvstride, size);
+		for (size_t i = 0; i < 100; i++) {
+			const size_t idx = next() % size;
+			word.toggle(idx);
+			stride.toggle(idx);
+		}
+
+		for (const bool with_prefix_sums : {true, false}) {
+			std::ostringstream wdump, sdump;
+			word.dump(wdump, with_prefix_sums);
+			stride.dump(sdump, with_prefix_sums);
+
+			// Every section is padded, so the snapshots are block-sized.
+			EXPECT_EQ(0u, wdump.str().size() % 4096);
+			EXPECT_EQ(0u, sdump.str().size() % 4096);
+
+			std::istringstream win(wdump.str()), sin(sdump.str());
+			util::Vector<uint64_t> wbits, sbits;
+			auto wload = bits::WordDynRankSel<util::FenwickFixedF>::load(win, wbits);
+			auto sload = bits::StrideDynRankSel<util::FenwickByteL, 8>::load(sin, sbits);
+
+			ASSERT_EQ(word.size(), wload.size());
+			ASSERT_EQ(stride.size(), sload.size());
+			for (size_t pos = 0; pos <= size; pos += 7) {
+				ASSERT_EQ(word.rank(pos), wload.rank(pos)) << "at position " << pos;
+				ASSERT_EQ(stride.rank(pos), sload.rank(pos)) << "at position " << pos;
+			}
+			const uint64_t ones = word.rank(size);
+			for (uint64_t r = 0; r < ones; r += 7) {
+				ASSERT_EQ(word.select(r), wload.select(r)) << "at rank " << r;
+				ASSERT_EQ(stride.select(r), sload.select(r)) << "at rank " << r;
+			}
+			for (uint64_t r = 0; r < size - ones; r += 7) {
+				ASSERT_EQ(word.selectZero(r), wload.selectZero(r)) << "at rank " << r;
+				ASSERT_EQ(stride.selectZero(r), sload.selectZero(r)) << "at rank " << r;
+			}
+
+			// The loaded structures must remain fully dynamic.
+			for (size_t i = 0; i < 100; i++) {
+				const size_t idx = next() % size;
+				ASSERT_EQ(word.toggle(idx), wload.toggle(idx)) << "at index " << idx;
+				ASSERT_EQ(stride.toggle(idx), sload.toggle(idx)) << "at index " << idx;
+			}
+			for (size_t pos = 0; pos <= size; pos += 7) {
+				ASSERT_EQ(word.rank(pos), wload.rank(pos)) << "at position " << pos;
+				ASSERT_EQ(stride.rank(pos), sload.rank(pos)) << "at position " << pos;
+			}
+		}
+
+		delete[] bvstride;
+		delete[] bvword;
+	}
+}
+
+TEST(dynranksel, adaptive) {
+	using namespace sux;
+
+	constexpr size_t size = 64 * 1024;
+	constexpr size_t words = size / 64;
+	uint64_t *bvadaptive = new uint64_t[words + 1]();
+	uint64_t *bvref = new uint64_t[words + 1]();
+	for (size_t i = 0; i < words; i++) bvadaptive[i] = bvref[i] = next();
+
+	bits::AdaptiveDynRankSel<util::FenwickFixedF, 16> adaptive(bvadaptive, size);
+	bits::WordDynRankSel<util::FenwickFixedF> ref(bvref, size);
+
+	EXPECT_EQ(1u, adaptive.stride());
+
+	const auto check = [&]() {
+		for (size_t pos = 0; pos <= size; pos += 63) ASSERT_EQ(ref.rank(pos), adaptive.rank(pos)) << "at position " << pos;
+		const uint64_t ones = ref.rank(size);
+		for (uint64_t r = 0; r < ones; r += 61) ASSERT_EQ(ref.select(r), adaptive.select(r)) << "at rank " << r;
+		for (uint64_t r = 0; r < size - ones; r += 61) ASSERT_EQ(ref.selectZero(r), adaptive.selectZero(r)) << "at rank " << r;
+	};
+
+	check();
+
+	// An update-heavy phase (several epochs long) must widen the stride.
+	for (size_t i = 0; i < 1 << 18; i++) {
+		const size_t idx = next() % words;
+		const uint64_t word = next();
+		adaptive.update(idx, word);
+		ref.update(idx, word);
+	}
+	EXPECT_GT(adaptive.stride(), 1u);
+	check();
+
+	// Mixed mutations must stay consistent across migrations.
+	for (size_t i = 0; i < 1000; i++) {
+		const size_t idx = next() % size;
+		switch (next() % 3) {
+		case 0:
+			ASSERT_EQ(ref.set(idx), adaptive.set(idx)) << "at index " << idx;
+			break;
+		case 1:
+			ASSERT_EQ(ref.clear(idx), adaptive.clear(idx)) << "at index " << idx;
+			break;
+		case 2:
+			ASSERT_EQ(ref.toggle(idx), adaptive.toggle(idx)) << "at index " << idx;
+			break;
+		}
+	}
+	check();
+
+	// A query-heavy phase must shrink the stride back to a single word.
+	for (size_t i = 0; i < 1 << 18; i++) adaptive.rank(next() % size);
+	EXPECT_EQ(1u, adaptive.stride());
+	check();
+
+	delete[] bvref;
+	delete[] bvadaptive;
+}
+
+TEST(dynranksel, sync_stride) {
+	using namespace sux;
+
+	constexpr size_t size = 64 * 1024;
+	constexpr size_t words = size / 64;
+	uint64_t *bvsync = new uint64_t[words + 1]();
+	uint64_t *bvref = new uint64_t[words + 1]();
+	for (size_t i = 0; i < words; i++) bvsync[i] = bvref[i] = next();
+
+	bits::SyncStrideDynRankSel<util::FenwickFixedF, 8> sync(bvsync, size);
+	bits::StrideDynRankSel<util::FenwickFixedF, 8> ref(bvref, size);
+
+	// Single-threaded equivalence with the plain structure.
+	for (size_t i = 0; i < 1000; i++) {
+		const size_t idx = next() % words;
+		const uint64_t word = next();
+		ASSERT_EQ(ref.update(idx, word), sync.update(idx, word));
+	}
+	for (size_t pos = 0; pos <= size; pos += 63) ASSERT_EQ(ref.rank(pos), sync.rank(pos)) << "at position " << pos;
+	const uint64_t ones = ref.rank(size);
+	for (uint64_t r = 0; r < ones; r += 17) ASSERT_EQ(ref.select(r), sync.select(r)) << "at rank " << r;
+
+	// Parallel readers with a concurrent writer: every update rotates a
+	// word, preserving its popcount, so every read must return the same
+	// total count no matter how it interleaves with the writer.
+	const uint64_t invariant = sync.rank(size);
+	std::atomic<bool> stop{false};
+	std::atomic<size_t> reads{0};
+	std::vector<std::thread> readers;
+	for (size_t t = 0; t < 4; t++)
+		readers.emplace_back([&, t]() {
+			uint64_t seed = 0x9E3779B97F4A7C15 * (t + 1);
+			while (!stop.load()) {
+				ASSERT_EQ(invariant, sync.rank(size));
+				seed = seed * 6364136223846793005 + 1442695040888963407;
+				const size_t pos = sync.select(seed % invariant);
+				ASSERT_LT(pos, size);
+				reads.fetch_add(1);
+			}
+		});
+
+	for (size_t i = 0; i < 20000; i++) {
+		const size_t idx = next() % words;
+		const uint64_t old = bvsync[idx];
+		sync.update(idx, old << 1 | old >> 63);
+	}
+	// Let slow-starting readers observe at least one state before stopping.
+	while (reads.load() == 0) std::this_thread::yield();
+	stop.store(true);
+	for (auto &t : readers) t.join();
+	ASSERT_GT(reads.load(), 0u);
+	ASSERT_EQ(invariant, sync.rank(size));
+
+	delete[] bvref;
+	delete[] bvsync;
+}
+
 TEST(dynranksel, small_large) {
 	run_dynranksel<8>(1);
 	run_dynranksel<16>(512 * 1024);
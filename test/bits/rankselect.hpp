@@ -1,7 +1,11 @@
 #pragma once
 
+#include <sstream>
 #include <sux/bits/EliasFano.hpp>
+#include <sux/bits/EliasFanoSetOps.hpp>
+#include <sux/bits/Poppy.hpp>
 #include <sux/bits/Rank9Sel.hpp>
+#include <sux/bits/Rrr.hpp>
 #include <sux/bits/SimpleSelect.hpp>
 #include <sux/bits/SimpleSelectHalf.hpp>
 #include <sux/bits/SimpleSelectZero.hpp>
@@ -16,6 +20,7 @@ TEST(rankselect, all_ones) {
 
 		Rank9Sel Rank9Sel(bitvect, size);
 		EliasFano EliasFano(bitvect, size);
+		Poppy Poppy(bitvect, size);
 		SimpleSelect SimpleSelect(bitvect, size, 3);
 		SimpleSelectHalf SimpleSelectHalf(bitvect, size);
 
@@ -23,6 +28,7 @@ TEST(rankselect, all_ones) {
 		for (size_t i = 0; i <= size; i++) {
 			EXPECT_EQ(i, Rank9Sel.rank(i)) << "at index " << i;
 			EXPECT_EQ(i, EliasFano.rank(i)) << "at index " << i;
+			EXPECT_EQ(i, Poppy.rank(i)) << "at index " << i;
 		}
 
 		// rankZero
@@ -35,6 +41,7 @@ TEST(rankselect, all_ones) {
 		for (size_t i = 0; i < size; i++) {
 			EXPECT_EQ(i, Rank9Sel.select(i)) << "at index " << i;
 			EXPECT_EQ(i, EliasFano.select(i)) << "at index " << i;
+			EXPECT_EQ(i, Poppy.select(i)) << "at index " << i;
 			EXPECT_EQ(i, SimpleSelect.select(i)) << "at index " << i;
 			EXPECT_EQ(i, SimpleSelectHalf.select(i)) << "at index " << i;
 		}
@@ -51,6 +58,7 @@ TEST(rankselect, all_zeroes) {
 
 		Rank9Sel Rank9Sel(bitvect, size);
 		EliasFano EliasFano(bitvect, size);
+		Poppy Poppy(bitvect, size);
 		SimpleSelectZero SimpleSelectZero(bitvect, size, 3);
 		SimpleSelectZeroHalf SimpleSelectZeroHalf(bitvect, size);
 
@@ -58,6 +66,7 @@ TEST(rankselect, all_zeroes) {
 		for (size_t i = 0; i <= size; i++) {
 			EXPECT_EQ(0, Rank9Sel.rank(i)) << "at index " << i;
 			EXPECT_EQ(0, EliasFano.rank(i)) << "at index " << i;
+			EXPECT_EQ(0, Poppy.rank(i)) << "at index " << i;
 		}
 
 		// rankZero
@@ -93,6 +102,7 @@ static void run_rankselect(std::size_t size) {
 
 	Rank9Sel Rank9Sel(bitvect, size);
 	EliasFano EliasFano(bitvect, size);
+	Poppy Poppy(bitvect, size);
 	SimpleSelect SimpleSelect(bitvect, size, 3); // TODO: try different LONGWORDS_PER_SUBINVENTORY
 	SimpleSelectHalf SimpleSelectHalf(bitvect, size);
 	SimpleSelectZero SimpleSelectZero(bitvect, size,
@@ -103,8 +113,10 @@ static void run_rankselect(std::size_t size) {
 	for (size_t i = 0; i < ones; i++) {
 		auto pos = Rank9Sel.select(i);
 		EXPECT_EQ(pos, EliasFano.select(i));
+		EXPECT_EQ(pos, Poppy.select(i));
 		EXPECT_EQ(i, Rank9Sel.rank(pos));
 		EXPECT_EQ(i, EliasFano.rank(pos));
+		EXPECT_EQ(i, Poppy.rank(pos));
 		pos = SimpleSelect.select(i);
 		EXPECT_EQ(i, Rank9Sel.rank(pos));
 		EXPECT_EQ(i, EliasFano.rank(pos));
@@ -118,6 +130,7 @@ static void run_rankselect(std::size_t size) {
 	for (size_t pos = 0; pos <= poslim; pos++) {
 		auto res = Rank9Sel.rank(pos);
 		EXPECT_EQ(res, EliasFano.rank(pos));
+		EXPECT_EQ(res, Poppy.rank(pos));
 		if (bitvect[pos / 64] & UINT64_C(1) << pos % 64)
 			EXPECT_EQ(pos, Rank9Sel.select(res));
 		else
@@ -150,6 +163,599 @@ static void run_rankselect(std::size_t size) {
 	delete[] bitvect;
 }
 
+TEST(rankselect, bulk_bitfields) {
+	for (int width = 1; width <= 64; width++) {
+		const uint64_t mask = -1ULL >> (64 - width);
+		for (uint64_t from : {uint64_t(0), uint64_t(1), uint64_t(13), uint64_t(63), uint64_t(130)}) {
+			const size_t n = 1000;
+			std::vector<uint64_t> words((from + n * width + 63) / 64, -1ULL), vals(n), out(n);
+			for (size_t i = 0; i < n; i++) vals[i] = next() & mask;
+
+			sux::bitwrite_bulk(words.data(), from, width, vals.data(), n);
+			for (size_t i = 0; i < n; i++) {
+				const uint64_t b = from + i * width;
+				ASSERT_EQ(vals[i], sux::bitread(words.data() + b / 64, b % 64, width));
+			}
+
+			sux::bitread_bulk(words.data(), from, width, out.data(), n);
+			for (size_t i = 0; i < n; i++) ASSERT_EQ(vals[i], out[i]);
+
+			// Bits around the written range are preserved.
+			for (uint64_t b = 0; b < from; b++) ASSERT_NE(0U, words[b / 64] & 1ULL << b % 64);
+			for (uint64_t b = from + n * width; b < words.size() * 64; b++) ASSERT_NE(0U, words[b / 64] & 1ULL << b % 64);
+		}
+	}
+}
+
+TEST(rankselect, elias_fano_builder) {
+	using namespace sux::bits;
+
+	for (size_t size : {size_t(10), size_t(1000), size_t(512 * 1024)}) {
+		std::vector<uint64_t> ones;
+		uint64_t pos = 0;
+		while ((pos += next() % 16 + 1) < size) ones.push_back(pos);
+
+		EliasFano from_list(ones, size);
+
+		EliasFano<>::Builder builder(ones.size(), size);
+		for (const auto p : ones) builder.push(p);
+		auto built = builder.build();
+
+		for (size_t i = 0; i < ones.size(); i++) EXPECT_EQ(from_list.select(i), built.select(i));
+		for (size_t i = 0; i < size; i++) EXPECT_EQ(from_list.rank(i), built.rank(i));
+	}
+}
+
+TEST(rankselect, elias_fano_iterator) {
+	using namespace sux::bits;
+
+	for (size_t size : {size_t(100), size_t(1000), size_t(512 * 1024)}) {
+		std::vector<uint64_t> ones;
+		uint64_t pos = 0;
+		while ((pos += next() % 256 + 1) < size) ones.push_back(pos);
+
+		EliasFano ef(ones, size);
+
+		// Sequential scan.
+		auto it = ef.iterator();
+		for (size_t i = 0; i < ones.size(); i++) {
+			ASSERT_TRUE(it.hasNext());
+			EXPECT_EQ(i, it.rank());
+			EXPECT_EQ(ones[i], it.next());
+		}
+		ASSERT_FALSE(it.hasNext());
+
+		// Galloping skips.
+		for (size_t step : {size_t(1), size_t(7), size_t(100)}) {
+			auto skip_it = ef.iterator();
+			for (uint64_t bound = 0; bound < size; bound += step) {
+				const auto lb = std::lower_bound(ones.begin(), ones.end(), bound);
+				if (lb == ones.end())
+					EXPECT_EQ(size, skip_it.skipTo(bound));
+				else
+					EXPECT_EQ(*lb, skip_it.skipTo(bound));
+			}
+		}
+	}
+}
+
+#if defined(__cpp_impl_coroutine)
+TEST(rankselect, interleaved) {
+	using namespace sux::bits;
+
+	const size_t size = 512 * 1024;
+	std::vector<uint64_t> ones;
+	uint64_t pos = 0;
+	while ((pos += next() % 256 + 1) < size) ones.push_back(pos);
+
+	EliasFano ef(ones, size);
+
+	const size_t n = 10000;
+	std::vector<size_t> rank(n);
+	std::vector<size_t> out(n);
+	for (size_t i = 0; i < n; i++) rank[i] = next() % ones.size();
+
+	for (size_t window : {size_t(1), size_t(16), size_t(32)}) {
+		sux::interleave(n, [&](size_t i) { return ef.selectLookup(rank[i]); }, out.data(), window);
+		for (size_t i = 0; i < n; i++) ASSERT_EQ(ones[rank[i]], out[i]);
+	}
+
+	// The upper-bits selection structure on its own.
+	const size_t words = size / 64 + 1;
+	std::vector<uint64_t> bitvect(words);
+	uint64_t num_ones = 0;
+	for (size_t i = 0; i < words; i++) num_ones += __builtin_popcountll(bitvect[i] = next());
+	SimpleSelectHalf sel(&bitvect[0], words * 64);
+
+	std::vector<uint64_t> sout(n);
+	for (size_t i = 0; i < n; i++) rank[i] = next() % num_ones;
+	sux::interleave(n, [&](size_t i) { return sel.selectLookup(rank[i]); }, sout.data());
+	for (size_t i = 0; i < n; i++) ASSERT_EQ(sel.select(rank[i]), sout[i]);
+}
+#endif
+
+TEST(rankselect, elias_fano_pred_succ) {
+	using namespace sux::bits;
+
+	for (size_t size : {size_t(100), size_t(1000), size_t(512 * 1024)}) {
+		std::vector<uint64_t> ones;
+		uint64_t pos = 0;
+		while ((pos += next() % 256 + 1) < size) ones.push_back(pos);
+
+		EliasFano ef(ones, size);
+
+		for (uint64_t bound = 0; bound < size + 10; bound++) {
+			uint64_t rank;
+
+			// successor: first element >= bound
+			const auto lb = std::lower_bound(ones.begin(), ones.end(), bound);
+			if (lb == ones.end()) {
+				ASSERT_EQ(size, ef.successor(bound)) << "at bound " << bound;
+			} else {
+				ASSERT_EQ(*lb, ef.successor(bound, &rank)) << "at bound " << bound;
+				ASSERT_EQ(uint64_t(lb - ones.begin()), rank) << "at bound " << bound;
+			}
+
+			// predecessor: last element <= bound
+			const auto ub = std::upper_bound(ones.begin(), ones.end(), bound);
+			if (ub == ones.begin()) {
+				ASSERT_EQ(UINT64_MAX, ef.predecessor(bound)) << "at bound " << bound;
+			} else {
+				ASSERT_EQ(*(ub - 1), ef.predecessor(bound, &rank)) << "at bound " << bound;
+				ASSERT_EQ(uint64_t(ub - 1 - ones.begin()), rank) << "at bound " << bound;
+			}
+		}
+	}
+}
+
+TEST(rankselect, elias_fano_set_ops) {
+	using namespace sux::bits;
+
+	const size_t size = 512 * 1024;
+	// A dense, a medium and a sparse list, to exercise the skips.
+	std::vector<uint64_t> av, bv, cv;
+	uint64_t pos = 0;
+	while ((pos += next() % 8 + 1) < size) av.push_back(pos);
+	pos = 0;
+	while ((pos += next() % 64 + 1) < size) bv.push_back(pos);
+	pos = 0;
+	while ((pos += next() % 2048 + 1) < size) cv.push_back(pos);
+
+	EliasFano a(av, size), b(bv, size), c(cv, size);
+
+	std::vector<uint64_t> expected, result;
+
+	std::set_intersection(av.begin(), av.end(), bv.begin(), bv.end(), std::back_inserter(expected));
+	EXPECT_EQ(expected.size(), intersect(a, b, [&](uint64_t x) { result.push_back(x); }));
+	EXPECT_EQ(expected, result);
+	EXPECT_EQ(expected.size(), intersect(b, a)); // Symmetric
+
+	expected.clear(), result.clear();
+	std::set_union(av.begin(), av.end(), bv.begin(), bv.end(), std::back_inserter(expected));
+	EXPECT_EQ(expected.size(), setUnion(a, b, [&](uint64_t x) { result.push_back(x); }));
+	EXPECT_EQ(expected, result);
+
+	expected.clear(), result.clear();
+	std::set_difference(av.begin(), av.end(), bv.begin(), bv.end(), std::back_inserter(expected));
+	EXPECT_EQ(expected.size(), difference(a, b, [&](uint64_t x) { result.push_back(x); }));
+	EXPECT_EQ(expected, result);
+
+	// Three-way intersection, in density order and in reverse.
+	expected.clear(), result.clear();
+	std::vector<uint64_t> ab;
+	std::set_intersection(av.begin(), av.end(), bv.begin(), bv.end(), std::back_inserter(ab));
+	std::set_intersection(ab.begin(), ab.end(), cv.begin(), cv.end(), std::back_inserter(expected));
+	std::vector<EliasFano<> *> lists{&a, &b, &c};
+	EXPECT_EQ(expected.size(), intersect(lists, [&](uint64_t x) { result.push_back(x); }));
+	EXPECT_EQ(expected, result);
+	std::vector<EliasFano<> *> reversed{&c, &b, &a};
+	EXPECT_EQ(expected.size(), intersect(reversed));
+
+	// Empty operands.
+	std::vector<uint64_t> empty;
+	EliasFano e(empty, size);
+	EXPECT_EQ(uint64_t(0), intersect(a, e));
+	EXPECT_EQ(av.size(), setUnion(a, e));
+	EXPECT_EQ(av.size(), difference(a, e));
+	EXPECT_EQ(uint64_t(0), difference(e, a));
+}
+
+TEST(rankselect, elias_fano_dump_load_map) {
+	using namespace sux::bits;
+
+	for (size_t size : {size_t(1000), size_t(512 * 1024)}) {
+		std::vector<uint64_t> ones;
+		uint64_t pos = 0;
+		while ((pos += next() % 16 + 1) < size) ones.push_back(pos);
+
+		EliasFano ef(ones, size);
+
+		std::ostringstream dump;
+		dump << ef;
+
+		std::istringstream in(dump.str());
+		EliasFano<> ef_load;
+		in >> ef_load;
+
+		// An 8-byte aligned copy of the image, standing in for a memory mapping.
+		std::vector<uint64_t> image((dump.str().size() + 7) / 8);
+		memcpy(&image[0], dump.str().data(), dump.str().size());
+		EliasFano<> ef_map;
+		ef_map.map(&image[0]);
+
+		for (size_t i = 0; i < ones.size(); i++) {
+			ASSERT_EQ(ones[i], ef_load.select(i));
+			ASSERT_EQ(ones[i], ef_map.select(i));
+		}
+		for (size_t i = 0; i < size; i += 3) {
+			ASSERT_EQ(ef.rank(i), ef_load.rank(i));
+			ASSERT_EQ(ef.rank(i), ef_map.rank(i));
+		}
+	}
+}
+
+TEST(rankselect, rank9sel_dump_map) {
+	using namespace sux::bits;
+
+	const size_t size = 100000;
+	const size_t words = size / 64 + 1;
+	// Pad to a full counts block, as select() may probe up to its end.
+	uint64_t *bitvect = new uint64_t[(words + 7) & ~7ULL]();
+
+	uint64_t ones = 0;
+	for (size_t i = 0; i < (size + 63) / 64; i++) {
+		bitvect[i] = next();
+		if (i == (size + 63) / 64 - 1 && size % 64 != 0) bitvect[i] &= (UINT64_C(1) << size % 64) - 1;
+		ones += __builtin_popcountll(bitvect[i]);
+	}
+
+	Rank9Sel rank9sel(bitvect, size);
+
+	std::ostringstream dump;
+	dump << rank9sel;
+
+	// An 8-byte aligned copy of the image, standing in for a memory mapping.
+	std::vector<uint64_t> image((dump.str().size() + 7) / 8);
+	memcpy(&image[0], dump.str().data(), dump.str().size());
+	Rank9Sel<> mapped;
+	mapped.map(&image[0], bitvect);
+
+	for (size_t i = 0; i <= size; i++) ASSERT_EQ(rank9sel.rank(i), mapped.rank(i));
+	for (size_t i = 0; i < ones; i++) ASSERT_EQ(rank9sel.select(i), mapped.select(i));
+
+	delete[] bitvect;
+}
+
+TEST(rankselect, rank9sel_parallel) {
+	using namespace sux::bits;
+
+	for (size_t size : {size_t(10), size_t(1000), size_t(100000), size_t(512 * 1024)}) {
+		const size_t words = size / 64 + 1;
+		// Pad to a full counts block, as select() may probe up to its end.
+		uint64_t *bitvect = new uint64_t[(words + 7) & ~7ULL]();
+
+		uint64_t ones = 0;
+		for (size_t i = 0; i < (size + 63) / 64; i++) {
+			bitvect[i] = next() & next(); // Quarter density, for larger inventory spans.
+			if (i == (size + 63) / 64 - 1 && size % 64 != 0) bitvect[i] &= (UINT64_C(1) << size % 64) - 1;
+			ones += __builtin_popcountll(bitvect[i]);
+		}
+
+		Rank9Sel serial(bitvect, size);
+		Rank9Sel parallel(bitvect, size, 4);
+
+		for (size_t i = 0; i <= size; i++) ASSERT_EQ(serial.rank(i), parallel.rank(i));
+		for (size_t i = 0; i < ones; i++) ASSERT_EQ(serial.select(i), parallel.select(i));
+
+		delete[] bitvect;
+	}
+}
+
+TEST(rankselect, compact32) {
+	using namespace sux::bits;
+	using sux::util::MALLOC;
+
+	for (size_t size : {size_t(10), size_t(1000), size_t(100000), size_t(512 * 1024)}) {
+		const size_t words = size / 64 + 1;
+		// Pad to a full counts block, as select() may probe up to its end.
+		uint64_t *bitvect = new uint64_t[(words + 7) & ~7ULL]();
+
+		// Uniform, sparse and clustered distributions
+		for (int pattern = 0; pattern < 3; pattern++) {
+			uint64_t ones = 0;
+			for (size_t i = 0; i < (size + 63) / 64; i++) {
+				if (pattern == 0) bitvect[i] = next();
+				else if (pattern == 1) bitvect[i] = next() & next() & next() & next() & next();
+				else bitvect[i] = (i / 4) % 32 == 0 ? next() : 0; // ~3% density, in runs
+				if (i == (size + 63) / 64 - 1 && size % 64 != 0) bitvect[i] &= (UINT64_C(1) << size % 64) - 1;
+				ones += __builtin_popcountll(bitvect[i]);
+			}
+
+			Rank9Sel reference(bitvect, size);
+			SimpleSelect simple_reference(bitvect, size, 3);
+			Rank9<MALLOC, uint32_t> rank9(bitvect, size);
+			Rank9Sel<MALLOC, uint32_t> rank9sel(bitvect, size);
+			SimpleSelect<MALLOC, int32_t> simple(bitvect, size, 3);
+
+			for (size_t i = 0; i <= size; i++) {
+				ASSERT_EQ(reference.rank(i), rank9.rank(i)) << "at index " << i << ", pattern " << pattern;
+				ASSERT_EQ(reference.rank(i), rank9sel.rank(i)) << "at index " << i << ", pattern " << pattern;
+			}
+			for (size_t i = 0; i < ones; i++) {
+				ASSERT_EQ(reference.select(i), rank9sel.select(i)) << "at rank " << i << ", pattern " << pattern;
+				ASSERT_EQ(simple_reference.select(i), simple.select(i)) << "at rank " << i << ", pattern " << pattern;
+			}
+
+			// Batched ranks of the compact counters.
+			std::vector<size_t> pos(1000);
+			for (size_t i = 0; i < pos.size(); i++) pos[i] = next() % (size + 1);
+			std::vector<uint64_t> out(pos.size());
+			rank9.rank(&pos[0], &out[0], pos.size());
+			for (size_t i = 0; i < pos.size(); i++) ASSERT_EQ(reference.rank(pos[i]), out[i]) << "at position " << pos[i] << ", pattern " << pattern;
+
+			// Serialization and mapping.
+			std::ostringstream dump;
+			dump << rank9sel;
+			std::vector<uint64_t> image((dump.str().size() + 7) / 8);
+			memcpy(&image[0], dump.str().data(), dump.str().size());
+			Rank9Sel<MALLOC, uint32_t> mapped;
+			mapped.map(&image[0], bitvect);
+			for (size_t i = 0; i <= size; i += 17) ASSERT_EQ(rank9sel.rank(i), mapped.rank(i));
+			for (size_t i = 0; i < ones; i += 17) ASSERT_EQ(rank9sel.select(i), mapped.select(i));
+
+			// The compact counters take 3/4 of the space of the 64-bit ones.
+			if (size >= 100000) {
+				EXPECT_LT(rank9.bitCount(), Rank9(bitvect, size).bitCount());
+			}
+		}
+
+		delete[] bitvect;
+	}
+}
+
+TEST(rankselect, compact32_builders) {
+	using namespace sux::bits;
+	using sux::util::MALLOC;
+	const size_t size = 1 << 20;
+	const size_t words = size / 64 + 1;
+	// Pad to a full counts block, as select() may probe up to its end.
+	uint64_t *bitvect = new uint64_t[(words + 7) & ~7ULL]();
+
+	uint64_t ones = 0;
+	for (size_t i = 0; i < (size + 63) / 64; i++) {
+		bitvect[i] = next() & next(); // Quarter density, for larger inventory spans.
+		ones += __builtin_popcountll(bitvect[i]);
+	}
+	const size_t num_words = (size + 63) / 64;
+
+	// Feed the words in randomly sized chunks.
+	Rank9Sel<MALLOC, uint32_t>::Builder rank9sel_builder(size);
+	SimpleSelect<MALLOC, int32_t>::Builder simple_builder(size, ones, 3);
+	for (size_t pos = 0; pos < num_words;) {
+		const size_t chunk = std::min(num_words - pos, size_t(next() % 1000 + 1));
+		rank9sel_builder.appendWords(bitvect + pos, chunk);
+		simple_builder.appendWords(bitvect + pos, chunk);
+		pos += chunk;
+	}
+	Rank9Sel<MALLOC, uint32_t> built = rank9sel_builder.build(bitvect);
+	SimpleSelect<MALLOC, int32_t> simple = simple_builder.build(bitvect);
+
+	Rank9Sel reference(bitvect, size);
+	for (size_t i = 0; i <= size; i++) ASSERT_EQ(reference.rank(i), built.rank(i)) << "at index " << i;
+	for (size_t i = 0; i < ones; i++) {
+		ASSERT_EQ(reference.select(i), built.select(i)) << "at rank " << i;
+		ASSERT_EQ(reference.select(i), simple.select(i)) << "at rank " << i;
+	}
+
+	delete[] bitvect;
+}
+
+TEST(rankselect, rrr) {
+	using namespace sux::bits;
+
+	for (size_t size : {size_t(1), size_t(63), size_t(64), size_t(1000), size_t(100000), size_t(512 * 1024 + 17)}) {
+		const size_t words = size / 64 + 1;
+		// Pad to a full counts block, as Rank9Sel::select() may probe up to its end.
+		uint64_t *bitvect = new uint64_t[(words + 7) & ~7ULL]();
+
+		// Uniform, sparse and clustered distributions
+		for (int pattern = 0; pattern < 3; pattern++) {
+			uint64_t ones = 0;
+			for (size_t i = 0; i < (size + 63) / 64; i++) {
+				if (pattern == 0) bitvect[i] = next();
+				else if (pattern == 1) bitvect[i] = next() & next() & next() & next() & next();
+				else bitvect[i] = (i / 4) % 32 == 0 ? next() : 0; // ~3% density, in runs
+				if (i == (size + 63) / 64 - 1 && size % 64 != 0) bitvect[i] &= (UINT64_C(1) << size % 64) - 1;
+				ones += __builtin_popcountll(bitvect[i]);
+			}
+
+			Rrr rrr(bitvect, size);
+			Rank9Sel reference(bitvect, size);
+
+			EXPECT_EQ(size, rrr.size());
+			for (size_t i = 0; i <= size; i++) {
+				ASSERT_EQ(reference.rank(i), rrr.rank(i)) << "at index " << i << ", pattern " << pattern;
+				ASSERT_EQ(reference.rankZero(i), rrr.rankZero(i)) << "at index " << i << ", pattern " << pattern;
+			}
+			for (size_t i = 0; i < ones; i++) ASSERT_EQ(reference.select(i), rrr.select(i)) << "at rank " << i << ", pattern " << pattern;
+
+			// Serialization and mapping.
+			std::ostringstream dump;
+			dump << rrr;
+			std::vector<uint64_t> image((dump.str().size() + 7) / 8);
+			memcpy(&image[0], dump.str().data(), dump.str().size());
+			Rrr<> mapped;
+			mapped.map(&image[0]);
+			for (size_t i = 0; i <= size; i += 17) ASSERT_EQ(rrr.rank(i), mapped.rank(i));
+			for (size_t i = 0; i < ones; i += 17) ASSERT_EQ(rrr.select(i), mapped.select(i));
+		}
+
+		delete[] bitvect;
+	}
+}
+
+TEST(rankselect, streaming_builders) {
+	using namespace sux::bits;
+
+	for (size_t size : {size_t(1000), size_t(100000), size_t(1 << 20)}) {
+		const size_t words = size / 64 + 1;
+		// Pad to a full counts block, as select() may probe up to its end.
+		uint64_t *bitvect = new uint64_t[(words + 7) & ~7ULL]();
+
+		uint64_t ones = 0;
+		for (size_t i = 0; i < (size + 63) / 64; i++) {
+			bitvect[i] = next() & next(); // Quarter density, for larger inventory spans.
+			if (i == (size + 63) / 64 - 1 && size % 64 != 0) bitvect[i] &= (UINT64_C(1) << size % 64) - 1;
+			ones += __builtin_popcountll(bitvect[i]);
+		}
+		const size_t num_words = (size + 63) / 64;
+
+		// Feed the words in randomly sized chunks.
+		Rank9Sel<>::Builder rank9sel_builder(size);
+		SimpleSelect<>::Builder simple_builder(size, ones, 3);
+		SimpleSelectZero<>::Builder simple_zero_builder(size, size - ones, 3);
+		for (size_t pos = 0; pos < num_words;) {
+			const size_t chunk = std::min(num_words - pos, size_t(next() % 1000 + 1));
+			rank9sel_builder.appendWords(bitvect + pos, chunk);
+			simple_builder.appendWords(bitvect + pos, chunk);
+			simple_zero_builder.appendWords(bitvect + pos, chunk);
+			pos += chunk;
+		}
+		Rank9Sel built = rank9sel_builder.build(bitvect);
+		SimpleSelect simple = simple_builder.build(bitvect);
+		SimpleSelectZero simple_zero = simple_zero_builder.build(bitvect);
+
+		Rank9Sel reference(bitvect, size);
+		SimpleSelect simple_reference(bitvect, size, 3);
+		SimpleSelectZero simple_zero_reference(bitvect, size, 3);
+
+		for (size_t i = 0; i <= size; i++) ASSERT_EQ(reference.rank(i), built.rank(i)) << "at index " << i;
+		for (size_t i = 0; i < ones; i++) {
+			ASSERT_EQ(reference.select(i), built.select(i)) << "at rank " << i;
+			ASSERT_EQ(simple_reference.select(i), simple.select(i)) << "at rank " << i;
+		}
+		for (size_t i = 0; i < size - ones; i++) ASSERT_EQ(simple_zero_reference.selectZero(i), simple_zero.selectZero(i)) << "at rank " << i;
+
+		delete[] bitvect;
+	}
+}
+
+TEST(rankselect, simple_select_tuned) {
+	using namespace sux::bits;
+	const size_t size = 1 << 20;
+	const size_t words = size / 64;
+	uint64_t *bitvect = new uint64_t[words];
+
+	// Uniform, clustered, and very sparse distributions
+	for (int pattern = 0; pattern < 3; pattern++) {
+		for (size_t i = 0; i < words; i++) {
+			if (pattern == 0) bitvect[i] = next();
+			else if (pattern == 1) bitvect[i] = (i / 64) % 32 == 0 ? next() : 0;
+			else bitvect[i] = next() & next() & next() & next() & next() & next();
+		}
+
+		size_t ones = 0;
+		for (size_t i = 0; i < words; i++) ones += __builtin_popcountll(bitvect[i]);
+		if (ones == 0) continue;
+
+		SimpleSelect tuned(bitvect, size);
+		SimpleSelect reference(bitvect, size, 3);
+
+		EXPECT_GE(tuned.longwordsPerSubinventory(), 1);
+		EXPECT_LE(tuned.bitCount(), reference.bitCount());
+		for (size_t i = 0; i < ones; i++) ASSERT_EQ(reference.select(i), tuned.select(i)) << "at rank " << i << ", pattern " << pattern;
+	}
+
+	delete[] bitvect;
+}
+
+TEST(rankselect, batch_rank) {
+	using namespace sux::bits;
+
+	for (size_t size : {size_t(10), size_t(1000), size_t(100000)}) {
+		uint64_t *bitvect = new uint64_t[size / 64 + 1]();
+		for (size_t i = 0; i < size; i++)
+			if (next() % 2) bitvect[i / 64] |= UINT64_C(1) << i % 64;
+
+		Rank9 rank9(bitvect, size);
+		std::vector<size_t> pos(1000);
+		for (size_t i = 0; i < pos.size(); i++) pos[i] = next() % (size + 1);
+		pos[0] = 0;
+		pos[1] = size;
+
+		std::vector<uint64_t> out(pos.size());
+		rank9.rank(&pos[0], &out[0], pos.size());
+		for (size_t i = 0; i < pos.size(); i++) ASSERT_EQ(rank9.rank(pos[i]), out[i]) << "at position " << pos[i] << ", size " << size;
+
+		// The default batch implementation of the interface.
+		Poppy poppy(bitvect, size);
+		sux::Rank &rank = poppy;
+		rank.rank(&pos[0], &out[0], pos.size());
+		for (size_t i = 0; i < pos.size(); i++) ASSERT_EQ(poppy.rank(pos[i]), out[i]) << "at position " << pos[i] << ", size " << size;
+
+		delete[] bitvect;
+	}
+}
+
+TEST(rankselect, space_report) {
+	using namespace sux::bits;
+
+	const size_t size = 100000;
+	uint64_t *bitvect = new uint64_t[size / 64 + 1]();
+	std::vector<uint64_t> ones;
+	for (size_t i = 0; i < size; i++)
+		if (next() % 2) {
+			bitvect[i / 64] |= UINT64_C(1) << i % 64;
+			ones.push_back(i);
+		}
+
+	Rank9Sel rank9sel(bitvect, size);
+	sux::util::SpaceReport report = rank9sel.spaceReport();
+	EXPECT_EQ(rank9sel.bitCount(), report.totalBits());
+	ASSERT_EQ(3u, report.components.size());
+	EXPECT_EQ("counts", report.components[0].name);
+
+	SimpleSelect simple(bitvect, size, 3);
+	EXPECT_EQ(simple.bitCount(), simple.spaceReport().totalBits());
+
+	EliasFano ef(ones, size);
+	report = ef.spaceReport();
+	EXPECT_EQ(ef.bitCount(), report.totalBits());
+	ASSERT_EQ(4u, report.components.size());
+	EXPECT_EQ("select_upper", report.components[2].name);
+	EXPECT_EQ(1u, report.components[2].components.size());
+
+	delete[] bitvect;
+}
+
+TEST(rankselect, warmup) {
+	using namespace sux::bits;
+
+	const size_t size = 10000;
+	uint64_t *bitvect = new uint64_t[size / 64 + 1]();
+	std::vector<uint64_t> ones;
+	for (size_t i = 0; i < size; i++)
+		if (next() % 2) {
+			bitvect[i / 64] |= UINT64_C(1) << i % 64;
+			ones.push_back(i);
+		}
+
+	// warmup() only touches memory: queries must be unaffected.
+	Rank9Sel rank9sel(bitvect, size);
+	rank9sel.warmup();
+	EliasFano ef(ones, size);
+	ef.warmup();
+	SimpleSelect simple(bitvect, size, 3);
+	simple.warmup();
+	for (size_t i = 0; i < ones.size(); i++) {
+		ASSERT_EQ(ones[i], rank9sel.select(i));
+		ASSERT_EQ(ones[i], ef.select(i));
+		ASSERT_EQ(ones[i], simple.select(i));
+	}
+
+	delete[] bitvect;
+}
+
 TEST(rankselect, small_large) {
 	run_rankselect(10);
 	run_rankselect(64);
@@ -5,6 +5,10 @@
 #include <cstring>
 #include <fstream>
 #include <random>
+#include <sstream>
+#include <sux/function/AnyRecSplit.hpp>
+#include <sux/function/DoubleEF.hpp>
+#include <sux/function/PartitionedRecSplit.hpp>
 #include <sux/function/RecSplit.hpp>
 
 using namespace std;
@@ -51,6 +55,248 @@ TEST(recsplit_test, random_hash128) {
 	recsplit_unit_test(rs, keys);
 }
 
+TEST(recsplit_test, parallel_matches_serial) {
+	vector<hash128_t> keys;
+	for (size_t i = 0; i < NKEYS_TEST / 10; ++i) {
+		keys.push_back(hash128_t(next(), next()));
+	}
+
+	RecSplit2 rs_serial(keys, BUCKET_SIZE_TEST);
+	RecSplit2 rs_parallel(keys, BUCKET_SIZE_TEST, 4);
+
+	ostringstream serial, parallel;
+	serial << rs_serial;
+	parallel << rs_parallel;
+	ASSERT_EQ(serial.str(), parallel.str());
+	recsplit_unit_test(rs_parallel, keys);
+}
+
+TEST(recsplit_test, random_hash128_leaf12) {
+	// Exercises the midstop path of the leaf bijection search (LEAF > 8).
+	vector<hash128_t> keys;
+	for (size_t i = 0; i < 2000; ++i) {
+		keys.push_back(hash128_t(next(), next()));
+	}
+
+	RecSplit<12> rs(keys, 100);
+	recsplit_unit_test(rs, keys);
+}
+
+TEST(recsplit_test, construction_stats) {
+	vector<hash128_t> keys;
+	for (size_t i = 0; i < NKEYS_TEST / 10; ++i) {
+		keys.push_back(hash128_t(next(), next()));
+	}
+
+	RecSplitStats serial_stats, parallel_stats;
+	RecSplit2 rs_serial(keys, BUCKET_SIZE_TEST, 1, &serial_stats);
+	RecSplit2 rs_parallel(keys, BUCKET_SIZE_TEST, 4, &parallel_stats);
+
+	uint64_t leaves = 0;
+	for (int m = 0; m < MAX_LEAF_SIZE; m++) {
+		leaves += serial_stats.bij_count[m];
+		ASSERT_GE(serial_stats.bij_trials[m], serial_stats.bij_count[m]);
+		// The search is deterministic, so trial counts do not depend on threading.
+		ASSERT_EQ(serial_stats.bij_count[m], parallel_stats.bij_count[m]);
+		ASSERT_EQ(serial_stats.bij_trials[m], parallel_stats.bij_trials[m]);
+	}
+	ASSERT_GT(leaves, 0);
+	ASSERT_GT(serial_stats.split_count, 0);
+	ASSERT_EQ(serial_stats.split_count, parallel_stats.split_count);
+	ASSERT_EQ(serial_stats.split_trials, parallel_stats.split_trials);
+	ASSERT_GT(serial_stats.avgBijTrials(LEAF), 0);
+}
+
+TEST(recsplit_test, partitioned) {
+	vector<string> keys;
+	for (size_t i = 0; i < 20000; ++i) keys.push_back("key" + to_string(next()));
+
+	PartitionedRecSplit<LEAF> rs(keys, BUCKET_SIZE_TEST, 4, 2);
+	ASSERT_EQ(keys.size(), rs.size());
+	recsplit_unit_test(rs, keys);
+
+	ostringstream dump;
+	dump << rs;
+	istringstream in(dump.str());
+	PartitionedRecSplit<LEAF> rs_load;
+	in >> rs_load;
+	for (const auto &k : keys) ASSERT_EQ(rs(k), rs_load(k));
+
+	// Rebuilding a partition with its own keys must leave a global bijection.
+	vector<string> part_keys;
+	for (const auto &k : keys) {
+		const hash128_t h = spooky(k.c_str(), k.size(), 0);
+		if (h.first >> 62 == 2) part_keys.push_back(k);
+	}
+	rs.rebuild(2, part_keys);
+	recsplit_unit_test(rs, keys);
+}
+
+TEST(recsplit_test, short_key_hasher) {
+	vector<string> keys;
+	for (size_t i = 0; i < 20000; ++i) keys.push_back("k" + to_string(next()));
+
+	RecSplit<LEAF, sux::util::AllocType::MALLOC, ShortKeyHasher> rs(keys, BUCKET_SIZE_TEST);
+	recsplit_unit_test(rs, keys);
+}
+
+TEST(recsplit_test, external_matches_in_memory) {
+	const char *filename = "test/test_keys";
+	ofstream out(filename);
+	for (size_t i = 0; i < NKEYS_TEST / 10; ++i) out << "key" << next() << "\n";
+	out.close();
+
+	ifstream in_memory(filename);
+	RecSplit2 rs_memory(in_memory, BUCKET_SIZE_TEST);
+	in_memory.close();
+
+	ifstream in_external(filename);
+	RecSplit2 rs_external(in_external, BUCKET_SIZE_TEST, string("test"), 8);
+	in_external.close();
+	remove(filename);
+
+	ostringstream memory_dump, external_dump;
+	memory_dump << rs_memory;
+	external_dump << rs_external;
+	ASSERT_EQ(memory_dump.str(), external_dump.str());
+}
+
+TEST(recsplit_test, batch_matches_single) {
+	vector<hash128_t> keys;
+	for (size_t i = 0; i < NKEYS_TEST / 10; ++i) {
+		keys.push_back(hash128_t(next(), next()));
+	}
+
+	RecSplit2 rs(keys, BUCKET_SIZE_TEST);
+	vector<uint64_t> out(keys.size());
+	rs(&keys[0], keys.size(), &out[0]);
+	for (size_t i = 0; i < keys.size(); i++) ASSERT_EQ(rs(keys[i]), out[i]);
+}
+
+TEST(recsplit_test, typed_key_queries) {
+	vector<uint64_t> values;
+	vector<string> keys;
+	for (size_t i = 0; i < 20000; ++i) {
+		values.push_back(next());
+		keys.push_back(string((const char *)&values.back(), sizeof(uint64_t)));
+	}
+
+	RecSplit2 rs(keys, BUCKET_SIZE_TEST);
+	for (size_t i = 0; i < keys.size(); i++) {
+		const size_t expected = rs(keys[i]);
+		ASSERT_EQ(expected, rs(string_view(keys[i])));
+		ASSERT_EQ(expected, rs(keys[i].data(), keys[i].size()));
+		ASSERT_EQ(expected, rs(values[i]));
+	}
+
+	// 16-byte keys from two words.
+	vector<string> wide;
+	for (size_t i = 0; i < 20000; ++i) {
+		const uint64_t k[2] = {next(), next()};
+		wide.push_back(string((const char *)k, sizeof k));
+	}
+	RecSplit2 rsw(wide, BUCKET_SIZE_TEST);
+	for (size_t i = 0; i < wide.size(); i++) {
+		uint64_t k[2];
+		memcpy(k, wide[i].data(), sizeof k);
+		ASSERT_EQ(rsw(wide[i]), rsw(k[0], k[1]));
+	}
+}
+
+#if defined(__cpp_impl_coroutine)
+TEST(recsplit_test, interleaved) {
+	vector<string> keys;
+	for (size_t i = 0; i < 50000; ++i) keys.push_back(to_string(next()));
+
+	RecSplit2 rs(keys, BUCKET_SIZE_TEST);
+
+	vector<hash128_t> hashes;
+	for (const auto &key : keys) hashes.push_back(first_hash(key.c_str(), key.size()));
+
+	vector<size_t> out(hashes.size());
+	for (size_t window : {size_t(1), size_t(16), size_t(32)}) {
+		sux::interleave(hashes.size(), [&](size_t i) { return rs.queryLookup(hashes[i]); }, out.data(), window);
+		for (size_t i = 0; i < hashes.size(); i++) ASSERT_EQ(rs(hashes[i]), out[i]);
+	}
+}
+#endif
+
+TEST(recsplit_test, any_leaf_size) {
+	vector<hash128_t> keys;
+	for (size_t i = 0; i < NKEYS_TEST / 10; ++i) keys.push_back(hash128_t(next(), next()));
+
+	// A dump written by a typed instance loads into the matching instantiation.
+	RecSplit<5> rs(keys, BUCKET_SIZE_TEST);
+	stringstream dump;
+	dump << rs;
+	AnyRecSplit<4, 8> any;
+	dump >> any;
+	ASSERT_EQ(5u, any.leafSize());
+	ASSERT_EQ(keys.size(), any.size());
+	for (size_t i = 0; i < keys.size(); i++) ASSERT_EQ(rs(keys[i]), any(keys[i]));
+
+	// Redumping is byte-identical.
+	stringstream redump;
+	redump << any;
+	ASSERT_EQ(dump.str(), redump.str());
+
+	// Batch queries match single queries through the wrapper.
+	vector<uint64_t> out(keys.size());
+	any(&keys[0], keys.size(), &out[0]);
+	for (size_t i = 0; i < keys.size(); i++) ASSERT_EQ(any(keys[i]), out[i]);
+
+	// Direct construction with a runtime leaf size.
+	AnyRecSplit<4, 8> built(keys, BUCKET_SIZE_TEST, 7);
+	ASSERT_EQ(7u, built.leafSize());
+	built.warmup();
+	recsplit_unit_test(built, keys);
+}
+
+TEST(recsplit_test, double_ef_builder_matches_constructor) {
+	for (const size_t nbuckets : {size_t(1), size_t(100), size_t(100000)}) {
+		vector<uint64_t> cum_keys(nbuckets + 1), position(nbuckets + 1);
+		DoubleEF<>::Builder builder(nbuckets);
+		builder.add(0, 0);
+		for (size_t i = 1; i <= nbuckets; i++) {
+			cum_keys[i] = cum_keys[i - 1] + next() % 2000;
+			position[i] = position[i - 1] + next() % 100000;
+			builder.add(cum_keys[i], position[i]);
+		}
+
+		DoubleEF<> ef(cum_keys, position);
+		DoubleEF<> ef_built = builder.build();
+
+		// The builder replays the constructor's passes exactly, so the
+		// serialized form must be byte-identical.
+		ostringstream reference, built;
+		reference << ef;
+		built << ef_built;
+		ASSERT_EQ(reference.str(), built.str());
+
+		for (size_t i = 0; i < nbuckets; i++) {
+			uint64_t x, x2, y;
+			ef_built.get(i, x, x2, y);
+			ASSERT_EQ(cum_keys[i], x);
+			ASSERT_EQ(cum_keys[i + 1], x2);
+			ASSERT_EQ(position[i], y);
+		}
+	}
+}
+
+TEST(recsplit_test, space_report) {
+	vector<hash128_t> keys;
+	for (size_t i = 0; i < NKEYS_TEST / 10; ++i) keys.push_back(hash128_t(next(), next()));
+
+	RecSplit2 rs(keys, BUCKET_SIZE_TEST);
+	sux::util::SpaceReport report = rs.spaceReport();
+	ASSERT_EQ(2u, report.components.size());
+	EXPECT_EQ("descriptors", report.components[0].name);
+	EXPECT_EQ("double_ef", report.components[1].name);
+	// The descriptors dominate the space of any RecSplit instance.
+	EXPECT_GT(report.components[0].totalBits(), report.components[1].totalBits());
+	EXPECT_GT(report.totalBits(), rs.size());
+}
+
 /*TEST(recsplit_test, from_sample1) {
 	FILE* keys_fp = fopen("samples/sample1.txt", "r");
 	ASSERT_NE(keys_fp, nullptr) << "Sample file not found" << endl;
@@ -85,6 +331,29 @@ TEST(recsplit_test, dump_and_load) {
 	remove(filename);
 }
 
+TEST(recsplit_test, dump_and_map) {
+	vector<hash128_t> keys;
+	const char *filename = "test/test_dump";
+	for (size_t i = 0; i < NKEYS_TEST / 10; ++i) {
+		keys.push_back(hash128_t(next(), next()));
+	}
+
+	RecSplit2 rs_dump(keys, BUCKET_SIZE_TEST);
+
+	fstream fs;
+	fs.exceptions(fstream::failbit | fstream::badbit);
+	fs.open(filename, fstream::out | fstream::binary | fstream::trunc);
+	fs << rs_dump;
+	fs.close();
+
+	RecSplit2 rs_map;
+	rs_map.map(filename);
+
+	for (size_t i = 0; i < rs_dump.size(); i++) ASSERT_EQ(rs_dump(keys[i]), rs_map(keys[i]));
+	recsplit_unit_test(rs_map, keys);
+	remove(filename);
+}
+
 TEST(recsplit_test, small_hash_dump_and_load) {
 	vector<hash128_t> keys;
 	keys.push_back(hash128_t(0, 0));
@@ -138,3 +138,42 @@ TEST(RiceBitVector_test, trees_golomb_6) {
 
 	test_rice_trees(r, keys, golomb_param, tree_offset);
 }
+
+TEST(RiceBitVector_test, skip_index) {
+	const int golomb_param = 3;
+	static mt19937_64 rng(0x5603);
+	uniform_int_distribution<uint64_t> gen(0, 100);
+	const size_t n = 100000;
+	vector<uint64_t> keys(n);
+	for (auto &k : keys) k = gen(rng);
+
+	RiceBitVector<>::Builder b;
+	vector<uint32_t> unary;
+	for (uint64_t k : keys) {
+		b.appendFixed(k, golomb_param);
+		unary.push_back(k >> golomb_param);
+	}
+	b.appendUnaryAll(unary);
+	auto plain = b.build();
+
+	RiceBitVector<>::Builder b2;
+	for (uint64_t k : keys) {
+		b2.appendFixed(k, golomb_param);
+	}
+	b2.appendUnaryAll(unary);
+	auto indexed = b2.build();
+	indexed.buildSkipIndex();
+
+	for (size_t skip : {size_t(1), size_t(10), size_t(1000), size_t(50000), size_t(99999)}) {
+		auto slow = plain.reader();
+		auto fast = indexed.reader();
+		slow.readReset(0, golomb_param * n);
+		fast.readReset(0, golomb_param * n);
+		slow.skipSubtree(skip, golomb_param * skip);
+		fast.skipSubtree(skip, golomb_param * skip);
+		for (size_t i = skip; i < min(skip + 100, n); i++) {
+			ASSERT_EQ(keys[i], slow.readNext(golomb_param)) << "at index " << i << ", skip " << skip;
+			ASSERT_EQ(keys[i], fast.readNext(golomb_param)) << "at index " << i << ", skip " << skip;
+		}
+	}
+}
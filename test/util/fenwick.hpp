@@ -1,12 +1,17 @@
 #pragma once
 
 #include <cmath>
+#include <sstream>
+#include <sux/util/BufferedPrefixSums.hpp>
 #include <sux/util/FenwickBitF.hpp>
 #include <sux/util/FenwickBitL.hpp>
 #include <sux/util/FenwickByteF.hpp>
 #include <sux/util/FenwickByteL.hpp>
+#include <sux/util/FenwickFactory.hpp>
+#include <sux/util/FenwickFixedB.hpp>
 #include <sux/util/FenwickFixedF.hpp>
 #include <sux/util/FenwickFixedL.hpp>
+#include <vector>
 
 template <std::size_t S> void run_fenwick(std::size_t size) {
 	using namespace sux::util;
@@ -25,6 +30,7 @@ template <std::size_t S> void run_fenwick(std::size_t size) {
 	FenwickByteL<S> bytel(increments, size);
 	FenwickBitF<S> bitf(increments, size);
 	FenwickBitL<S> bitl(increments, size);
+	FenwickFixedB<S> fixedb(increments, size);
 
 	// prefix
 	for (size_t i = 0; i <= size; ++i) {
@@ -35,6 +41,7 @@ template <std::size_t S> void run_fenwick(std::size_t size) {
 		EXPECT_EQ(res, bytel.prefix(i)) << "at index " << i << ", size " << size << ", bound " << S;
 		EXPECT_EQ(res, bitf.prefix(i)) << "at index " << i << ", size " << size << ", bound " << S;
 		EXPECT_EQ(res, bitl.prefix(i)) << "at index " << i << ", size " << size << ", bound " << S;
+		EXPECT_EQ(res, fixedb.prefix(i)) << "at index " << i << ", size " << size << ", bound " << S;
 	}
 
 	// find
@@ -47,6 +54,7 @@ template <std::size_t S> void run_fenwick(std::size_t size) {
 		EXPECT_EQ(res, bytel.find(item)) << "at index " << i << ", size " << size << ", bound: " << S;
 		EXPECT_EQ(res, bitf.find(item)) << "at index " << i << ", size " << size << ", bound: " << S;
 		EXPECT_EQ(res, bitl.find(item)) << "at index " << i << ", size " << size << ", bound: " << S;
+		EXPECT_EQ(res, fixedb.find(item)) << "at index " << i << ", size " << size << ", bound: " << S;
 	}
 
 	// add
@@ -57,6 +65,7 @@ template <std::size_t S> void run_fenwick(std::size_t size) {
 		bytel.add(i + 1, add_updates[i]);
 		bitf.add(i + 1, add_updates[i]);
 		bitl.add(i + 1, add_updates[i]);
+		fixedb.add(i + 1, add_updates[i]);
 	}
 
 	// post add prefix (check add correctness)
@@ -68,6 +77,7 @@ template <std::size_t S> void run_fenwick(std::size_t size) {
 		EXPECT_EQ(res, bytel.prefix(i)) << "at index " << i << ", size " << size << ", bound " << S;
 		EXPECT_EQ(res, bitf.prefix(i)) << "at index " << i << ", size " << size << ", bound " << S;
 		EXPECT_EQ(res, bitl.prefix(i)) << "at index " << i << ", size " << size << ", bound " << S;
+		EXPECT_EQ(res, fixedb.prefix(i)) << "at index " << i << ", size " << size << ", bound " << S;
 	}
 
 	// find complement
@@ -80,12 +90,302 @@ template <std::size_t S> void run_fenwick(std::size_t size) {
 		EXPECT_EQ(res, bytel.compFind(item)) << "at index " << i << ", size " << size << ", bound " << S;
 		EXPECT_EQ(res, bitf.compFind(item)) << "at index " << i << ", size " << size << ", bound " << S;
 		EXPECT_EQ(res, bitl.compFind(item)) << "at index " << i << ", size " << size << ", bound " << S;
+		EXPECT_EQ(res, fixedb.compFind(item)) << "at index " << i << ", size " << size << ", bound " << S;
 	}
 
 	delete[] increments;
 	delete[] add_updates;
 }
 
+template <typename F> void run_fenwick_map(std::size_t size) {
+	std::uint64_t *increments = new std::uint64_t[size];
+	for (std::size_t i = 0; i < size; i++) increments[i] = next() % 64;
+
+	F tree(increments, size);
+
+	std::ostringstream dump;
+	dump << tree;
+
+	// An 8-byte aligned copy of the image, standing in for a memory mapping.
+	std::vector<uint64_t> image((dump.str().size() + 7) / 8);
+	memcpy(&image[0], dump.str().data(), dump.str().size());
+	F mapped;
+	mapped.map(&image[0]);
+
+	for (std::size_t i = 0; i <= size; ++i) EXPECT_EQ(tree.prefix(i), mapped.prefix(i)) << "at index " << i << ", size " << size;
+	for (std::uint64_t i = 0; i <= size; ++i) {
+		const std::size_t item = next() % 64;
+		EXPECT_EQ(tree.find(item), mapped.find(item)) << "at index " << i << ", size " << size;
+	}
+
+	delete[] increments;
+}
+
+template <typename F> void run_fenwick_batch(std::size_t size) {
+	std::uint64_t *increments = new std::uint64_t[size];
+	for (std::size_t i = 0; i < size; i++) increments[i] = next() % 64;
+
+	F tree(increments, size);
+
+	const std::size_t n = size + size / 2 + 1; // Not a multiple of the interleave factor.
+	std::vector<std::size_t> idx(n);
+	std::vector<std::uint64_t> bound(n);
+	for (std::size_t i = 0; i < n; i++) {
+		idx[i] = next() % (size + 1);
+		bound[i] = next() % (64 * size);
+	}
+
+	std::vector<std::uint64_t> sums(n);
+	std::vector<std::size_t> pos(n);
+
+	tree.prefix(&idx[0], &sums[0], n);
+	for (std::size_t i = 0; i < n; i++) EXPECT_EQ(tree.prefix(idx[i]), sums[i]) << "at index " << i << ", size " << size;
+
+	tree.find(&bound[0], &pos[0], n);
+	for (std::size_t i = 0; i < n; i++) EXPECT_EQ(tree.find(bound[i]), pos[i]) << "at index " << i << ", size " << size;
+
+	tree.compFind(&bound[0], &pos[0], n);
+	for (std::size_t i = 0; i < n; i++) EXPECT_EQ(tree.compFind(bound[i]), pos[i]) << "at index " << i << ", size " << size;
+
+	delete[] increments;
+}
+
+TEST(fenwick, batch) {
+	using namespace sux::util;
+	for (std::size_t size : {std::size_t(1), std::size_t(10), std::size_t(1000), std::size_t(100000)}) {
+		run_fenwick_batch<FenwickFixedF<64>>(size);
+		run_fenwick_batch<FenwickFixedL<64>>(size);
+		run_fenwick_batch<FenwickByteF<64>>(size);
+		run_fenwick_batch<FenwickByteL<64>>(size);
+		run_fenwick_batch<FenwickBitF<64>>(size);
+		run_fenwick_batch<FenwickBitL<64>>(size);
+		run_fenwick_batch<FenwickFixedB<64>>(size);
+	}
+}
+
+template <typename F, typename... Threads> void run_fenwick_bulk(std::size_t size, Threads... num_threads) {
+	std::uint64_t *increments = new std::uint64_t[size];
+	for (std::size_t i = 0; i < size; i++) increments[i] = next() % 64;
+
+	F reference(increments, size);
+	F bulk = F::bulkBuild(increments, size, num_threads...);
+
+	for (std::size_t i = 0; i <= size; ++i) ASSERT_EQ(reference.prefix(i), bulk.prefix(i)) << "at index " << i << ", size " << size;
+	for (std::uint64_t i = 0; i < 100; ++i) {
+		const std::size_t item = next() % (64 * size + 1);
+		ASSERT_EQ(reference.find(item), bulk.find(item)) << "at index " << i << ", size " << size;
+		ASSERT_EQ(reference.compFind(item), bulk.compFind(item)) << "at index " << i << ", size " << size;
+	}
+
+	delete[] increments;
+}
+
+TEST(fenwick, bulk_build) {
+	using namespace sux::util;
+	for (std::size_t size : {std::size_t(1), std::size_t(10), std::size_t(1000), std::size_t(1024), std::size_t(100000)}) {
+		run_fenwick_bulk<FenwickFixedF<64>>(size);
+		run_fenwick_bulk<FenwickFixedL<64>>(size);
+		run_fenwick_bulk<FenwickByteF<64>>(size);
+		run_fenwick_bulk<FenwickByteL<64>>(size);
+		run_fenwick_bulk<FenwickBitF<64>>(size);
+		run_fenwick_bulk<FenwickBitL<64>>(size);
+
+		run_fenwick_bulk<FenwickFixedF<64>>(size, std::size_t(4));
+		run_fenwick_bulk<FenwickFixedL<64>>(size, std::size_t(4));
+	}
+}
+
+TEST(fenwick, map) {
+	using namespace sux::util;
+	for (std::size_t size : {std::size_t(10), std::size_t(1000), std::size_t(100000)}) {
+		run_fenwick_map<FenwickFixedF<64>>(size);
+		run_fenwick_map<FenwickFixedL<64>>(size);
+		run_fenwick_map<FenwickByteF<64>>(size);
+		run_fenwick_map<FenwickByteL<64>>(size);
+		run_fenwick_map<FenwickBitF<64>>(size);
+		run_fenwick_map<FenwickBitL<64>>(size);
+		run_fenwick_map<FenwickFixedB<64>>(size);
+	}
+}
+
+template <typename F> void run_fenwick_push(std::size_t size) {
+	std::uint64_t *increments = new std::uint64_t[size];
+	for (std::size_t i = 0; i < size; i++) increments[i] = next() % 64;
+
+	F reference(increments, size);
+	F pushed;
+	for (std::size_t i = 0; i < size; i++) pushed.push(increments[i]);
+
+	for (std::size_t i = 0; i <= size; ++i) EXPECT_EQ(reference.prefix(i), pushed.prefix(i)) << "at index " << i << ", size " << size;
+
+	for (std::size_t i = size; i > size / 2; i--) pushed.pop();
+	for (std::size_t i = 0; i <= size / 2; ++i) EXPECT_EQ(reference.prefix(i), pushed.prefix(i)) << "at index " << i << ", size " << size;
+
+	delete[] increments;
+}
+
+TEST(fenwick, push_pop) {
+	using namespace sux::util;
+	for (std::size_t size : {std::size_t(1), std::size_t(10), std::size_t(1000), std::size_t(100000)}) run_fenwick_push<FenwickFixedB<64>>(size);
+}
+
+template <typename F> void run_fenwick_buffered(std::size_t size) {
+	using namespace sux::util;
+
+	std::uint64_t *increments = new std::uint64_t[size];
+	for (std::size_t i = 0; i < size; i++) increments[i] = next() % 48;
+
+	F reference(increments, size);
+	BufferedPrefixSums<F, 256> buffered(increments, size);
+
+	// Ingest bursts concentrated in small index ranges, with queries
+	// interleaved while deltas are still pending.
+	for (std::size_t round = 0; round < 8; round++) {
+		const std::size_t base = next() % size + 1;
+		for (std::size_t i = 0; i < 1000; i++) {
+			const std::size_t idx = std::min(base + next() % 64, size);
+			const std::uint64_t element = reference.prefix(idx) - reference.prefix(idx - 1);
+			const std::int64_t c = element == 0 ? 1 : element >= 64 ? -1 : next() % 2 ? 1 : -1;
+			reference.add(idx, c);
+			buffered.add(idx, c);
+		}
+
+		for (std::size_t i = 0; i <= size; i += 7) ASSERT_EQ(reference.prefix(i), buffered.prefix(i)) << "at index " << i << ", size " << size;
+		for (std::uint64_t i = 0; i < 50; ++i) {
+			const std::size_t item = next() % (48 * size + 1);
+			ASSERT_EQ(reference.find(item), buffered.find(item)) << "at index " << i << ", size " << size;
+			ASSERT_EQ(reference.compFind(item), buffered.compFind(item)) << "at index " << i << ", size " << size;
+		}
+	}
+
+	// Serialization captures the pending deltas.
+	buffered.add(1, 1);
+	reference.add(1, 1);
+	std::stringstream stream;
+	stream << buffered;
+	BufferedPrefixSums<F, 256> loaded;
+	stream >> loaded;
+	for (std::size_t i = 0; i <= size; i += 7) ASSERT_EQ(reference.prefix(i), loaded.prefix(i)) << "at index " << i << ", size " << size;
+
+	delete[] increments;
+}
+
+TEST(fenwick, buffered) {
+	using namespace sux::util;
+	for (std::size_t size : {std::size_t(1), std::size_t(10), std::size_t(1000), std::size_t(100000)}) {
+		run_fenwick_buffered<FenwickFixedF<64>>(size);
+		run_fenwick_buffered<FenwickByteL<64>>(size);
+		run_fenwick_buffered<FenwickBitF<64>>(size);
+	}
+}
+
+TEST(fenwick, space_report) {
+	using namespace sux::util;
+	std::uint64_t *sequence = new std::uint64_t[10000];
+	for (std::size_t i = 0; i < 10000; i++) sequence[i] = next() % 64;
+
+	FenwickFixedF<64> fixedf(sequence, 10000);
+	FenwickFixedL<64> fixedl(sequence, 10000);
+	FenwickByteL<64> bytel(sequence, 10000);
+	FenwickBitF<64> bitf(sequence, 10000);
+
+	SpaceReport report = fixedf.spaceReport();
+	EXPECT_EQ(fixedf.bitCount(), report.totalBits());
+	ASSERT_EQ(1u, report.components.size());
+	EXPECT_EQ("tree", report.components[0].name);
+	EXPECT_EQ(MALLOC, report.components[0].alloc);
+
+	// The level-order layouts report one component per allocated level.
+	EXPECT_EQ(fixedl.bitCount(), fixedl.spaceReport().totalBits());
+	EXPECT_GT(fixedl.spaceReport().components.size(), 1u);
+	EXPECT_EQ(bytel.bitCount(), bytel.spaceReport().totalBits());
+	EXPECT_EQ(bitf.bitCount(), bitf.spaceReport().totalBits());
+
+	std::ostringstream os;
+	report.print(os);
+	EXPECT_NE(os.str().find("fenwick_fixedf"), std::string::npos);
+
+	delete[] sequence;
+}
+
+TEST(fenwick, factory) {
+	using namespace sux::util;
+	constexpr std::size_t SIZE = 10000;
+	std::uint64_t *sequence = new std::uint64_t[SIZE];
+	for (std::size_t i = 0; i < SIZE; i++) sequence[i] = next() % 64;
+
+	// Whatever layout the model picks, the structure behind the interface
+	// must agree with a reference implementation.
+	for (double query_fraction : {0., 0.5, 1.}) {
+		auto tree = makeFenwick<64>(sequence, SIZE, query_fraction);
+		ASSERT_EQ(SIZE, tree->size());
+
+		std::uint64_t sum = 0;
+		for (std::size_t i = 0; i < SIZE; i++) {
+			sum += sequence[i];
+			ASSERT_EQ(sum, tree->prefix(i + 1));
+		}
+
+		tree->add(1, 7);
+		ASSERT_EQ(sequence[0] + 7, tree->prefix(1));
+		tree->add(1, -7);
+		ASSERT_EQ(sequence[0], tree->prefix(1));
+	}
+
+	// Small query-heavy trees should get a fixed layout, huge ones a
+	// compressed one (with the built-in cost table).
+	FenwickCostModel<64> model;
+	EXPECT_TRUE(model.best(1000, 1.) == FenwickLayout::FIXEDF || model.best(1000, 1.) == FenwickLayout::FIXEDL);
+	EXPECT_TRUE(model.best(std::size_t(1) << 30, 1.) != FenwickLayout::FIXEDF && model.best(std::size_t(1) << 30, 1.) != FenwickLayout::FIXEDL);
+
+	// Calibrated models serialize and deserialize losslessly.
+	model.calibrate(1000);
+	std::stringstream dump;
+	dump << model;
+	FenwickCostModel<64> loaded;
+	dump >> loaded;
+	ASSERT_TRUE(bool(dump));
+	std::stringstream redump;
+	redump << loaded;
+	EXPECT_EQ(dump.str(), redump.str());
+	for (std::size_t size : {std::size_t(1000), std::size_t(1) << 22, std::size_t(1) << 30})
+		for (double query_fraction : {0., 0.5, 1.}) EXPECT_EQ(int(model.best(size, query_fraction)), int(loaded.best(size, query_fraction)));
+
+	// A model with a different bound refuses the dump.
+	std::stringstream dump2;
+	dump2 << model;
+	FenwickCostModel<255> wrong_bound;
+	dump2 >> wrong_bound;
+	EXPECT_FALSE(bool(dump2));
+
+	EXPECT_FALSE(loaded.load("/nonexistent/fenwick-cost-model"));
+
+	delete[] sequence;
+}
+
+#if defined(__cpp_impl_coroutine)
+TEST(fenwick, interleaved) {
+	using namespace sux::util;
+	constexpr std::size_t SIZE = 100000;
+	std::uint64_t *sequence = new std::uint64_t[SIZE];
+	for (std::size_t i = 0; i < SIZE; i++) sequence[i] = next() % 64;
+
+	FenwickByteF<64> tree(sequence, SIZE);
+
+	const size_t n = 10000;
+	std::vector<std::size_t> idx(n);
+	std::vector<std::uint64_t> out(n);
+	for (std::size_t i = 0; i < n; i++) idx[i] = next() % (SIZE + 1);
+
+	for (std::size_t window : {std::size_t(1), std::size_t(16), std::size_t(32)}) {
+		sux::interleave(n, [&](std::size_t i) { return tree.prefixLookup(idx[i]); }, out.data(), window);
+		for (std::size_t i = 0; i < n; i++) ASSERT_EQ(tree.prefix(idx[i]), out[i]);
+	}
+
+	delete[] sequence;
+}
+#endif
+
 TEST(fenwick, perfect) {
 	for (std::size_t i = 1; i < 10; ++i) run_fenwick<64>(std::pow(2, i) - 1);
 }
@@ -2,6 +2,7 @@
 
 #include "../xoroshiro128pp.hpp"
 #include "fenwick.hpp"
+#include "vector.hpp"
 
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
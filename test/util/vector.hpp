@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <sux/util/Arena.hpp>
+#include <sux/util/FenwickByteL.hpp>
+#include <sux/util/FenwickFixedF.hpp>
+#include <sux/util/Vector.hpp>
+
+template <sux::util::AllocType AT> static void run_vector() {
+	sux::util::Vector<uint64_t, AT> v;
+
+	for (size_t i = 0; i < 100000; i++) v.pushBack(i);
+	v.trimToFit();
+	for (size_t i = 0; i < 100000; i++) EXPECT_EQ(i, v[i]);
+
+	v.resize(200000);
+	for (size_t i = 100000; i < 200000; i++) EXPECT_EQ(0, v[i]);
+}
+
+TEST(vector, alloctypes) {
+	using namespace sux::util;
+	run_vector<AllocType::MALLOC>();
+	run_vector<AllocType::SMALLPAGE>();
+	run_vector<AllocType::TRANSHUGEPAGE>();
+	run_vector<AllocType::NUMABIND>();
+	run_vector<AllocType::NUMAINTERLEAVE>();
+}
+
+TEST(vector, prefault) {
+	using namespace sux::util;
+
+	// Owned memory of every allocation type can be prefaulted.
+	Vector<uint64_t, AllocType::MALLOC> m(10000);
+	m.prefault();
+	Vector<uint64_t, AllocType::SMALLPAGE> s(10000);
+	s.prefault();
+	for (size_t i = 0; i < 10000; i++) EXPECT_EQ(0u, s[i]);
+
+	// A view over foreign memory, as after map(), can be prefaulted too.
+	std::unique_ptr<uint64_t[]> backing(new uint64_t[10000]);
+	for (size_t i = 0; i < 10000; i++) backing[i] = i;
+	Vector<uint64_t> v;
+	v.view(backing.get(), 10000);
+	v.prefault();
+	for (size_t i = 0; i < 10000; i++) EXPECT_EQ(i, v[i]);
+	v.view(nullptr, 0);
+}
+
+TEST(vector, arena) {
+	using namespace sux::util;
+	const size_t length = 1 << 22;
+	std::unique_ptr<char[]> buffer(new char[length]);
+	Arena arena(&buffer[0], length);
+
+	{
+		Arena::Use use(arena);
+		run_vector<AllocType::ARENA>();
+	}
+	EXPECT_EQ(size_t(0), arena.used()); // The (last) slice was returned at destruction
+
+	// Several small structures suballocating from the same arena
+	std::uint64_t seq[32];
+	for (auto &v : seq) v = next() % 64;
+
+	FenwickByteL<64> reference(seq, 32);
+	{
+		Arena::Use use(arena);
+		FenwickByteL<64, AllocType::ARENA> bytel(seq, 32);
+		FenwickFixedF<64, AllocType::ARENA> fixedf(seq, 32);
+		Vector<uint64_t, AllocType::ARENA> v;
+		for (size_t i = 0; i < 1000; i++) v.pushBack(i);
+
+		EXPECT_NE(size_t(0), arena.used());
+		for (size_t i = 0; i <= 32; i++) {
+			EXPECT_EQ(reference.prefix(i), bytel.prefix(i)) << "at index " << i;
+			EXPECT_EQ(reference.prefix(i), fixedf.prefix(i)) << "at index " << i;
+		}
+		for (size_t i = 0; i < 1000; i++) EXPECT_EQ(i, v[i]);
+	}
+	arena.reset();
+	EXPECT_EQ(size_t(0), arena.used());
+}